@@ -0,0 +1,72 @@
+# Headless version of WundergroundDownloader (no display required)
+# Build with
+#   qmake WundergroundDaemon.pro
+#   make -f Makefile.daemon
+
+TARGET = WundergroundDaemon
+MAKEFILE = Makefile.daemon
+
+# Where files can be found
+INCLUDEPATH += src/
+INCLUDEPATH += shared/
+
+# Where files go
+OBJECTS_DIR = build/daemon/
+MOC_DIR = build/daemon/
+
+# Frameworks and compiler
+TEMPLATE = app
+QT -= gui
+QT += network
+QT += sql
+CONFIG += c++17
+CONFIG += release
+CONFIG += silent
+CONFIG += console
+CONFIG -= app_bundle
+
+# Don't allow deprecated versions of methods (before Qt 6.8)
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060800
+
+# Count allocations per traced method (qmake CONFIG+=trace_allocations)
+trace_allocations {
+    DEFINES += TRACE_ALLOCATIONS
+    SOURCES += shared/AllocationHooks.cpp
+}
+
+# Shared classes
+HEADERS += shared/CallTracer.h
+SOURCES += shared/CallTracer.cpp
+HEADERS += shared/DatabaseHelper.h
+SOURCES += shared/DatabaseHelper.cpp
+HEADERS += shared/MessageLogger.h
+SOURCES += shared/MessageLogger.cpp
+HEADERS += shared/SignalHandler.h
+SOURCES += shared/SignalHandler.cpp
+HEADERS += shared/StringHelper.h
+SOURCES += shared/StringHelper.cpp
+
+# Specific classes
+HEADERS += src/ArchiveBackend.h
+SOURCES += src/ArchiveBackend.cpp
+HEADERS += src/ColumnArchive.h
+SOURCES += src/ColumnArchive.cpp
+HEADERS += src/CommandLineTool.h
+SOURCES += src/CommandLineTool.cpp
+HEADERS += src/Config.h
+HEADERS += src/Daemon.h
+SOURCES += src/Daemon.cpp
+HEADERS += src/Deploy.h
+SOURCES += src/main_daemon.cpp
+HEADERS += src/MemoryBackend.h
+SOURCES += src/MemoryBackend.cpp
+HEADERS += src/QueryResult.h
+SOURCES += src/QueryResult.cpp
+HEADERS += src/RollupBuilder.h
+SOURCES += src/RollupBuilder.cpp
+HEADERS += src/SqliteBackend.h
+SOURCES += src/SqliteBackend.cpp
+HEADERS += src/StorageBackend.h
+SOURCES += src/StorageBackend.cpp
+HEADERS += src/WundergroundComms.h
+SOURCES += src/WundergroundComms.cpp
@@ -26,6 +26,12 @@ CONFIG += silent
 # Don't allow deprecated versions of methods (before Qt 6.8)
 DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060800
 
+# Count allocations per traced method (qmake CONFIG+=trace_allocations)
+trace_allocations {
+    DEFINES += TRACE_ALLOCATIONS
+    SOURCES += shared/AllocationHooks.cpp
+}
+
 # Shared classes
 HEADERS += shared/CallTracer.h
 SOURCES += shared/CallTracer.cpp
@@ -33,16 +39,32 @@ HEADERS += shared/DatabaseHelper.h
 SOURCES += shared/DatabaseHelper.cpp
 HEADERS += shared/MessageLogger.h
 SOURCES += shared/MessageLogger.cpp
+HEADERS += shared/SignalHandler.h
+SOURCES += shared/SignalHandler.cpp
 HEADERS += shared/StringHelper.h
 SOURCES += shared/StringHelper.cpp
 
 # Specific classes
 HEADERS += src/Application.h
 SOURCES += src/Application.cpp
+HEADERS += src/ArchiveBackend.h
+SOURCES += src/ArchiveBackend.cpp
+HEADERS += src/ColumnArchive.h
+SOURCES += src/ColumnArchive.cpp
 HEADERS += src/Config.h
 HEADERS += src/Deploy.h
 SOURCES += src/main.cpp
 HEADERS += src/MainWindow.h
 SOURCES += src/MainWindow.cpp
+HEADERS += src/MemoryBackend.h
+SOURCES += src/MemoryBackend.cpp
+HEADERS += src/QueryResult.h
+SOURCES += src/QueryResult.cpp
+HEADERS += src/RollupBuilder.h
+SOURCES += src/RollupBuilder.cpp
+HEADERS += src/SqliteBackend.h
+SOURCES += src/SqliteBackend.cpp
+HEADERS += src/StorageBackend.h
+SOURCES += src/StorageBackend.cpp
 HEADERS += src/WundergroundComms.h
 SOURCES += src/WundergroundComms.cpp
@@ -0,0 +1,218 @@
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// AllocationHooks.cpp
+// Replaced global operator new/delete (and, with glibc, malloc), counting
+// every allocation for the method on top of CallTracer's call stack.
+// Only built with qmake CONFIG+=trace_allocations; see
+// CallTracer::GetAllocationReport().
+//
+// Qt's containers and strings (QString, QByteArray, QList) allocate with
+// malloc() rather than operator new, so with glibc, malloc(), calloc() and
+// realloc() are replaced as well; they hand over to glibc's own allocator.
+// Elsewhere, only operator new is counted.
+//
+// Nothing in here may use CALL_IN/CALL_OUT, Qt or anything else that
+// allocates.
+
+// Project includes
+#include "CallTracer.h"
+
+// System includes
+#include <cstdlib>
+#include <new>
+
+
+
+// ===================================================================== malloc
+
+
+
+#ifdef __GLIBC__
+// glibc's allocator, under the names it also exports it by
+extern "C"
+{
+    void * __libc_malloc(size_t mSize);
+    void * __libc_calloc(size_t mNumber, size_t mSize);
+    void * __libc_realloc(void * mpMemory, size_t mSize);
+    void __libc_free(void * mpMemory);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocate
+extern "C" void * malloc(size_t mSize)
+{
+    CallTracer::CountAllocation(qint64(mSize));
+    return __libc_malloc(mSize);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocate zeroed memory
+extern "C" void * calloc(size_t mNumber, size_t mSize)
+{
+    CallTracer::CountAllocation(qint64(mNumber * mSize));
+    return __libc_calloc(mNumber, mSize);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Grow or shrink (counts as an allocation of the new size)
+extern "C" void * realloc(void * mpMemory, size_t mSize)
+{
+    CallTracer::CountAllocation(qint64(mSize));
+    return __libc_realloc(mpMemory, mSize);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Free
+extern "C" void free(void * mpMemory)
+{
+    __libc_free(mpMemory);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory for operator new (counted by operator new already)
+static void * RawAllocate(const std::size_t mcSize)
+{
+    return __libc_malloc(mcSize);
+}
+#else
+///////////////////////////////////////////////////////////////////////////////
+// Memory for operator new
+static void * RawAllocate(const std::size_t mcSize)
+{
+    return std::malloc(mcSize);
+}
+#endif
+
+
+
+// ============================================================= operator new
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocate (throwing)
+static void * Allocate(std::size_t mSize)
+{
+    CallTracer::CountAllocation(qint64(mSize));
+    if (mSize == 0)
+    {
+        mSize = 1;
+    }
+    while (true)
+    {
+        void * memory = RawAllocate(mSize);
+        if (memory)
+        {
+            return memory;
+        }
+
+        // Out of memory: try the new handler, as the standard one does
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocate (not throwing)
+static void * AllocateNoThrow(const std::size_t mcSize) noexcept
+{
+    try
+    {
+        return Allocate(mcSize);
+    } catch (...)
+    {
+        return nullptr;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// operator new and operator new[]
+void * operator new(std::size_t mSize)
+{
+    return Allocate(mSize);
+}
+
+void * operator new[](std::size_t mSize)
+{
+    return Allocate(mSize);
+}
+
+void * operator new(std::size_t mSize, const std::nothrow_t &) noexcept
+{
+    return AllocateNoThrow(mSize);
+}
+
+void * operator new[](std::size_t mSize, const std::nothrow_t &) noexcept
+{
+    return AllocateNoThrow(mSize);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// operator delete and operator delete[]
+void operator delete(void * mpMemory) noexcept
+{
+    std::free(mpMemory);
+}
+
+void operator delete[](void * mpMemory) noexcept
+{
+    std::free(mpMemory);
+}
+
+void operator delete(void * mpMemory, std::size_t) noexcept
+{
+    std::free(mpMemory);
+}
+
+void operator delete[](void * mpMemory, std::size_t) noexcept
+{
+    std::free(mpMemory);
+}
+
+void operator delete(void * mpMemory, const std::nothrow_t &) noexcept
+{
+    std::free(mpMemory);
+}
+
+void operator delete[](void * mpMemory, const std::nothrow_t &) noexcept
+{
+    std::free(mpMemory);
+}
+
+// Over-aligned types (operator new(size_t, align_val_t)) keep the standard
+// library's versions, and aren't counted
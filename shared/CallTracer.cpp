@@ -24,11 +24,28 @@
 #include "StringHelper.h"
 
 // Qt includes
+#include <QAtomicInt>
+#include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
+#include <QFile>
 #include <QJsonDocument>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <QtEndian>
 #include <QUrl>
 
+// System includes
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
 
 
 // CallTracer cannot utilize any methods in classes that utilize CallTracer
@@ -65,11 +82,13 @@ CallTracer::~CallTracer()
 // Reset history
 void CallTracer::ResetHistory()
 {
-    m_CallStack_Time.clear();
-    m_CallStack_Method.clear();
-    m_CallStack_Text.clear();
-    m_CallCount.clear();
-    m_OriginatorCount.clear();
+    // Methods currently being executed are kept; they still need to exit
+    m_HistoryFirst.storeRelaxed(m_HistoryNext.loadAcquire());
+    ForAllStatistics([](Statistics & mrStatistics)
+    {
+        mrStatistics.m_CallCount.clear();
+        mrStatistics.m_Callers.clear();
+    });
 }
 
 
@@ -78,121 +97,353 @@ void CallTracer::ResetHistory()
 // Set keeping all history
 void CallTracer::SetKeepAllHistory(const bool mcKeepHistory)
 {
-    m_KeepAllHistory = mcKeepHistory;
+    m_KeepAllHistory.storeRelaxed(mcKeepHistory);
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Enter function
-void CallTracer::EnterFunction(const QString mcFilename,
-    const QString mcFunction, const QString mcParameters)
+int CallTracer::EnterFunction(const int mcMethodID,
+    const void * mcpParameters, QString (* mcpFormat)(const void *))
 {
-    const QString timestamp =
-        QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-    const QString class_name = ClassName(mcFilename);
+    // Allocations so far were made by the calling method
+    const qint64 caller_allocations = m_ThreadAllocations;
+    const qint64 caller_allocated_bytes = m_ThreadAllocatedBytes;
+    m_ThreadAllocations = 0;
+    m_ThreadAllocatedBytes = 0;
+
+    // Parameters are formatted right away only if they are needed after the
+    // method has been left, or shown now. (Before anything is changed here:
+    // formatting may call methods that are traced themselves.) The flight
+    // recorder alone doesn't need them; it only records the call.
+    const bool keep_history = m_KeepAllHistory.loadRelaxed();
+    const bool is_verbose = m_IsVerbose.loadRelaxed() ||
+        m_MethodIsVerbose[mcMethodID].loadRelaxed();
+    StackFrame frame { mcMethodID, GetTicks(), 0, QString(), mcpParameters,
+        mcpFormat, 0, 0 };
+    if (keep_history ||
+        is_verbose)
+    {
+        frame.m_Text = mcpFormat(mcpParameters);
+        frame.m_Parameters = nullptr;
+    }
+    if (keep_history ||
+        m_FlightRecorderOn.loadRelaxed())
+    {
+        AddToHistory(mcMethodID, 0, frame.m_Ticks, frame.m_Text);
+    }
 
     // Originator (method that called the current method)
-    QString caller_method;
-    if (!m_CallStack_Method.isEmpty())
+    ThreadData & thread_data = GetThreadData();
+    QVector < StackFrame > & call_stack = thread_data.m_CallStack;
+    const int caller_id = call_stack.isEmpty() ?
+        0 : call_stack.last().m_MethodID;
+    if (!call_stack.isEmpty())
     {
-        caller_method = m_CallStack_Method.last();
+        call_stack.last().m_Allocations += caller_allocations;
+        call_stack.last().m_AllocatedBytes += caller_allocated_bytes;
     }
 
     // Call count
-    const QString called_method = QString("%1::%2")
-        .arg(class_name,
-            mcFunction);
-    m_CallStack_Time << timestamp;
-    m_CallStack_Method << called_method;
-    m_CallStack_Text << QString("(%1)").arg(mcParameters);
-    m_CallCount[class_name][mcFunction]++;
+    call_stack << frame;
+    {
+        QMutexLocker lock(&thread_data.m_Mutex);
+        Statistics & statistics = thread_data.m_Statistics;
+        if (mcMethodID >= statistics.m_CallCount.size())
+        {
+            // Room for all methods registered so far
+            const int number_of_methods = m_NumberOfMethods.loadAcquire();
+            statistics.m_CallCount.resize(number_of_methods);
+            statistics.m_Callers.resize(number_of_methods);
+        }
+        statistics.m_CallCount[mcMethodID]++;
 
-    // Log originator
-    m_OriginatorCount[called_method][caller_method]++;
+        // Log originator
+        CountCaller(statistics.m_Callers[mcMethodID], caller_id, 1);
+    }
 
     // Print on screen if required
-    if (m_IsVerbose)
+    if (is_verbose)
+    {
+        qDebug().noquote() << tr("Enter: %1 %2(%3)")
+            .arg(FormatTicks(frame.m_Ticks),
+                m_MethodNames[mcMethodID],
+                frame.m_Text);
+    }
+
+    // Our own allocations aren't charged to anyone
+    m_ThreadAllocations = 0;
+    m_ThreadAllocatedBytes = 0;
+
+    return int(call_stack.size()) - 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Object formatting parameters goes out of scope
+void CallTracer::ReleaseParameters(const int mcPosition,
+    const void * mcpParameters)
+{
+    // Usually, the method has been exited and the frame is gone
+    QVector < StackFrame > & call_stack = GetThreadData().m_CallStack;
+    if (mcPosition >= call_stack.size() ||
+        call_stack.at(mcPosition).m_Parameters != mcpParameters)
     {
-        qDebug().noquote() << tr("Enter: %1 %2%3")
-            .arg(m_CallStack_Time.last(),
-                m_CallStack_Method.last(),
-                m_CallStack_Text.last());
+        return;
     }
+
+    // Missing CALL_OUT(): keep the text, not the object (formatting may
+    // call methods that are traced themselves)
+    const QString text = call_stack.at(mcPosition).m_Format(mcpParameters);
+    call_stack[mcPosition].m_Text = text;
+    call_stack[mcPosition].m_Parameters = nullptr;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Exit function
-void CallTracer::ExitFunction(const QString mcFilename,
-    const QString mcFunction, const int mcLine, const QString mcReason)
+void CallTracer::ExitFunction(const int mcMethodID, const int mcLine,
+    const void * mcpReason, QString (* mcpFormat)(const void *))
 {
-    // Full method name
-    const QString class_name = ClassName(mcFilename);
-    const QString full_method = QString("%1::%2")
-        .arg(class_name,
-            mcFunction);
+    // Reason is formatted only if it is shown or kept. (Before anything is
+    // changed here: formatting may call methods that are traced themselves.)
+    const bool keep_history = m_KeepAllHistory.loadRelaxed();
+    const bool is_verbose = m_IsVerbose.loadRelaxed() ||
+        m_MethodIsVerbose[mcMethodID].loadRelaxed();
+    const QString reason = (keep_history || is_verbose ?
+        mcpFormat(mcpReason) : QString());
+
+    // Allocations since the call stack last changed were made by this method
+    const qint64 allocations = m_ThreadAllocations;
+    const qint64 allocated_bytes = m_ThreadAllocatedBytes;
+    m_ThreadAllocations = 0;
+    m_ThreadAllocatedBytes = 0;
 
     // Check if we just ran out of stack
     // (happens if we forget to have a CALL_IN() but we do a CALL_OUT()
-    if (m_CallStack_Method.isEmpty())
+    ThreadData & thread_data = GetThreadData();
+    QVector < StackFrame > & call_stack = thread_data.m_CallStack;
+    if (call_stack.isEmpty())
     {
         // That shouldn't happen!
         qDebug().noquote() << tr("CallTracer::ExitFunction(): Ran out of "
             "stack when exiting \"%1\" - probably a missing CALL_IN().")
-            .arg(full_method);
+            .arg(m_MethodNames[mcMethodID]);
         return;
     }
 
     // Check if exiting function mathes last incoming method
-    if (m_CallStack_Method.last() != full_method)
+    if (call_stack.last().m_MethodID != mcMethodID)
     {
         // That shouldn't happen!
         qDebug().noquote() << tr("CallTracer::ExitFunction(): Mismatching "
             "method names exiting method %1 (matching incoming method is %2)")
-            .arg(full_method,
-                m_CallStack_Method.last());
+            .arg(m_MethodNames[mcMethodID],
+                m_MethodNames[call_stack.last().m_MethodID]);
         return;
     }
 
+    // Time spent in the method, and in the one that called it
+    const qint64 ticks = GetTicks();
+    const qint64 inclusive_ns = ticks - call_stack.last().m_Ticks;
+    {
+        const StackFrame & frame = call_stack.last();
+        QMutexLocker lock(&thread_data.m_Mutex);
+        RecordProfile(thread_data.m_Statistics, mcMethodID, inclusive_ns,
+            inclusive_ns - frame.m_ChildrenNS,
+            frame.m_Allocations + allocations,
+            frame.m_AllocatedBytes + allocated_bytes);
+    }
+    call_stack.removeLast();
+    if (!call_stack.isEmpty())
+    {
+        call_stack.last().m_ChildrenNS += inclusive_ns;
+    }
+
     // Print on screen if required
-    const QString timestamp = CALL_TIMESTAMP;
-    if (m_IsVerbose)
+    if (is_verbose)
     {
-        if (mcReason.isEmpty())
+        if (reason.isEmpty())
         {
             qDebug().noquote() << tr("Exit: %1 %2()")
-                .arg(timestamp,
-                     full_method);
+                .arg(FormatTicks(ticks),
+                     m_MethodNames[mcMethodID]);
         } else
         {
             qDebug().noquote() << tr("Exit: %1 %2(): %3")
-                .arg(timestamp,
-                     full_method,
-                     mcReason);
+                .arg(FormatTicks(ticks),
+                     m_MethodNames[mcMethodID],
+                     reason);
         }
     }
 
-    if (m_KeepAllHistory)
+    // History (the flight recorder alone only needs the call itself)
+    if (keep_history ||
+        m_FlightRecorderOn.loadRelaxed())
     {
-        m_CallStack_Time << timestamp;
-        m_CallStack_Method << QString("%1 (%2)")
-            .arg(full_method,
-                 QString::number(mcLine));
-        if (mcReason.isEmpty())
+        AddToHistory(mcMethodID, mcLine, ticks, reason);
+    }
+
+    // Our own allocations aren't charged to anyone
+    m_ThreadAllocations = 0;
+    m_ThreadAllocatedBytes = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add entry to the call history
+void CallTracer::AddToHistory(const int mcMethodID, const int mcLine,
+    const qint64 mcTicks, const QString & mcrText)
+{
+    // Reserve an entry; it's invalid until it has been written
+    const quint64 index = m_HistoryNext.fetchAndAddRelaxed(1);
+    HistoryRecord & record = m_History[index % HISTORY_SIZE];
+    record.m_Sequence.storeRelaxed(0);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record.m_Ticks = mcTicks;
+    record.m_MethodID = mcMethodID;
+    record.m_Line = mcLine;
+    record.m_ThreadNumber = GetThreadNumber();
+
+    // Text as UTF-8, as much as fits (no allocation)
+    int length = 0;
+    for (const QChar character : mcrText)
+    {
+        const ushort code = character.unicode();
+        if (code < 0x80)
+        {
+            if (length + 1 > HISTORY_TEXT_SIZE)
+            {
+                break;
+            }
+            record.m_Text[length++] = char(code);
+        } else if (code < 0x800)
+        {
+            if (length + 2 > HISTORY_TEXT_SIZE)
+            {
+                break;
+            }
+            record.m_Text[length++] = char(0xc0 | (code >> 6));
+            record.m_Text[length++] = char(0x80 | (code & 0x3f));
+        } else if (character.isSurrogate())
         {
-            m_CallStack_Text << tr(": leaving");
+            // Outside the Basic Multilingual Plane; rare enough
+            if (length + 1 > HISTORY_TEXT_SIZE)
+            {
+                break;
+            }
+            record.m_Text[length++] = '?';
         } else
         {
-            m_CallStack_Text << tr(": leaving (%1)").arg(mcReason);
+            if (length + 3 > HISTORY_TEXT_SIZE)
+            {
+                break;
+            }
+            record.m_Text[length++] = char(0xe0 | (code >> 12));
+            record.m_Text[length++] = char(0x80 | ((code >> 6) & 0x3f));
+            record.m_Text[length++] = char(0x80 | (code & 0x3f));
         }
-    } else
+    }
+    record.m_TextLength = length;
+
+    record.m_Sequence.storeRelease(index + 1);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Call history or call stack
+QList < CallTracer::TraceEntry > CallTracer::GetTraceEntries()
+{
+    QList < TraceEntry > entries;
+
+    // Call stack: parameters are formatted now (which may call methods that
+    // are traced themselves, so work on a copy)
+    if (!m_KeepAllHistory.loadRelaxed())
     {
-        m_CallStack_Time.takeLast();
-        m_CallStack_Method.takeLast();
-        m_CallStack_Text.takeLast();
+        const QVector < StackFrame > call_stack =
+            GetThreadData().m_CallStack;
+        for (const StackFrame & frame : call_stack)
+        {
+            entries << TraceEntry { frame.m_Ticks, frame.m_MethodID, 0,
+                GetThreadNumber(), frame.m_Parameters ?
+                    frame.m_Format(frame.m_Parameters) : frame.m_Text };
+        }
+        return entries;
     }
+
+    // History: entries that are still there and aren't being written
+    const quint64 next = m_HistoryNext.loadAcquire();
+    quint64 first = m_HistoryFirst.loadRelaxed();
+    if (next > HISTORY_SIZE)
+    {
+        first = qMax(first, next - HISTORY_SIZE);
+    }
+    for (quint64 index = first; index < next; index++)
+    {
+        const HistoryRecord & record = m_History[index % HISTORY_SIZE];
+        if (record.m_Sequence.loadAcquire() != index + 1)
+        {
+            continue;
+        }
+        TraceEntry entry { record.m_Ticks, record.m_MethodID, record.m_Line,
+            record.m_ThreadNumber, QString() };
+        char text[HISTORY_TEXT_SIZE];
+        const int length = qBound(0, int(record.m_TextLength),
+            HISTORY_TEXT_SIZE);
+        memcpy(text, record.m_Text, length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (record.m_Sequence.loadRelaxed() != index + 1 ||
+            entry.m_MethodID < 0 ||
+            entry.m_MethodID >= m_NumberOfMethods.loadAcquire())
+        {
+            continue;
+        }
+        entry.m_Text = QString::fromUtf8(text, length);
+        entries << entry;
+    }
+    return entries;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// One entry of a trace
+QString CallTracer::FormatTraceEntry(const TraceEntry & mcrEntry,
+    const QString & mcrTime, const QString & mcrMethodName)
+{
+    if (mcrEntry.m_Line < 0)
+    {
+        // Log line
+        return QString("%1 %2")
+            .arg(mcrTime,
+                mcrEntry.m_Text);
+    }
+    if (mcrEntry.m_Line == 0)
+    {
+        return QString("%1 %2(%3)")
+            .arg(mcrTime,
+                mcrMethodName,
+                mcrEntry.m_Text);
+    }
+    if (mcrEntry.m_Text.isEmpty())
+    {
+        return QString("%1 %2 (%3)%4")
+            .arg(mcrTime,
+                mcrMethodName,
+                QString::number(mcrEntry.m_Line),
+                tr(": leaving"));
+    }
+    return QString("%1 %2 (%3)%4")
+        .arg(mcrTime,
+            mcrMethodName,
+            QString::number(mcrEntry.m_Line),
+            tr(": leaving (%1)").arg(mcrEntry.m_Text));
 }
 
 
@@ -202,12 +453,10 @@ void CallTracer::ExitFunction(const QString mcFilename,
 QString CallTracer::GetCallTrace()
 {
     QString trace = tr("--------- Trace start\n");
-    for (int index = 0; index < m_CallStack_Time.size(); index++)
+    for (const TraceEntry & entry : GetTraceEntries())
     {
-        trace += QString("%1 %2%3\n")
-            .arg(m_CallStack_Time[index],
-                m_CallStack_Method[index],
-                m_CallStack_Text[index]);
+        trace += FormatTraceEntry(entry, FormatTicks(entry.m_Ticks),
+            m_MethodNames[entry.m_MethodID]) + "\n";
     }
     trace += tr("--------- Trace end\n\n");
 
@@ -216,6 +465,71 @@ QString CallTracer::GetCallTrace()
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Write Chrome trace events
+bool CallTracer::WriteChromeTrace(const QString & mcrFilename)
+{
+    const QList < TraceEntry > entries = GetTraceEntries();
+
+    QFile file(mcrFilename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+
+    // Process name, so the timeline isn't labelled with a number only
+    const qint64 process_id = QCoreApplication::applicationPid();
+    QJsonObject process_name;
+    process_name["name"] = "process_name";
+    process_name["ph"] = "M";
+    process_name["pid"] = process_id;
+    process_name["args"] = QJsonObject { { "name",
+        QCoreApplication::applicationName() } };
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    file.write(QJsonDocument(process_name).toJson(QJsonDocument::Compact));
+
+    // One event per line ("B" entering, "E" exiting, "i" log line; time in
+    // microseconds)
+    for (const TraceEntry & entry : entries)
+    {
+        QJsonObject trace_event;
+        trace_event["name"] = m_MethodNames[entry.m_MethodID];
+        trace_event["cat"] = m_ClassNames[entry.m_MethodID];
+        trace_event["pid"] = process_id;
+        trace_event["tid"] = entry.m_ThreadNumber;
+        trace_event["ts"] = (entry.m_Ticks - m_StartTicks) / 1000.;
+        QJsonObject arguments;
+        if (entry.m_Line < 0)
+        {
+            trace_event["name"] = entry.m_Text;
+            trace_event["cat"] = "log";
+            trace_event["ph"] = "i";
+            trace_event["s"] = "t";
+        } else if (entry.m_Line == 0)
+        {
+            trace_event["ph"] = "B";
+            arguments["parameters"] = entry.m_Text;
+        } else
+        {
+            trace_event["ph"] = "E";
+            arguments["line"] = entry.m_Line;
+            if (!entry.m_Text.isEmpty())
+            {
+                arguments["reason"] = entry.m_Text;
+            }
+        }
+        trace_event["args"] = arguments;
+        file.write(",\n");
+        file.write(QJsonDocument(trace_event)
+            .toJson(QJsonDocument::Compact));
+    }
+    file.write("\n]}\n");
+
+    return file.error() == QFileDevice::NoError;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Class name
 QString CallTracer::ClassName(const QString mcFilename)
@@ -237,40 +551,556 @@ QString CallTracer::ClassName(const QString mcFilename)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Call stacks
-QList < QString > CallTracer::m_CallStack_Time;
-QList < QString > CallTracer::m_CallStack_Method;
-QList < QString > CallTracer::m_CallStack_Text;
+// Steady clock
+qint64 CallTracer::GetTicks()
+{
+    return std::chrono::duration_cast < std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Steady clock time stamp as date and time
+QString CallTracer::FormatTicks(const qint64 mcTicks)
+{
+    return m_StartTime.addMSecs((mcTicks - m_StartTicks) / 1000000)
+        .toString("yyyy-MM-dd hh:mm:ss.zzz");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of the current thread
+int CallTracer::GetThreadNumber()
+{
+    static QAtomicInt last_number;
+    thread_local const int thread_number =
+        last_number.fetchAndAddRelaxed(1) + 1;
+    return thread_number;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start of the program
+const qint64 CallTracer::m_StartTicks = CallTracer::GetTicks();
+const QDateTime CallTracer::m_StartTime = QDateTime::currentDateTime();
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Call history
+CallTracer::HistoryRecord CallTracer::m_History[CallTracer::HISTORY_SIZE];
+QAtomicInteger < quint64 > CallTracer::m_HistoryNext;
+QAtomicInteger < quint64 > CallTracer::m_HistoryFirst;
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Keeping history
-bool CallTracer::m_KeepAllHistory = false;
+QAtomicInteger < bool > CallTracer::m_KeepAllHistory = false;
 
 
 
-// =============================================================== Method usage
+// ============================================================ Flight recorder
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Reset usage
-void CallTracer::ResetUsage(const QString mcClass, const QString mcMethod)
+// Start keeping history for a flight record
+bool CallTracer::StartFlightRecorder(const QString & mcrFilename)
 {
-    if (mcClass.isEmpty())
+    // Everything the signal handler needs, prepared while Qt may be used
+    const QByteArray filename = QFile::encodeName(mcrFilename);
+    if (filename.isEmpty() ||
+        filename.size() >= MAX_FILENAME_SIZE)
+    {
+        return false;
+    }
+    memcpy(m_FlightRecordFilename, filename.constData(), filename.size());
+    m_FlightRecordFilename[filename.size()] = 0;
+    m_StartTimeMS = m_StartTime.toMSecsSinceEpoch();
+
+    // Crash handlers run on a stack of their own, and are reset before
+    // they run, so crashing again is fatal
+    stack_t signal_stack;
+    signal_stack.ss_sp = m_SignalStack;
+    signal_stack.ss_size = SIGNAL_STACK_SIZE;
+    signal_stack.ss_flags = 0;
+    struct sigaction action;
+    action.sa_handler = CallTracer::CrashSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK | SA_RESETHAND;
+    if (sigaltstack(&signal_stack, nullptr) != 0 ||
+        sigaction(SIGSEGV, &action, nullptr) != 0 ||
+        sigaction(SIGBUS, &action, nullptr) != 0 ||
+        sigaction(SIGFPE, &action, nullptr) != 0 ||
+        sigaction(SIGILL, &action, nullptr) != 0 ||
+        sigaction(SIGABRT, &action, nullptr) != 0)
+    {
+        return false;
+    }
+
+    m_FlightRecorderOn.storeRelease(true);
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write flight record
+void CallTracer::WriteFlightRecord(const int mcSignal)
+{
+    // Only async-signal-safe calls in here: no Qt, no allocation.
+
+    if (!m_FlightRecorderOn.loadAcquire())
+    {
+        return;
+    }
+
+    // One thread at a time (another one may crash meanwhile)
+    if (!m_WritingFlightRecord.testAndSetAcquire(0, 1))
+    {
+        return;
+    }
+
+    const int file = ::open(m_FlightRecordFilename,
+        O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file != -1)
+    {
+        FlightRecordHeader header;
+        memcpy(header.m_Magic, FLIGHT_RECORD_MAGIC, sizeof(header.m_Magic));
+        header.m_Version = FLIGHT_RECORD_VERSION;
+        header.m_Signal = mcSignal;
+        header.m_ProcessID = ::getpid();
+        header.m_StartTicks = m_StartTicks;
+        header.m_StartTime = m_StartTimeMS;
+        header.m_WriteTicks = GetTicks();
+        header.m_HistoryNext = m_HistoryNext.loadAcquire();
+        header.m_HistoryFirst = m_HistoryFirst.loadRelaxed();
+        header.m_HistorySize = HISTORY_SIZE;
+        header.m_RecordSize = sizeof(HistoryRecord);
+        header.m_NameTableSize = m_NameTableSize.loadAcquire();
+        header.m_Reserved = 0;
+
+        // Entries written meanwhile are sorted out when decoding
+        if (WriteAll(file, reinterpret_cast < const char * >(&header),
+                sizeof(header)))
+        {
+            if (WriteAll(file, m_NameTable, header.m_NameTableSize))
+            {
+                WriteAll(file, reinterpret_cast < const char * >(m_History),
+                    sizeof(m_History));
+            }
+        }
+        ::close(file);
+    }
+
+    m_WritingFlightRecord.storeRelease(0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read flight record
+bool CallTracer::DecodeFlightRecord(const QString & mcrFilename,
+    QString & mrTrace)
+{
+    QFile file(mcrFilename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    const QByteArray data = file.readAll();
+
+    // Check if this is a flight record of this build
+    FlightRecordHeader header;
+    if (data.size() < qsizetype(sizeof(header)))
+    {
+        return false;
+    }
+    memcpy(&header, data.constData(), sizeof(header));
+    if (memcmp(header.m_Magic, FLIGHT_RECORD_MAGIC,
+            sizeof(header.m_Magic)) != 0 ||
+        header.m_Version != FLIGHT_RECORD_VERSION ||
+        header.m_HistorySize != HISTORY_SIZE ||
+        header.m_RecordSize != qint32(sizeof(HistoryRecord)) ||
+        header.m_NameTableSize < 0 ||
+        header.m_NameTableSize > NAME_TABLE_SIZE ||
+        data.size() != qsizetype(sizeof(header) + header.m_NameTableSize +
+            sizeof(m_History)))
+    {
+        return false;
+    }
+
+    // Method names (ID 0 is "no method")
+    QStringList method_names = QString::fromUtf8(
+        data.constData() + sizeof(header), header.m_NameTableSize)
+        .split("\n", Qt::SkipEmptyParts);
+    method_names.prepend(QString());
+
+    // Time stamps as date and time
+    const QDateTime start_time =
+        QDateTime::fromMSecsSinceEpoch(header.m_StartTime);
+    auto format_ticks = [&](const qint64 mcTicks)
+    {
+        return start_time.addMSecs((mcTicks - header.m_StartTicks) / 1000000)
+            .toString("yyyy-MM-dd hh:mm:ss.zzz");
+    };
+
+    mrTrace = tr("--------- Flight record of process %1, written %2 "
+        "(signal %3)\n")
+        .arg(QString::number(header.m_ProcessID),
+            format_ticks(header.m_WriteTicks),
+            QString::number(header.m_Signal));
+
+    // Entries that are still there and were complete
+    const char * history = data.constData() + sizeof(header) +
+        header.m_NameTableSize;
+    const quint64 next = header.m_HistoryNext;
+    quint64 first = header.m_HistoryFirst;
+    if (next > HISTORY_SIZE)
+    {
+        first = qMax(first, next - HISTORY_SIZE);
+    }
+    for (quint64 index = first; index < next; index++)
+    {
+        const char * record =
+            history + (index % HISTORY_SIZE) * sizeof(HistoryRecord);
+        if (qFromUnaligned < quint64 >(
+                record + offsetof(HistoryRecord, m_Sequence)) != index + 1)
+        {
+            continue;
+        }
+        TraceEntry entry;
+        entry.m_Ticks = qFromUnaligned < qint64 >(
+            record + offsetof(HistoryRecord, m_Ticks));
+        entry.m_MethodID = qFromUnaligned < qint32 >(
+            record + offsetof(HistoryRecord, m_MethodID));
+        entry.m_Line = qFromUnaligned < qint32 >(
+            record + offsetof(HistoryRecord, m_Line));
+        entry.m_ThreadNumber = qFromUnaligned < qint32 >(
+            record + offsetof(HistoryRecord, m_ThreadNumber));
+        const int length = qBound(0, int(qFromUnaligned < qint32 >(
+            record + offsetof(HistoryRecord, m_TextLength))),
+            HISTORY_TEXT_SIZE);
+        entry.m_Text = QString::fromUtf8(
+            record + offsetof(HistoryRecord, m_Text), length);
+        if (entry.m_MethodID < 0)
+        {
+            continue;
+        }
+
+        // Methods registered once the name table was full have no name
+        const QString method_name = entry.m_MethodID < method_names.size() ?
+            method_names[entry.m_MethodID] :
+            QString("#%1").arg(entry.m_MethodID);
+        mrTrace += QString("%1: %2\n")
+            .arg(QString::number(entry.m_ThreadNumber),
+                FormatTraceEntry(entry, format_ticks(entry.m_Ticks),
+                    method_name));
+    }
+    mrTrace += tr("--------- Flight record end\n");
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add log line to the history
+void CallTracer::AddLogLine(const QString & mcrLine)
+{
+    if (m_KeepAllHistory.loadRelaxed() ||
+        m_FlightRecorderOn.loadRelaxed())
     {
-        m_CallCount.clear();
+        AddToHistory(0, -1, GetTicks(), mcrLine);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Crash signal arrived
+void CallTracer::CrashSignalHandler(int mSignal)
+{
+    // Only async-signal-safe calls in here - no CALL_IN/CALL_OUT either.
+
+    WriteFlightRecord(mSignal);
+
+    // The handler has been reset, so this crashes as usual (core dump etc.)
+    // once we return
+    ::raise(mSignal);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write all of a buffer
+bool CallTracer::WriteAll(const int mcFile, const char * mcpData,
+    qint64 mSize)
+{
+    while (mSize > 0)
+    {
+        const ssize_t written = ::write(mcFile, mcpData, size_t(mSize));
+        if (written < 0 &&
+            errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        mcpData += written;
+        mSize -= written;
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Flight recorder
+QAtomicInteger < bool > CallTracer::m_FlightRecorderOn = false;
+char CallTracer::m_FlightRecordFilename[CallTracer::MAX_FILENAME_SIZE] = {};
+qint64 CallTracer::m_StartTimeMS = 0;
+QAtomicInt CallTracer::m_WritingFlightRecord;
+char CallTracer::m_NameTable[CallTracer::NAME_TABLE_SIZE] = {};
+QAtomicInt CallTracer::m_NameTableSize;
+bool CallTracer::m_NameTableFull = false;
+char CallTracer::m_SignalStack[CallTracer::SIGNAL_STACK_SIZE] = {};
+
+
+
+// ============================================================ Method registry
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Register method
+int CallTracer::RegisterMethod(const char * mcpFilename,
+    const char * mcpFunction)
+{
+    QMutexLocker lock(&m_RegistryMutex);
+
+    // ID 0 is "no method" (the originator of top-level calls)
+    const int number_of_methods = m_NumberOfMethods.loadRelaxed();
+    const QString class_name = ClassName(QString::fromUtf8(mcpFilename));
+    const QString function_name = QString::fromUtf8(mcpFunction);
+    const QString method_name = QString("%1::%2")
+        .arg(class_name,
+            function_name);
+    if (m_MethodIDs.contains(method_name))
+    {
+        return m_MethodIDs[method_name];
+    }
+    if (number_of_methods == MAX_METHODS)
+    {
+        // Counted as "no method" from here on
+        qDebug().noquote() << tr("CallTracer::RegisterMethod(): Too many "
+            "methods; %1 is not traced.").arg(method_name);
+        m_MethodIDs[method_name] = 0;
+        return 0;
+    }
+
+    // Entries are complete before the new number is published
+    const int method_id = number_of_methods;
+    m_ClassNames[method_id] = class_name;
+    m_FunctionNames[method_id] = function_name;
+    m_MethodNames[method_id] = method_name;
+    m_MethodIDs[method_name] = method_id;
+    ApplyScopes(method_id);
+    m_NumberOfMethods.storeRelease(method_id + 1);
+
+    // Name for flight records (which are written without Qt)
+    const QByteArray name_line = (method_name + "\n").toUtf8();
+    const int table_size = m_NameTableSize.loadRelaxed();
+    if (m_NameTableFull ||
+        table_size + name_line.size() > NAME_TABLE_SIZE)
+    {
+        m_NameTableFull = true;
     } else
     {
-        if (mcMethod.isEmpty())
+        memcpy(m_NameTable + table_size, name_line.constData(),
+            name_line.size());
+        m_NameTableSize.storeRelease(table_size + name_line.size());
+    }
+
+    return method_id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class name of a method
+QString CallTracer::GetClassName(const int mcMethodID)
+{
+    if (mcMethodID < 0 ||
+        mcMethodID >= m_NumberOfMethods.loadAcquire())
+    {
+        return QString();
+    }
+    return m_ClassNames[mcMethodID];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Full name of a method
+QString CallTracer::GetMethodName(const int mcMethodID)
+{
+    if (mcMethodID < 0 ||
+        mcMethodID >= m_NumberOfMethods.loadAcquire())
+    {
+        return QString();
+    }
+    return m_MethodNames[mcMethodID];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Registry
+QHash < QString, int > CallTracer::m_MethodIDs;
+QString CallTracer::m_ClassNames[CallTracer::MAX_METHODS];
+QString CallTracer::m_FunctionNames[CallTracer::MAX_METHODS];
+QString CallTracer::m_MethodNames[CallTracer::MAX_METHODS];
+QAtomicInt CallTracer::m_NumberOfMethods = 1;
+QMutex CallTracer::m_RegistryMutex;
+
+
+
+// ===================================================================== Scopes
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Choose which classes and methods are traced
+bool CallTracer::SetScopes(const QString & mcrScopes)
+{
+    // Parse rules
+    QList < ScopeRule > rules;
+    const QStringList all_rules = mcrScopes.split(",", Qt::SkipEmptyParts);
+    for (const QString & rule_text : all_rules)
+    {
+        const QStringList parts = rule_text.trimmed().split("=");
+        if (parts.size() != 2 ||
+            parts[0].trimmed().isEmpty())
+        {
+            return false;
+        }
+        ScopeRule rule { parts[0].trimmed(), 1, false };
+        const QString setting = parts[1].trimmed().toLower();
+        if (setting == "off")
+        {
+            rule.m_Rate = 0;
+        } else if (setting == "on")
         {
-            m_CallCount[mcClass].clear();
+            rule.m_Rate = 1;
+        } else if (setting == "verbose")
+        {
+            rule.m_IsVerbose = true;
         } else
         {
-            m_CallCount[mcClass].remove(mcMethod);
+            bool ok = false;
+            rule.m_Rate = setting.toInt(&ok);
+            if (!ok ||
+                rule.m_Rate < 1)
+            {
+                return false;
+            }
+        }
+        rules << rule;
+    }
+
+    // Apply them to the methods we already know
+    QMutexLocker lock(&m_RegistryMutex);
+    m_ScopeRules = rules;
+    const int number_of_methods = m_NumberOfMethods.loadRelaxed();
+    for (int method_id = 1; method_id < number_of_methods; method_id++)
+    {
+        ApplyScopes(method_id);
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Apply rules to a method
+void CallTracer::ApplyScopes(const int mcMethodID)
+{
+    // Last matching rule wins
+    int rate = 1;
+    bool is_verbose = false;
+    for (const ScopeRule & rule : std::as_const(m_ScopeRules))
+    {
+        if (rule.m_Scope == "*" ||
+            rule.m_Scope == m_ClassNames[mcMethodID] ||
+            rule.m_Scope == m_MethodNames[mcMethodID])
+        {
+            rate = rule.m_Rate;
+            is_verbose = rule.m_IsVerbose;
         }
     }
+    m_MethodIsVerbose[mcMethodID].storeRelaxed(is_verbose);
+    m_TraceRate[mcMethodID].storeRelaxed(rate);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Pick one of mcRate calls
+bool CallTracer::IsSampled(const int mcRate)
+{
+    // Xorshift; every thread has a sequence of its own
+    thread_local quint32 state = 2463534242u + quint32(GetThreadNumber());
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % quint32(mcRate) == 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Rules
+QList < CallTracer::ScopeRule > CallTracer::m_ScopeRules;
+QAtomicInt CallTracer::m_TraceRate[CallTracer::MAX_METHODS];
+QAtomicInteger < bool >
+    CallTracer::m_MethodIsVerbose[CallTracer::MAX_METHODS];
+
+
+
+// =============================================================== Method usage
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset usage
+void CallTracer::ResetUsage(const QString mcClass, const QString mcMethod)
+{
+    ForAllStatistics([&](Statistics & mrStatistics)
+    {
+        if (mcClass.isEmpty())
+        {
+            mrStatistics.m_CallCount.clear();
+            return;
+        }
+        for (int method_id = 0;
+             method_id < mrStatistics.m_CallCount.size();
+             method_id++)
+        {
+            if (m_ClassNames[method_id] == mcClass &&
+                (mcMethod.isEmpty() ||
+                 m_FunctionNames[method_id] == mcMethod))
+            {
+                mrStatistics.m_CallCount[method_id] = 0;
+            }
+        }
+    });
 }
 
 
@@ -279,38 +1109,53 @@ void CallTracer::ResetUsage(const QString mcClass, const QString mcMethod)
 // Show message usage
 void CallTracer::ShowUsage(const QString mcClass, const QString mcMethod)
 {
-    if (mcClass.isEmpty())
+    // All threads, by class and method
+    const QVector < int > all_counts = GetStatistics().m_CallCount;
+    QHash < QString, QHash < QString, int > > call_count;
+    for (int method_id = 1; method_id < all_counts.size(); method_id++)
     {
-        QList < QString > all_classes = m_CallCount.keys();
-        std::sort(all_classes.begin(), all_classes.end());
-        for (auto class_iterator = all_classes.begin();
-             class_iterator != all_classes.end();
-             class_iterator++)
+        if (all_counts[method_id] > 0)
         {
-            const QString class_name = *class_iterator;
-            ShowUsage(class_name);
+            call_count[m_ClassNames[method_id]]
+                [m_FunctionNames[method_id]] = all_counts[method_id];
         }
+    }
+
+    QList < QString > all_classes;
+    if (mcClass.isEmpty())
+    {
+        all_classes = call_count.keys();
+        std::sort(all_classes.begin(), all_classes.end());
     } else
     {
+        all_classes << mcClass;
+    }
+    for (auto class_iterator = all_classes.begin();
+         class_iterator != all_classes.end();
+         class_iterator++)
+    {
+        const QString class_name = *class_iterator;
+        const QHash < QString, int > class_count = call_count[class_name];
+        QList < QString > all_methods;
         if (mcMethod.isEmpty())
         {
-            QList < QString > all_methods = m_CallCount[mcClass].keys();
+            all_methods = class_count.keys();
             std::sort(all_methods.begin(), all_methods.end());
-            for (auto method_iterator = all_methods.begin();
-                 method_iterator != all_methods.end();
-                 method_iterator++)
-            {
-                const QString method_name = *method_iterator;
-                ShowUsage(mcClass, method_name);
-            }
         } else
         {
+            all_methods << mcMethod;
+        }
+        for (auto method_iterator = all_methods.begin();
+             method_iterator != all_methods.end();
+             method_iterator++)
+        {
+            const QString method_name = *method_iterator;
             const QString count =
-                "      " + QString::number(m_CallCount[mcClass][mcMethod]);
+                "      " + QString::number(class_count[method_name]);
             qDebug().noquote() << QString("%1: %2::%3()")
                 .arg(count.right(7),
-                     mcClass,
-                     mcMethod);
+                     class_name,
+                     method_name);
         }
     }
 }
@@ -329,20 +1174,34 @@ void CallTracer::ShowCallOriginators(const QString mcClass,
 
     qDebug().noquote() << tr("Caller statistics for %1").arg(called_method);
 
-    if (!m_OriginatorCount.contains(called_method))
+    // All threads
+    const QVector < QVector < Statistics::CallerCount > > all_callers =
+        GetStatistics().m_Callers;
+    int method_id = 1;
+    while (method_id < all_callers.size() &&
+        m_MethodNames[method_id] != called_method)
+    {
+        method_id++;
+    }
+    if (method_id == all_callers.size() ||
+        all_callers[method_id].isEmpty())
     {
         qDebug().noquote() << tr("  This method has never been called.");
         return;
     }
 
     // Sort by frequency
-    QList < QString > sorted_keys =
-        StringHelper::SortHash(m_OriginatorCount[called_method]);
+    QHash < QString, int > callers;
+    for (const Statistics::CallerCount & caller : all_callers[method_id])
+    {
+        callers[m_MethodNames[caller.m_CallerID]] += caller.m_Count;
+    }
+    QList < QString > sorted_keys = StringHelper::SortHash(callers);
     while (!sorted_keys.isEmpty())
     {
         const QString calling_method = sorted_keys.takeLast();
         const QString count = "      " +
-            QString::number(m_OriginatorCount[called_method][calling_method]);
+            QString::number(callers[calling_method]);
         qDebug().noquote() << QString("%1: %2()")
             .arg(count.right(7),
                  calling_method);
@@ -352,31 +1211,378 @@ void CallTracer::ShowCallOriginators(const QString mcClass,
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Call count
-QHash < QString, QHash < QString, int > > CallTracer::m_CallCount =
-    QHash < QString, QHash < QString, int > > ();
+// Verbosity
+void CallTracer::SetVerbosity(const bool mcNewVerbosity)
+{
+    m_IsVerbose.storeRelaxed(mcNewVerbosity);
+}
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Originator count
-QHash < QString, QHash < QString, int > > CallTracer::m_OriginatorCount =
-    QHash < QString, QHash < QString, int > > ();
+// Verbosity
+QAtomicInteger < bool > CallTracer::m_IsVerbose = false;
+
+
+
+// ================================================================== Profiling
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Verbosity
-void CallTracer::SetVerbosity(const bool mcNewVerbosity)
+// Forget timings
+void CallTracer::ResetProfile()
 {
-    m_IsVerbose = mcNewVerbosity;
+    ForAllStatistics([](Statistics & mrStatistics)
+    {
+        mrStatistics.m_Profile.clear();
+    });
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Verbosity
-bool CallTracer::m_IsVerbose = false;
+// Profile as a printable table
+QStringList CallTracer::GetProfileReport(const int mcMaxMethods)
+{
+    // Percentiles are the upper end of the histogram bucket they fall in
+    auto percentile = [](const MethodProfile & mcrProfile,
+        const double mcFraction)
+    {
+        const qint64 target = qint64(std::ceil(mcFraction *
+            mcrProfile.m_Count));
+        qint64 seen = 0;
+        for (int bucket = 0;
+             bucket < mcrProfile.m_Histogram.size();
+             bucket++)
+        {
+            seen += mcrProfile.m_Histogram[bucket];
+            if (seen >= target)
+            {
+                return qMin(qint64(1) << bucket, mcrProfile.m_MaxNS);
+            }
+        }
+        return mcrProfile.m_MaxNS;
+    };
+
+    // Methods that have been called (on any thread), most self time first
+    const QVector < MethodProfile > all_profiles = GetStatistics().m_Profile;
+    QList < int > method_ids;
+    for (int method_id = 0; method_id < all_profiles.size(); method_id++)
+    {
+        if (all_profiles[method_id].m_Count > 0)
+        {
+            method_ids << method_id;
+        }
+    }
+    std::sort(method_ids.begin(), method_ids.end(),
+        [&](const int mcFirst, const int mcSecond)
+        {
+            return all_profiles[mcFirst].m_ExclusiveNS >
+                all_profiles[mcSecond].m_ExclusiveNS;
+        });
+
+    QStringList report;
+    report << tr("    calls   total ms    self ms   mean us    p99 us    "
+        "max us  method");
+    for (int index = 0;
+         index < method_ids.size() && index < mcMaxMethods;
+         index++)
+    {
+        const MethodProfile & profile = all_profiles[method_ids[index]];
+        report << QString("%1 %2 %3 %4 %5 %6  %7")
+            .arg(QString::number(profile.m_Count).rightJustified(9),
+                 QString::number(profile.m_InclusiveNS / 1e6, 'f', 1)
+                    .rightJustified(10),
+                 QString::number(profile.m_ExclusiveNS / 1e6, 'f', 1)
+                    .rightJustified(10),
+                 QString::number(profile.m_InclusiveNS / 1e3 /
+                    profile.m_Count, 'f', 1).rightJustified(9),
+                 QString::number(percentile(profile, 0.99) / 1e3, 'f', 1)
+                    .rightJustified(9),
+                 QString::number(profile.m_MaxNS / 1e3, 'f', 1)
+                    .rightJustified(9),
+                 GetMethodName(method_ids[index]));
+    }
+    return report;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Show profile
+void CallTracer::ShowProfile(const int mcMaxMethods)
+{
+    for (const QString & line : GetProfileReport(mcMaxMethods))
+    {
+        qDebug().noquote() << line;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Count an allocation
+void CallTracer::CountAllocation(const qint64 mcSize)
+{
+    // Called for every allocation, so no allocating in here
+    m_ThreadAllocations++;
+    m_ThreadAllocatedBytes += mcSize;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocations as a printable table
+QStringList CallTracer::GetAllocationReport(const int mcMaxMethods)
+{
+    // Methods that allocated (on any thread), most allocations first
+    const QVector < MethodProfile > all_profiles = GetStatistics().m_Profile;
+    QList < int > method_ids;
+    for (int method_id = 0; method_id < all_profiles.size(); method_id++)
+    {
+        if (all_profiles[method_id].m_Allocations > 0)
+        {
+            method_ids << method_id;
+        }
+    }
+    if (method_ids.isEmpty())
+    {
+        return QStringList();
+    }
+    std::sort(method_ids.begin(), method_ids.end(),
+        [&](const int mcFirst, const int mcSecond)
+        {
+            return all_profiles[mcFirst].m_Allocations >
+                all_profiles[mcSecond].m_Allocations;
+        });
+
+    QStringList report;
+    report << tr("    calls     allocs  per call      KB  bytes/call  method");
+    for (int index = 0;
+         index < method_ids.size() && index < mcMaxMethods;
+         index++)
+    {
+        const MethodProfile & profile = all_profiles[method_ids[index]];
+        report << QString("%1 %2 %3 %4 %5  %6")
+            .arg(QString::number(profile.m_Count).rightJustified(9),
+                 QString::number(profile.m_Allocations).rightJustified(10),
+                 QString::number(double(profile.m_Allocations) /
+                    profile.m_Count, 'f', 1).rightJustified(9),
+                 QString::number(profile.m_AllocatedBytes / 1024)
+                    .rightJustified(7),
+                 QString::number(double(profile.m_AllocatedBytes) /
+                    profile.m_Count, 'f', 0).rightJustified(11),
+                 GetMethodName(method_ids[index]));
+    }
+    return report;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Show allocations
+void CallTracer::ShowAllocations(const int mcMaxMethods)
+{
+    for (const QString & line : GetAllocationReport(mcMaxMethods))
+    {
+        qDebug().noquote() << line;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocations of the current thread since the call stack last changed
+thread_local qint64 CallTracer::m_ThreadAllocations = 0;
+thread_local qint64 CallTracer::m_ThreadAllocatedBytes = 0;
+
+
+
+// ==================================================================== Threads
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add another thread's counts and timings
+void CallTracer::Statistics::Add(const Statistics & mcrOther)
+{
+    if (m_CallCount.size() < mcrOther.m_CallCount.size())
+    {
+        m_CallCount.resize(mcrOther.m_CallCount.size());
+    }
+    for (int method_id = 0; method_id < mcrOther.m_CallCount.size();
+         method_id++)
+    {
+        m_CallCount[method_id] += mcrOther.m_CallCount[method_id];
+    }
+    if (m_Callers.size() < mcrOther.m_Callers.size())
+    {
+        m_Callers.resize(mcrOther.m_Callers.size());
+    }
+    for (int method_id = 0; method_id < mcrOther.m_Callers.size();
+         method_id++)
+    {
+        for (const CallerCount & caller : mcrOther.m_Callers[method_id])
+        {
+            CountCaller(m_Callers[method_id], caller.m_CallerID,
+                caller.m_Count);
+        }
+    }
+    if (m_Profile.size() < mcrOther.m_Profile.size())
+    {
+        m_Profile.resize(mcrOther.m_Profile.size());
+    }
+    for (int method_id = 0; method_id < mcrOther.m_Profile.size();
+         method_id++)
+    {
+        const MethodProfile & other = mcrOther.m_Profile[method_id];
+        if (other.m_Count == 0)
+        {
+            continue;
+        }
+        MethodProfile & profile = m_Profile[method_id];
+        if (profile.m_Histogram.size() < other.m_Histogram.size())
+        {
+            profile.m_Histogram.resize(other.m_Histogram.size());
+        }
+        profile.m_Count += other.m_Count;
+        profile.m_InclusiveNS += other.m_InclusiveNS;
+        profile.m_ExclusiveNS += other.m_ExclusiveNS;
+        profile.m_MaxNS = qMax(profile.m_MaxNS, other.m_MaxNS);
+        profile.m_Allocations += other.m_Allocations;
+        profile.m_AllocatedBytes += other.m_AllocatedBytes;
+        for (int bucket = 0; bucket < other.m_Histogram.size(); bucket++)
+        {
+            profile.m_Histogram[bucket] += other.m_Histogram[bucket];
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor: new thread
+CallTracer::ThreadData::ThreadData()
+{
+    QMutexLocker lock(&m_AllThreadDataMutex);
+    m_AllThreadData << this;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor: thread has finished
+CallTracer::ThreadData::~ThreadData()
+{
+    QMutexLocker lock(&m_AllThreadDataMutex);
+    m_AllThreadData.removeAll(this);
+    QMutexLocker thread_lock(&m_Mutex);
+    m_RetiredStatistics.Add(m_Statistics);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Data of the current thread
+CallTracer::ThreadData & CallTracer::GetThreadData()
+{
+    thread_local ThreadData thread_data;
+    return thread_data;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Count a caller
+void CallTracer::CountCaller(QVector < Statistics::CallerCount > & mrCallers,
+    const int mcCallerID, const int mcCount)
+{
+    for (Statistics::CallerCount & caller : mrCallers)
+    {
+        if (caller.m_CallerID == mcCallerID)
+        {
+            caller.m_Count += mcCount;
+            return;
+        }
+    }
+    mrCallers << Statistics::CallerCount { mcCallerID, mcCount };
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Record one call
+void CallTracer::RecordProfile(Statistics & mrStatistics,
+    const int mcMethodID, const qint64 mcInclusiveNS,
+    const qint64 mcExclusiveNS, const qint64 mcAllocations,
+    const qint64 mcAllocatedBytes)
+{
+    // Bucket n holds times from 2^(n-1) to 2^n nanoseconds
+    static const int num_buckets = 48;
+    const quint64 nanoseconds = quint64(qMax(qint64(0), mcInclusiveNS));
+    const int bucket = qMin(num_buckets - 1,
+        64 - int(qCountLeadingZeroBits(nanoseconds)));
+
+    QVector < MethodProfile > & all_profiles = mrStatistics.m_Profile;
+    if (mcMethodID >= all_profiles.size())
+    {
+        all_profiles.resize(mcMethodID + 1);
+    }
+    MethodProfile & profile = all_profiles[mcMethodID];
+    if (profile.m_Histogram.isEmpty())
+    {
+        profile.m_Histogram.fill(0, num_buckets);
+    }
+    profile.m_Count++;
+    profile.m_InclusiveNS += mcInclusiveNS;
+    profile.m_ExclusiveNS += mcExclusiveNS;
+    profile.m_MaxNS = qMax(profile.m_MaxNS, mcInclusiveNS);
+    profile.m_Allocations += mcAllocations;
+    profile.m_AllocatedBytes += mcAllocatedBytes;
+    profile.m_Histogram[bucket]++;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Counts and timings of all threads
+CallTracer::Statistics CallTracer::GetStatistics()
+{
+    Statistics all_statistics;
+    QMutexLocker lock(&m_AllThreadDataMutex);
+    all_statistics.Add(m_RetiredStatistics);
+    for (ThreadData * thread_data : std::as_const(m_AllThreadData))
+    {
+        QMutexLocker thread_lock(&thread_data -> m_Mutex);
+        all_statistics.Add(thread_data -> m_Statistics);
+    }
+    return all_statistics;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Change counts and timings of all threads
+void CallTracer::ForAllStatistics(
+    const std::function < void (Statistics &) > & mcrFunction)
+{
+    QMutexLocker lock(&m_AllThreadDataMutex);
+    mcrFunction(m_RetiredStatistics);
+    for (ThreadData * thread_data : std::as_const(m_AllThreadData))
+    {
+        QMutexLocker thread_lock(&thread_data -> m_Mutex);
+        mcrFunction(thread_data -> m_Statistics);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Threads
+QList < CallTracer::ThreadData * > CallTracer::m_AllThreadData;
+CallTracer::Statistics CallTracer::m_RetiredStatistics;
+QMutex CallTracer::m_AllThreadDataMutex;
 
 
 
@@ -433,6 +1639,8 @@ QString CallTracer::Show(const QByteArray & mcrValue)
 
 
 
+#ifdef QT_GUI_LIB
+
 ///////////////////////////////////////////////////////////////////////////////
 // Show QColor
 QString CallTracer::Show(const QColor & mcrValue)
@@ -450,6 +1658,8 @@ QString CallTracer::Show(const QColor & mcrValue)
     }
 }
 
+#endif
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -772,6 +1982,8 @@ QString CallTracer::Show(const QHash < QString, QString > & mcrValue)
 
 
 
+#ifdef QT_GUI_LIB
+
 ///////////////////////////////////////////////////////////////////////////////
 // Show QImage
 QString CallTracer::Show(const QImage & mcrValue)
@@ -789,6 +2001,8 @@ QString CallTracer::Show(const QImage & mcrValue)
     // We never get here
 }
 
+#endif
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1022,6 +2236,8 @@ QString CallTracer::Show(const QPair < QString, QString > & mcrValue)
 
 
 
+#ifdef QT_GUI_LIB
+
 ///////////////////////////////////////////////////////////////////////////////
 // Show QPixmap
 QString CallTracer::Show(const QPixmap & mcrValue)
@@ -1039,6 +2255,8 @@ QString CallTracer::Show(const QPixmap & mcrValue)
     // We never get here
 }
 
+#endif
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -5,8 +5,9 @@
   * Used for keeping track of methods and functions being called while the
   * program is running, to be used as a call stack for debugging purposes.
   *
-  * This class is at this point not designed to be thread-safe, but it should
-  * be rather straight forward, and it's on the list of future improvements.
+  * Every thread has a call stack of its own, and counts and timings of its
+  * own that are merged when they are shown, so methods can be traced on any
+  * thread without the threads having to wait for each other.
   *
   * Users of this class would use it mostly through the macros defined below,
   * using \link CALL_IN()\endlink as the first thing when entering a function,
@@ -25,6 +26,12 @@
   * Finally, \link CALL_STACK()\endlink allows you to dump the current call
   * stack.
   *
+  * Every call site registers its class and method once (see
+  * \link CALL_ID\endlink) and from then on only uses the method's ID;
+  * entering and exiting a method pushes and pops the ID, a steady clock
+  * time stamp and the parameter text. Method names and time stamps are only
+  * formatted when a trace is shown.
+  *
   * This class also counts calls to methods/functions and the methods/functions
   * calling them; see \link ShowUsage()\endlink and
   * \link ShowCallOriginators()\endlink functions.
@@ -37,21 +44,33 @@
 #define CALLTRACER_H
 
 // Qt includes
-#include <QColor>
+#include <QAtomicInteger>
 #include <QDate>
 #include <QDateTime>
 #include <QHash>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QList>
+#include <QMutex>
 #include <QObject>
-#include <QPixmap>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+
+// System includes
+#include <functional>
 
 
 // The following a luckily documented in
 // https://lists.qt-project.org/pipermail/interest/2015-January/014617.html
 
+// Only relevant if GUI module is used (not the case for headless builds)
+#ifdef QT_GUI_LIB
+#include <QColor>
+#include <QImage>
+#include <QPixmap>
+#endif
+
 // Only relevant if XML module is used
 #ifdef QT_XML_LIB
 #include <QDomDocument>
@@ -71,23 +90,45 @@
     #define CALL_OUT(p) {}
     #define CALL_STACK() QString()
     #define CALL_SHOW(p) QString()
+    #define CALL_SHOW_FULL(p) QString()
     #define CALL_TIMESTAMP QString()
 #else
+    /** \brief Interned ID of the current method.
+      * Registered the first time the call site is reached; afterwards, it's
+      * just a static variable.
+      */
+    #define CALL_ID \
+        ([] (const char * mcpFilename, const char * mcpFunction) \
+        { \
+            static const int method_id = \
+                CallTracer::RegisterMethod(mcpFilename, mcpFunction); \
+            return method_id; \
+        } (__FILE__, __func__))
+
     /** \brief Generates class name from filename
      */
-    #define CALL_CLASS CallTracer::ClassName(__FILE__)
+    #define CALL_CLASS CallTracer::GetClassName(CALL_ID)
 
     /** \brief Generates name of the method where ever it is called
      */
-    #define CALL_METHOD (CALL_CLASS + "::" + __func__)
+    #define CALL_METHOD CallTracer::GetMethodName(CALL_ID)
 
-    /** \brief Saves information when entering a function or method
+    /** \brief Saves information when entering a function or method.
+     * The parameter text is put together only when it is needed (verbose
+     * output, full history or a trace being shown), from the values the
+     * parameters have at that point.
      */
-    #define CALL_IN(p) CallTracer::EnterFunction(__FILE__, __func__, p)
+    #define CALL_IN(p) \
+        const CallTracerParameters call_tracer_parameters(CALL_ID, \
+            [&] () { return QString(p); })
 
-    /** \brief Saves information when exiting a function or method
+    /** \brief Saves information when exiting a function or method (if it
+     * was traced when it was entered, see CallTracer::SetScopes()). Like
+     * the parameters, the reason is put together only when it is needed.
      */
-    #define CALL_OUT(p) CallTracer::ExitFunction(__FILE__, __func__, __LINE__, p)
+    #define CALL_OUT(p) \
+        call_tracer_parameters.Exit(CALL_ID, __LINE__, \
+            [&] () { return QString(p); })
 
     /** \brief The entire call stack or call history
      */
@@ -140,34 +181,48 @@ public:
 
     /** \brief Start or stop keeping the entire call history.
       * By default, only the call stack is maintained, not the full history.
+      * The history is bounded: only the most recent HISTORY_SIZE entries are
+      * kept, with the text of each truncated to HISTORY_TEXT_SIZE bytes.
       * \param mcKeepHistory \c true if you want to keep the full history,
       * \c false if you don't.
       */
     static void SetKeepAllHistory(const bool mcKeepHistory);
 
     /** \brief Records when a function is entered.
-      * \param mcFilename Name of the source code file; \c __FILE__
-      * is a good choice here
-      * \param mcFunction Name of the function/method being entered. Ususally,
-      * use \c __func__.
-      * \param mcParameters List of parameters and their values. Best practice
-      * if to use \c CALL_SHOW() to show the parameter value
+      * Used by \c CALL_IN() through \link CallTracerParameters\endlink.
+      * \param mcMethodID Interned ID of the function/method being entered;
+      * use \c CALL_ID.
+      * \param mcpParameters Object that formats the list of parameters and
+      * their values; it has to live until \link ReleaseParameters()\endlink
+      * is called.
+      * \param mcpFormat Function formatting mcpParameters
+      * \returns Position in the call stack, for
+      * \link ReleaseParameters()\endlink
       */
-    static void EnterFunction(const QString mcFilename,
-        const QString mcFunction, const QString mcParameters);
+    static int EnterFunction(const int mcMethodID,
+        const void * mcpParameters, QString (* mcpFormat)(const void *));
+
+    /** \brief The object formatting the parameters goes out of scope.
+      * Normally, the method has been exited by then; if not (missing
+      * \c CALL_OUT()), the parameters are formatted right away.
+      * \param mcPosition Position returned by \link EnterFunction()\endlink
+      * \param mcpParameters The object
+      */
+    static void ReleaseParameters(const int mcPosition,
+        const void * mcpParameters);
 
     /** \brief Records when a function is exited.
-      * \param mcFilename Name of the source code file; \c __FILE__
-      * macro is a good choice here
-      * \param mcFunction Name of the function/method being entered. Ususally,
-      * use \c __func__ macro.
+      * \param mcMethodID Interned ID of the function/method being exited;
+      * use \c CALL_ID.
       * \param mcLine Line in the source file for pinpointing location of the
       * exit point. Usually, use \c __LINE__ macro.
-      * \param mcReason The reason why the function/method was left. This is
-      * helpful to track error handling. Use an empty string for normal exit.
+      * \param mcpReason Object that formats the reason why the
+      * function/method was left (helpful to track error handling; empty for
+      * a normal exit). It is only formatted if the reason is shown or kept.
+      * \param mcpFormat Function formatting mcpReason
       */
-    static void ExitFunction(const QString mcFilename,
-        const QString mcFunction, const int mcLine, const QString mcReason);
+    static void ExitFunction(const int mcMethodID, const int mcLine,
+        const void * mcpReason, QString (* mcpFormat)(const void *));
 
     /** \brief Returns the call trace.
       * Depending on your choices in \link SetKeepAllHistory()\endlink, this
@@ -176,6 +231,18 @@ public:
       */
     static QString GetCallTrace();
 
+    /** \brief Write the call history as Chrome trace events (JSON), to be
+      * loaded in Perfetto or chrome://tracing.
+      * Every call is a begin/end pair on its thread's timeline, with the
+      * parameters (and the line and reason of the exit) as arguments. Keep
+      * the full history (\link SetKeepAllHistory()\endlink) to get more
+      * than the methods currently being executed.
+      * \param mcrFilename Name of the file to write
+      * \returns \c true on success, \c false if the file could not be
+      * written
+      */
+    static bool WriteChromeTrace(const QString & mcrFilename);
+
     /** \brief Extract the class name from a (source) filename
       * \param mcFilename The name of the source file to be used to extract
       * the class name; we assume were that the name of the file (plus
@@ -186,22 +253,334 @@ public:
     static QString ClassName(const QString mcFilename);
 
 private:
-    /** \brief Time stamp when a function/method was called.
+    /** \brief Steady clock in nanoseconds (time stamps of the call stack).
+      */
+    static qint64 GetTicks();
+
+    /** \brief Formats a steady clock time stamp as date and time.
+      */
+    static QString FormatTicks(const qint64 mcTicks);
+
+    /** \brief Small number identifying the current thread (1 for the first
+      * thread that calls it, and so on).
+      */
+    static int GetThreadNumber();
+
+    /** \brief Steady clock and wall clock when the program started, for
+      * converting time stamps.
+      */
+    static const qint64 m_StartTicks;
+    static const QDateTime m_StartTime;
+
+    /** \brief Method that is currently being executed.
+      */
+    struct StackFrame
+    {
+        // Method
+        int m_MethodID;
+
+        // When it was entered (see GetTicks())
+        qint64 m_Ticks;
+
+        // Time spent in methods it called (nanoseconds)
+        qint64 m_ChildrenNS;
+
+        // Parameters (once formatted)
+        QString m_Text;
+
+        // Object formatting the parameters, until m_Text has been set
+        const void * m_Parameters;
+        QString (* m_Format)(const void *);
+
+        // Allocations in the method itself so far (see CountAllocation())
+        qint64 m_Allocations;
+        qint64 m_AllocatedBytes;
+    };
+
+    /** \brief Size of the call history (entries; a power of 2) and of the
+      * text kept per entry (bytes of UTF-8), so an entry is 128 bytes.
+      */
+    static const int HISTORY_SIZE = 65536;
+    static const int HISTORY_TEXT_SIZE = 94;
+
+    /** \brief Entry in the call history, as stored.
       */
-    static QList < QString > m_CallStack_Time;
-    /** \brief Name of the method that had been called.
+    struct HistoryRecord
+    {
+        // Index of the entry + 1 once it has been written completely; 0
+        // while it's being written
+        QAtomicInteger < quint64 > m_Sequence;
+
+        // Time stamp (see GetTicks())
+        qint64 m_Ticks = 0;
+
+        // Method
+        qint32 m_MethodID = 0;
+
+        // 0 when entering, line of CALL_OUT() when exiting, -1 for a log
+        // line (see AddLogLine())
+        qint32 m_Line = 0;
+
+        // Thread (see GetThreadNumber())
+        qint32 m_ThreadNumber = 0;
+
+        // Parameters when entering, reason when exiting, or the log line
+        // (truncated)
+        qint32 m_TextLength = 0;
+        char m_Text[HISTORY_TEXT_SIZE] = {};
+    };
+
+    /** \brief The call history: a ring buffer of the most recent
+      * HISTORY_SIZE entries (zero-initialized, so memory is only used once
+      * history is being kept). Writers reserve an entry by incrementing
+      * m_HistoryNext and never wait for each other; readers skip entries
+      * that are being written (or have been overwritten meanwhile).
       */
-    static QList < QString > m_CallStack_Method;
-    /** \brief Text (usually the list of arguments and their content) for the
-      * call of the function/method
+    static HistoryRecord m_History[HISTORY_SIZE];
+    static QAtomicInteger < quint64 > m_HistoryNext;
+
+    /** \brief First entry after the last \link ResetHistory()\endlink.
+      */
+    static QAtomicInteger < quint64 > m_HistoryFirst;
+
+    /** \brief Add an entry to the call history
+      */
+    static void AddToHistory(const int mcMethodID, const int mcLine,
+        const qint64 mcTicks, const QString & mcrText);
+
+    /** \brief Entry in the call history or call stack, for showing it.
       */
-    static QList < QString > m_CallStack_Text;
+    struct TraceEntry
+    {
+        qint64 m_Ticks;
+        int m_MethodID;
+        int m_Line;
+        int m_ThreadNumber;
+        QString m_Text;
+    };
+
+    /** \brief The call history (if kept) or the call stack, oldest first.
+      */
+    static QList < TraceEntry > GetTraceEntries();
+
+    /** \brief One entry of a trace as a line of text (without the line
+      * break).
+      */
+    static QString FormatTraceEntry(const TraceEntry & mcrEntry,
+        const QString & mcrTime, const QString & mcrMethodName);
 
     /** \brief Flag indicating if we want to keep the full call history or just
       * the call stack.
       * Set it with \link SetKeepAllHistory()\endlink.
       */
-    static bool m_KeepAllHistory;
+    static QAtomicInteger < bool > m_KeepAllHistory;
+
+
+
+    // ======================================================== Flight recorder
+public:
+    /** \brief Keep the recent call history and log lines in memory, and
+      * write them to a file when the program crashes or is terminated.
+      * Unlike \link SetKeepAllHistory()\endlink, this doesn't change what
+      * \link GetCallTrace()\endlink returns, and calls are recorded
+      * without their parameters (unless those are formatted anyway, for
+      * the full history or verbose output). The file is written on
+      * SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT (handlers are installed
+      * here), and on SIGINT and SIGTERM if SignalHandler is installed.
+      * Read it with \link DecodeFlightRecord()\endlink.
+      * \param mcrFilename Name of the file to write
+      * \returns \c true on success, \c false if the signal handlers could
+      * not be installed
+      */
+    static bool StartFlightRecorder(const QString & mcrFilename);
+
+    /** \brief Write the flight record now. Async-signal-safe, so it can be
+      * called from a Unix signal handler; does nothing unless
+      * \link StartFlightRecorder()\endlink has been called.
+      * \param mcSignal Signal that caused it (0 if none)
+      */
+    static void WriteFlightRecord(const int mcSignal);
+
+    /** \brief Read a file written by the flight recorder (of the same
+      * build of the program).
+      * \param mcrFilename Name of the file
+      * \param mrTrace The history, oldest first, in the format of
+      * \link GetCallTrace()\endlink with the thread of every entry
+      * \returns \c true on success, \c false if the file could not be read
+      * or isn't a flight record
+      */
+    static bool DecodeFlightRecord(const QString & mcrFilename,
+        QString & mrTrace);
+
+    /** \brief Add a log line to the call history (if history is being
+      * kept). Used by MessageLogger.
+      * \param mcrLine The line
+      */
+    static void AddLogLine(const QString & mcrLine);
+
+private:
+    /** \brief Unix signal handler for crashes: writes the flight record,
+      * then crashes the way the program would have without it.
+      */
+    static void CrashSignalHandler(int mSignal);
+
+    /** \brief write() all of a buffer (async-signal-safe).
+      */
+    static bool WriteAll(const int mcFile, const char * mcpData,
+        qint64 mSize);
+
+    /** \brief Identifies flight records, and the version of their format.
+      */
+    static constexpr char FLIGHT_RECORD_MAGIC[8] = { 'W', 'U', 'F', 'L',
+        'I', 'G', 'H', 'T' };
+    static const qint32 FLIGHT_RECORD_VERSION = 1;
+
+    /** \brief Start of a flight record, followed by the method names
+      * (m_NameTableSize bytes) and the raw call history.
+      */
+    struct FlightRecordHeader
+    {
+        char m_Magic[8];
+        qint32 m_Version;
+        qint32 m_Signal;
+        qint64 m_ProcessID;
+        qint64 m_StartTicks;
+        qint64 m_StartTime;
+        qint64 m_WriteTicks;
+        quint64 m_HistoryNext;
+        quint64 m_HistoryFirst;
+        qint32 m_HistorySize;
+        qint32 m_RecordSize;
+        qint32 m_NameTableSize;
+        qint32 m_Reserved;
+    };
+
+    /** \brief Flight recorder is on.
+      */
+    static QAtomicInteger < bool > m_FlightRecorderOn;
+
+    /** \brief File to write (encoded for open(), zero-terminated), and
+      * start of the program in milliseconds since the epoch; both are
+      * prepared beforehand, since no Qt can be used in a signal handler.
+      */
+    static const int MAX_FILENAME_SIZE = 4096;
+    static char m_FlightRecordFilename[MAX_FILENAME_SIZE];
+    static qint64 m_StartTimeMS;
+
+    /** \brief A flight record is being written (by some thread).
+      */
+    static QAtomicInt m_WritingFlightRecord;
+
+    /** \brief Method names in order of their IDs (starting with 1), one
+      * per line in UTF-8, for the flight record. If the table is full,
+      * later methods are left out.
+      */
+    static const int NAME_TABLE_SIZE = 262144;
+    static char m_NameTable[NAME_TABLE_SIZE];
+    static QAtomicInt m_NameTableSize;
+    static bool m_NameTableFull;
+
+    /** \brief Signal stack for the crash handler, so a stack overflow (of
+      * the thread that started the flight recorder) can be recorded, too.
+      */
+    static const int SIGNAL_STACK_SIZE = 65536;
+    static char m_SignalStack[SIGNAL_STACK_SIZE];
+
+
+
+    // ======================================================== Method registry
+public:
+    /** \brief Interned ID of a method (registering it if it's new).
+      * Use the \c CALL_ID macro, which calls this only once per call site.
+      * \param mcpFilename Name of the source code file (\c __FILE__)
+      * \param mcpFunction Name of the function/method (\c __func__)
+      * \returns The method's ID
+      */
+    static int RegisterMethod(const char * mcpFilename,
+        const char * mcpFunction);
+
+    /** \brief Class name of a registered method
+      * \param mcMethodID ID of the method
+      * \returns The class name
+      */
+    static QString GetClassName(const int mcMethodID);
+
+    /** \brief Full name ("Class::method") of a registered method
+      * \param mcMethodID ID of the method
+      * \returns The full name
+      */
+    static QString GetMethodName(const int mcMethodID);
+
+private:
+    /** \brief Maximum number of methods that can be registered.
+      */
+    static const int MAX_METHODS = 4096;
+
+    /** \brief Maps "Class::method" to method ID.
+      */
+    static QHash < QString, int > m_MethodIDs;
+
+    /** \brief Class, method and full name for every ID. Entries never move
+      * or change once registered, so they can be read without a lock.
+      */
+    static QString m_ClassNames[MAX_METHODS];
+    static QString m_FunctionNames[MAX_METHODS];
+    static QString m_MethodNames[MAX_METHODS];
+    static QAtomicInt m_NumberOfMethods;
+
+    /** \brief Registration may happen from any thread.
+      */
+    static QMutex m_RegistryMutex;
+
+
+
+    // ================================================================= Scopes
+public:
+    /** \brief Choose which classes and methods are traced.
+      * \param mcrScopes Comma-separated rules "scope=setting"; the scope is
+      * "*" (everything), a class or "Class::method", and the setting is
+      * "off", "on", "verbose" (on, and shown like
+      * \link SetVerbosity()\endlink does) or a number N (every N-th call on
+      * average is traced). Later rules override earlier ones, e.g.
+      * "*=off,WundergroundComms=verbose,DatabaseHelper=100". Without any
+      * rules, everything is traced. Applies to methods entered from now on.
+      * \returns \c true on success, \c false if a rule is invalid (the
+      * rules are left unchanged then)
+      */
+    static bool SetScopes(const QString & mcrScopes);
+
+    /** \brief Check if a call of a method is traced (called by
+      * \c CALL_IN(); a single branch unless the method is sampled).
+      * \param mcMethodID ID of the method
+      * \returns \c true if the call is to be traced
+      */
+    static bool ShouldTrace(const int mcMethodID);
+
+private:
+    /** \brief Rule set by \link SetScopes()\endlink.
+      */
+    struct ScopeRule
+    {
+        QString m_Scope;
+        int m_Rate;
+        bool m_IsVerbose;
+    };
+    static QList < ScopeRule > m_ScopeRules;
+
+    /** \brief Apply the rules to a registered method (with the registry
+      * locked).
+      */
+    static void ApplyScopes(const int mcMethodID);
+
+    /** \brief Pick one of mcRate calls at random.
+      */
+    static bool IsSampled(const int mcRate);
+
+    /** \brief For every method ID: 0 if it isn't traced, 1 if every call is
+      * traced, N if every N-th call is, and if it is verbose.
+      */
+    static QAtomicInt m_TraceRate[MAX_METHODS];
+    static QAtomicInteger < bool > m_MethodIsVerbose[MAX_METHODS];
 
 
 
@@ -230,16 +609,6 @@ public:
     static void ShowCallOriginators(const QString mcClass,
         const QString mcMethod);
 
-private:
-    /** \brief Counts what class and method is called how often
-      * Maps class + method to call count.
-      */
-    static QHash < QString, QHash < QString, int > > m_CallCount;
-    /** \brief Counts what method is called by what other method, and how often
-      * maps called method + calling method to call count.
-      */
-    static QHash < QString, QHash < QString, int > > m_OriginatorCount;
-
 public:
     /** \brief Set verbosity of operations
       * \param mcNewVerbosity new value; \c true for verbose operations,
@@ -249,7 +618,158 @@ public:
 private:
     /** \brief Verbosity
       */
-    static bool m_IsVerbose;
+    static QAtomicInteger < bool > m_IsVerbose;
+
+
+
+    // ============================================================== Profiling
+public:
+    /** \brief Forget all timings.
+      */
+    static void ResetProfile();
+
+    /** \brief Time spent per method as a printable table: calls, inclusive
+      * (total) and exclusive (self) time, mean, 99th percentile and maximum.
+      * \param mcMaxMethods Number of methods to include, the ones with the
+      * most self time first
+      * \returns The table, one line per method (plus a header)
+      */
+    static QStringList GetProfileReport(const int mcMaxMethods = 30);
+
+    /** \brief Show the profile (see \link GetProfileReport()\endlink)
+      * \param mcMaxMethods Number of methods to show
+      */
+    static void ShowProfile(const int mcMaxMethods = 30);
+
+    /** \brief Count an allocation, for the method on top of the current
+      * thread's call stack. Called by the allocation hooks (built with
+      * qmake CONFIG+=trace_allocations); mustn't allocate itself.
+      * \param mcSize Bytes allocated
+      */
+    static void CountAllocation(const qint64 mcSize);
+
+    /** \brief Allocations per method as a printable table: calls,
+      * allocations and bytes (in the method itself, not in the methods it
+      * called), and both per call. Empty unless the allocation hooks are
+      * built in.
+      * \param mcMaxMethods Number of methods to include, the ones with the
+      * most allocations first
+      * \returns The table, one line per method (plus a header)
+      */
+    static QStringList GetAllocationReport(const int mcMaxMethods = 30);
+
+    /** \brief Show the allocations (see
+      * \link GetAllocationReport()\endlink)
+      * \param mcMaxMethods Number of methods to show
+      */
+    static void ShowAllocations(const int mcMaxMethods = 30);
+
+private:
+    /** \brief Timings and allocations of one method.
+      */
+    struct MethodProfile
+    {
+        qint64 m_Count = 0;
+        qint64 m_InclusiveNS = 0;
+        qint64 m_ExclusiveNS = 0;
+        qint64 m_MaxNS = 0;
+        qint64 m_Allocations = 0;
+        qint64 m_AllocatedBytes = 0;
+
+        // Bucket n holds inclusive times from 2^(n-1) to 2^n nanoseconds
+        QVector < qint64 > m_Histogram;
+    };
+
+    /** \brief Allocations of the current thread since the call stack last
+      * changed; they are charged to the method on top of it when it
+      * changes.
+      */
+    static thread_local qint64 m_ThreadAllocations;
+    static thread_local qint64 m_ThreadAllocatedBytes;
+
+
+
+    // ================================================================ Threads
+private:
+    /** \brief Counts and timings (of one thread, or merged).
+      */
+    struct Statistics
+    {
+        // Counts how often every method is called, indexed by method ID
+        QVector < int > m_CallCount;
+
+        // Counts what method is called by what other method, and how often:
+        // for every method ID, its callers (ID 0 for none) with their
+        // counts. Methods have few callers, so a short list each.
+        struct CallerCount
+        {
+            int m_CallerID;
+            int m_Count;
+        };
+        QVector < QVector < CallerCount > > m_Callers;
+
+        // Timings, indexed by method ID
+        QVector < MethodProfile > m_Profile;
+
+        // Add another thread's counts and timings
+        void Add(const Statistics & mcrOther);
+    };
+
+    /** \brief Everything CallTracer keeps per thread.
+      */
+    struct ThreadData
+    {
+        // Constructor: register with m_AllThreadData
+        ThreadData();
+
+        // Destructor: keep counts and timings in m_RetiredStatistics
+        ~ThreadData();
+
+        // Methods currently being executed
+        QVector < StackFrame > m_CallStack;
+
+        // Counts and timings; the thread only ever waits for the mutex
+        // while they are being shown or reset
+        QMutex m_Mutex;
+        Statistics m_Statistics;
+    };
+
+    /** \brief Data of the current thread (created when first used).
+      */
+    static ThreadData & GetThreadData();
+
+    /** \brief Add to the count of a caller in a list of callers.
+      */
+    static void CountCaller(QVector < Statistics::CallerCount > & mrCallers,
+        const int mcCallerID, const int mcCount);
+
+    /** \brief Record one call of a method.
+      * \param mrStatistics The thread's statistics (locked)
+      * \param mcMethodID The method
+      * \param mcInclusiveNS Time from entering to exiting (nanoseconds)
+      * \param mcExclusiveNS Same, less the time spent in methods it called
+      * \param mcAllocations Allocations in the method itself
+      * \param mcAllocatedBytes Bytes allocated in the method itself
+      */
+    static void RecordProfile(Statistics & mrStatistics, const int mcMethodID,
+        const qint64 mcInclusiveNS, const qint64 mcExclusiveNS,
+        const qint64 mcAllocations, const qint64 mcAllocatedBytes);
+
+    /** \brief Counts and timings of all threads so far, merged.
+      */
+    static Statistics GetStatistics();
+
+    /** \brief Change counts and timings of all threads (e.g. reset them).
+      */
+    static void ForAllStatistics(
+        const std::function < void (Statistics &) > & mcrFunction);
+
+    /** \brief Threads that are running, and counts and timings of threads
+      * that have finished.
+      */
+    static QList < ThreadData * > m_AllThreadData;
+    static Statistics m_RetiredStatistics;
+    static QMutex m_AllThreadDataMutex;
 
 
 
@@ -286,11 +806,13 @@ public:
       */
     static QString Show(const QByteArray & mcrValue);
 
+#ifdef QT_GUI_LIB
     /** \brief Show QColor value in human readable form.
       * \param mcValue The value to show
       * \returns a QString with a human readable representation of the value
       */
     static QString Show(const QColor & mcrValue);
+#endif
 
     /** \brief Show QDate value in human readable form.
       * \param mcValue The value to show
@@ -380,11 +902,13 @@ public:
       */
     static QString Show(const QHash < QString, QString > & mcrValue);
 
+#ifdef QT_GUI_LIB
     /** \brief Show QImage value in human readable form.
       * \param mcValue The value to show
       * \returns a QString with a human readable representation of the value
       */
     static QString Show(const QImage & mcrValue);
+#endif
 
     /** \brief Show int64 value in human readable form.
       * \param mcValue The value to show
@@ -479,11 +1003,13 @@ public:
       */
     static QString Show(const QPair < QString, QString > & mcrValue);
 
+#ifdef QT_GUI_LIB
     /** \brief Show QPixmap value in human readable form.
       * \param mcValue The value to show
       * \returns a QString with a human readable representation of the value
       */
     static QString Show(const QPixmap & mcrValue);
+#endif
 
     /** \brief Show QSet < double > value in human readable form.
       * \param mcValue The value to show
@@ -539,4 +1065,90 @@ public:
     static QString Show(const void * mcpValue);
 };
 
+
+
+// Called for every CALL_IN(), so it's inline
+inline bool CallTracer::ShouldTrace(const int mcMethodID)
+{
+    const int rate = m_TraceRate[mcMethodID].loadRelaxed();
+    if (rate == 0)
+    {
+        return false;
+    }
+    return rate == 1 ||
+        IsSampled(rate);
+}
+
+
+
+// Class definition
+/** \class CallTracerParameters
+  * Created by \c CALL_IN() in the method's scope, so the lambda formatting
+  * the parameters (and whatever it references) lives as long as the method
+  * is on the call stack. Also remembers if the call is traced at all, for
+  * \c CALL_OUT().
+  */
+template < typename Formatter >
+class CallTracerParameters
+{
+public:
+    // Constructor: enter method
+    CallTracerParameters(const int mcMethodID,
+        const Formatter & mcrFormatter)
+        : m_Formatter(mcrFormatter)
+    {
+        m_Position = -1;
+        if (CallTracer::ShouldTrace(mcMethodID))
+        {
+            m_Position =
+                CallTracer::EnterFunction(mcMethodID, this, &Format);
+        }
+    }
+
+    // Destructor
+    ~CallTracerParameters()
+    {
+        if (m_Position >= 0)
+        {
+            CallTracer::ReleaseParameters(m_Position, this);
+        }
+    }
+
+    // Exit method (if it was entered); mcrReason formats the reason
+    template < typename ReasonFormatter >
+    void Exit(const int mcMethodID, const int mcLine,
+        const ReasonFormatter & mcrReason) const
+    {
+        if (m_Position >= 0)
+        {
+            CallTracer::ExitFunction(mcMethodID, mcLine, &mcrReason,
+                &FormatReason < ReasonFormatter >);
+        }
+    }
+
+    // Not to be copied (the call stack points to it)
+    Q_DISABLE_COPY(CallTracerParameters)
+
+private:
+    // Format parameters
+    static QString Format(const void * mcpThis)
+    {
+        return static_cast < const CallTracerParameters * >(mcpThis) ->
+            m_Formatter();
+    }
+
+    // Format reason for exiting
+    template < typename ReasonFormatter >
+    static QString FormatReason(const void * mcpReason)
+    {
+        return (*static_cast < const ReasonFormatter * >(mcpReason))();
+    }
+
+    // Lambda formatting the parameters
+    const Formatter m_Formatter;
+
+    // Position in the call stack (-1 if the call isn't traced)
+    int m_Position;
+};
+
 #endif
@@ -24,9 +24,19 @@
 #include "MessageLogger.h"
 
 // Qt includes
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QMutexLocker>
+#include <QRegularExpression>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QTextStream>
+#include <QThread>
+#include <QtMath>
+
+// System includes
+#include <algorithm>
 
 
 
@@ -95,3 +105,707 @@ bool DatabaseHelper::HasSQLError(QSqlQuery & mrQuery, const QString mcFilename,
     CALL_OUT("");
     return false;
 }
+
+
+
+// ================================================================ Connections
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read-only connection to a database for the calling thread
+QSqlDatabase DatabaseHelper::GetReadConnection(const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    // One connection per thread and database
+    QThread * thread = QThread::currentThread();
+    const QString connection_name = QString("DatabaseHelper_reader_%1_%2")
+        .arg(QString::number(quintptr(thread), 16),
+             QString::number(qHash(mcrFilename), 16));
+    if (QSqlDatabase::contains(connection_name))
+    {
+        CALL_OUT("");
+        return QSqlDatabase::database(connection_name);
+    }
+
+    // New connection
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection_name);
+    db.setDatabaseName(mcrFilename);
+    db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+    db.open();
+    {
+        QMutexLocker locker(&m_ReadConnectionsMutex);
+        m_ReadConnections += connection_name;
+    }
+
+    // Connection goes away with its thread (finished is emitted from the
+    // finishing thread, which is where the connection has to be removed)
+    QObject::connect(thread, &QThread::finished, thread,
+        [connection_name]()
+        {
+            RemoveReadConnection(connection_name);
+        }, Qt::DirectConnection);
+
+    CALL_OUT("");
+    return db;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of read-only connections currently open
+int DatabaseHelper::GetNumberOfReadConnections()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_ReadConnectionsMutex);
+    CALL_OUT("");
+    return m_ReadConnections.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove connection when its thread finishes
+void DatabaseHelper::RemoveReadConnection(const QString & mcrConnectionName)
+{
+    CALL_IN(QString("mcrConnectionName=%1")
+        .arg(CALL_SHOW(mcrConnectionName)));
+
+    ClearPreparedQueries(mcrConnectionName);
+    QSqlDatabase::removeDatabase(mcrConnectionName);
+    {
+        QMutexLocker locker(&m_AttachedDatabasesMutex);
+        m_AttachedDatabases.remove(mcrConnectionName);
+    }
+    QMutexLocker locker(&m_ReadConnectionsMutex);
+    m_ReadConnections -= mcrConnectionName;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Names of open read-only connections
+QSet < QString > DatabaseHelper::m_ReadConnections;
+QMutex DatabaseHelper::m_ReadConnectionsMutex;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Attach a database file to a connection
+bool DatabaseHelper::AttachDatabase(const QString & mcrSchema,
+    const QString & mcrFilename, const QSqlDatabase & mcrDatabase,
+    const int mcMaxAttached)
+{
+    CALL_IN(QString("mcrSchema=%1, mcrFilename=%2, mcrDatabase=%3, "
+        "mcMaxAttached=%4")
+        .arg(CALL_SHOW(mcrSchema),
+             CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcrDatabase.connectionName()),
+             CALL_SHOW(mcMaxAttached)));
+
+    // Attached already: now the most recently used one
+    const QString connection_name = mcrDatabase.connectionName();
+    QString least_recently_used;
+    {
+        QMutexLocker locker(&m_AttachedDatabasesMutex);
+        QStringList & attached = m_AttachedDatabases[connection_name];
+        if (attached.removeAll(mcrSchema) > 0)
+        {
+            attached << mcrSchema;
+            CALL_OUT("");
+            return true;
+        }
+        if (attached.size() >= mcMaxAttached)
+        {
+            least_recently_used = attached.first();
+        }
+    }
+
+    // Make room
+    if (!least_recently_used.isEmpty() &&
+        !DetachDatabase(least_recently_used, mcrDatabase))
+    {
+        CALL_OUT("");
+        return false;
+    }
+
+    // Schema names can't be bound, so they are checked instead
+    static const QRegularExpression valid_schema("^[A-Za-z_][A-Za-z0-9_]*$");
+    if (!valid_schema.match(mcrSchema).hasMatch())
+    {
+        CALL_OUT("");
+        return false;
+    }
+    QSqlQuery query(mcrDatabase);
+    query.prepare(QString("ATTACH DATABASE :filename AS %1;").arg(mcrSchema));
+    query.bindValue(":filename", mcrFilename);
+    if (!TimedExec(query, QString(), mcrDatabase))
+    {
+        CALL_OUT("");
+        return false;
+    }
+
+    QMutexLocker locker(&m_AttachedDatabasesMutex);
+    m_AttachedDatabases[connection_name] << mcrSchema;
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Detach database file from a connection
+bool DatabaseHelper::DetachDatabase(const QString & mcrSchema,
+    const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mcrSchema=%1, mcrDatabase=%2")
+        .arg(CALL_SHOW(mcrSchema),
+             CALL_SHOW(mcrDatabase.connectionName())));
+
+    const QString connection_name = mcrDatabase.connectionName();
+    {
+        QMutexLocker locker(&m_AttachedDatabasesMutex);
+        if (!m_AttachedDatabases.value(connection_name).contains(mcrSchema))
+        {
+            CALL_OUT("");
+            return true;
+        }
+    }
+
+    // Cached statements may still hold a read lock on the file (and would
+    // refer to a schema that's gone)
+    ClearPreparedQueries(connection_name);
+    QSqlQuery query(mcrDatabase);
+    if (!TimedExec(query, QString("DETACH DATABASE %1;").arg(mcrSchema),
+        mcrDatabase))
+    {
+        CALL_OUT("");
+        return false;
+    }
+
+    QMutexLocker locker(&m_AttachedDatabasesMutex);
+    m_AttachedDatabases[connection_name].removeAll(mcrSchema);
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Attached databases
+QHash < QString, QStringList > DatabaseHelper::m_AttachedDatabases;
+QMutex DatabaseHelper::m_AttachedDatabasesMutex;
+
+
+
+// ======================================================== Prepared statements
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prepared statement for mcrSQL on a connection
+QSqlQuery & DatabaseHelper::PreparedQuery(const QString & mcrSQL,
+    const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mcrSQL=%1, mcrDatabase=%2")
+        .arg(CALL_SHOW(mcrSQL),
+             CALL_SHOW(mcrDatabase.connectionName())));
+
+    // Each connection is used by one thread only, so the lock is only needed
+    // for the hashes themselves
+    const QString connection_name = mcrDatabase.connectionName();
+    const QString key = connection_name + "\n" + mcrSQL;
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    QStringList & order = m_PreparedQueryOrder[connection_name];
+    QSqlQuery * query = m_PreparedQueries.value(key);
+    if (query)
+    {
+        // Release result set of the previous use
+        query -> finish();
+        m_PreparedQueryHits++;
+
+        // Most recently used
+        if (order.last() != key)
+        {
+            order.removeOne(key);
+            order << key;
+        }
+        CALL_OUT("");
+        return *query;
+    }
+
+    // Prepare new statement
+    m_PreparedQueryMisses++;
+    query = new QSqlQuery(mcrDatabase);
+    query -> setForwardOnly(true);
+    if (!query -> prepare(mcrSQL))
+    {
+        // exec() will fail, and HasSQLError() will tell
+        const QString failed_key = connection_name + "\n";
+        delete m_FailedQueries.take(failed_key);
+        m_FailedQueries[failed_key] = query;
+        CALL_OUT("");
+        return *query;
+    }
+
+    // Make room
+    while (order.size() >= m_MaxPreparedQueries)
+    {
+        QSqlQuery * old_query = m_PreparedQueries.take(order.takeFirst());
+        old_query -> finish();
+        delete old_query;
+        m_PreparedQueryEvictions++;
+    }
+    m_PreparedQueries[key] = query;
+    order << key;
+    CALL_OUT("");
+    return *query;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of statements kept per connection
+void DatabaseHelper::SetMaxPreparedQueries(const int mcMaxPreparedQueries)
+{
+    CALL_IN(QString("mcMaxPreparedQueries=%1")
+        .arg(CALL_SHOW(mcMaxPreparedQueries)));
+
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    m_MaxPreparedQueries = qMax(1, mcMaxPreparedQueries);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of statements kept per connection
+int DatabaseHelper::GetMaxPreparedQueries()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    CALL_OUT("");
+    return m_MaxPreparedQueries;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Drop prepared statements of a connection
+void DatabaseHelper::ClearPreparedQueries(const QString & mcrConnectionName)
+{
+    CALL_IN(QString("mcrConnectionName=%1")
+        .arg(CALL_SHOW(mcrConnectionName)));
+
+    const QString prefix = mcrConnectionName + "\n";
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    for (QHash < QString, QSqlQuery * > * queries :
+        { &m_PreparedQueries, &m_FailedQueries })
+    {
+        for (auto query_iterator = queries -> begin();
+             query_iterator != queries -> end();)
+        {
+            if (query_iterator.key().startsWith(prefix))
+            {
+                delete query_iterator.value();
+                query_iterator = queries -> erase(query_iterator);
+            } else
+            {
+                query_iterator++;
+            }
+        }
+    }
+    m_PreparedQueryOrder.remove(mcrConnectionName);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of statements that were already prepared
+qint64 DatabaseHelper::GetPreparedQueryHits()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    CALL_OUT("");
+    return m_PreparedQueryHits;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of statements that had to be prepared
+qint64 DatabaseHelper::GetPreparedQueryMisses()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    CALL_OUT("");
+    return m_PreparedQueryMisses;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of statements deleted to make room
+qint64 DatabaseHelper::GetPreparedQueryEvictions()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    CALL_OUT("");
+    return m_PreparedQueryEvictions;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of cached statements
+int DatabaseHelper::GetNumberOfPreparedQueries()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_PreparedQueriesMutex);
+    CALL_OUT("");
+    return m_PreparedQueries.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prepared statements
+QHash < QString, QSqlQuery * > DatabaseHelper::m_PreparedQueries;
+QMutex DatabaseHelper::m_PreparedQueriesMutex;
+qint64 DatabaseHelper::m_PreparedQueryHits = 0;
+qint64 DatabaseHelper::m_PreparedQueryMisses = 0;
+qint64 DatabaseHelper::m_PreparedQueryEvictions = 0;
+QHash < QString, QStringList > DatabaseHelper::m_PreparedQueryOrder;
+int DatabaseHelper::m_MaxPreparedQueries = 100;
+QHash < QString, QSqlQuery * > DatabaseHelper::m_FailedQueries;
+
+
+
+// ================================================================= Statistics
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Execute prepared statement, record timing and report errors
+bool DatabaseHelper::Exec(QSqlQuery & mrQuery, const QString mcFilename,
+    const int mcLineNumber, const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mrQuery=%1, mcFilename=%2, mcLineNumber=%3, "
+        "mcrDatabase=...")
+        .arg(CALL_SHOW(mrQuery),
+             CALL_SHOW(mcFilename),
+             CALL_SHOW(mcLineNumber)));
+
+    TimedExec(mrQuery, QString(), mcrDatabase);
+    const bool success = !HasSQLError(mrQuery, mcFilename, mcLineNumber);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Execute statement given as text, record timing and report errors
+bool DatabaseHelper::Exec(QSqlQuery & mrQuery, const QString & mcrSQL,
+    const QString mcFilename, const int mcLineNumber,
+    const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mrQuery=%1, mcrSQL=%2, mcFilename=%3, mcLineNumber=%4, "
+        "mcrDatabase=...")
+        .arg(CALL_SHOW(mrQuery),
+             CALL_SHOW(mcrSQL),
+             CALL_SHOW(mcFilename),
+             CALL_SHOW(mcLineNumber)));
+
+    TimedExec(mrQuery, mcrSQL, mcrDatabase);
+    const bool success = !HasSQLError(mrQuery, mcFilename, mcLineNumber);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Execute and record timing without reporting errors
+bool DatabaseHelper::TimedExec(QSqlQuery & mrQuery, const QString & mcrSQL,
+    const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mrQuery=%1, mcrSQL=%2, mcrDatabase=%3")
+        .arg(CALL_SHOW(mrQuery),
+             CALL_SHOW(mcrSQL),
+             CALL_SHOW(mcrDatabase.connectionName())));
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool success = (mcrSQL.isEmpty() ?
+        mrQuery.exec() : mrQuery.exec(mcrSQL));
+    const qint64 nanoseconds = timer.nsecsElapsed();
+
+    const QString sql = (mcrSQL.isEmpty() ? mrQuery.lastQuery() : mcrSQL);
+    RecordStatement(sql, nanoseconds, mrQuery.numRowsAffected());
+    if (success &&
+        m_SlowQueryThresholdMS >= 0 &&
+        nanoseconds >= qint64(m_SlowQueryThresholdMS) * 1000000)
+    {
+        LogSlowStatement(mrQuery, sql, nanoseconds, mcrDatabase);
+    }
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Slow-query log
+void DatabaseHelper::SetSlowQueryLog(const QString & mcrFilename,
+    const int mcThresholdMS)
+{
+    CALL_IN(QString("mcrFilename=%1, mcThresholdMS=%2")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcThresholdMS)));
+
+    QMutexLocker locker(&m_StatementStatisticsMutex);
+    m_SlowQueryLog = mcrFilename;
+    m_SlowQueryThresholdMS = mcThresholdMS;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Record one execution
+void DatabaseHelper::RecordStatement(const QString & mcrSQL,
+    const qint64 mcNanoseconds, const int mcRowsAffected)
+{
+    CALL_IN(QString("mcrSQL=%1, mcNanoseconds=%2, mcRowsAffected=%3")
+        .arg(CALL_SHOW(mcrSQL),
+             CALL_SHOW(mcNanoseconds),
+             CALL_SHOW(mcRowsAffected)));
+
+    // Bucket n holds durations from 2^(n-1) to 2^n microseconds
+    static const int num_buckets = 32;
+    int bucket = 0;
+    for (qint64 microseconds = mcNanoseconds / 1000;
+         microseconds > 0 && bucket < num_buckets - 1;
+         microseconds >>= 1)
+    {
+        bucket++;
+    }
+
+    QMutexLocker locker(&m_StatementStatisticsMutex);
+    StatementStatistics & statistics = m_StatementStatistics[mcrSQL];
+    if (statistics.m_Histogram.isEmpty())
+    {
+        statistics.m_Histogram.fill(0, num_buckets);
+    }
+    statistics.m_Count++;
+    statistics.m_Rows += qMax(0, mcRowsAffected);
+    statistics.m_TotalNS += mcNanoseconds;
+    statistics.m_MaxNS = qMax(statistics.m_MaxNS, mcNanoseconds);
+    statistics.m_Histogram[bucket]++;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write statement and its query plan to the slow-query log
+void DatabaseHelper::LogSlowStatement(QSqlQuery & mrQuery,
+    const QString & mcrSQL, const qint64 mcNanoseconds,
+    const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mrQuery=%1, mcrSQL=%2, mcNanoseconds=%3, "
+        "mcrDatabase=%4")
+        .arg(CALL_SHOW(mrQuery),
+             CALL_SHOW(mcrSQL),
+             CALL_SHOW(mcNanoseconds),
+             CALL_SHOW(mcrDatabase.connectionName())));
+
+    // Plan (with the same values bound; not for DDL and the like)
+    QStringList plan;
+    static const QRegularExpression explainable(
+        "^\\s*(SELECT|INSERT|UPDATE|DELETE|WITH)\\b",
+        QRegularExpression::CaseInsensitiveOption);
+    if (explainable.match(mcrSQL).hasMatch())
+    {
+        QSqlQuery explain_query(mcrDatabase);
+        explain_query.prepare("EXPLAIN QUERY PLAN " + mcrSQL);
+        const QVariantList values = mrQuery.boundValues();
+        for (int index = 0; index < values.size(); index++)
+        {
+            explain_query.bindValue(index, values[index]);
+        }
+        if (explain_query.exec())
+        {
+            while (explain_query.next())
+            {
+                plan << explain_query.value("detail").toString();
+            }
+        }
+    }
+
+    QMutexLocker locker(&m_StatementStatisticsMutex);
+    if (m_SlowQueryLog.isEmpty())
+    {
+        CALL_OUT("");
+        return;
+    }
+    QFile log_file(m_SlowQueryLog);
+    if (!log_file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        CALL_OUT("");
+        return;
+    }
+    QTextStream log(&log_file);
+    log << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss")
+        << QString(" %1 ms, %2 row(s): ")
+            .arg(QString::number(mcNanoseconds / 1e6, 'f', 1),
+                 QString::number(qMax(0, mrQuery.numRowsAffected())))
+        << mcrSQL.simplified() << "\n";
+    for (const QString & step : plan)
+    {
+        log << "    " << step << "\n";
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Statistics per statement
+QList < QHash < QString, QVariant > > DatabaseHelper::GetStatementStatistics()
+{
+    CALL_IN("");
+
+    // Percentiles are the upper end of the histogram bucket they fall in
+    auto percentile = [](const StatementStatistics & mcrStatistics,
+        const double mcFraction)
+    {
+        const qint64 target = qCeil(mcFraction * mcrStatistics.m_Count);
+        qint64 seen = 0;
+        for (int bucket = 0;
+             bucket < mcrStatistics.m_Histogram.size();
+             bucket++)
+        {
+            seen += mcrStatistics.m_Histogram[bucket];
+            if (seen >= target)
+            {
+                return double(qint64(1) << bucket) / 1000.;
+            }
+        }
+        return mcrStatistics.m_MaxNS / 1e6;
+    };
+
+    QList < QHash < QString, QVariant > > all_statistics;
+    {
+        QMutexLocker locker(&m_StatementStatisticsMutex);
+        for (auto statistics_iterator = m_StatementStatistics.constBegin();
+             statistics_iterator != m_StatementStatistics.constEnd();
+             statistics_iterator++)
+        {
+            const StatementStatistics & statistics =
+                statistics_iterator.value();
+            QHash < QString, QVariant > entry;
+            entry["sql"] = statistics_iterator.key().simplified();
+            entry["count"] = statistics.m_Count;
+            entry["rows"] = statistics.m_Rows;
+            entry["total_ms"] = statistics.m_TotalNS / 1e6;
+            entry["mean_ms"] = statistics.m_TotalNS / 1e6 / statistics.m_Count;
+            entry["p50_ms"] = percentile(statistics, 0.5);
+            entry["p99_ms"] = percentile(statistics, 0.99);
+            entry["max_ms"] = statistics.m_MaxNS / 1e6;
+            all_statistics << entry;
+        }
+    }
+    std::sort(all_statistics.begin(), all_statistics.end(),
+        [](const QHash < QString, QVariant > & mcrFirst,
+           const QHash < QString, QVariant > & mcrSecond)
+        {
+            return mcrFirst["total_ms"].toDouble() >
+                mcrSecond["total_ms"].toDouble();
+        });
+
+    CALL_OUT("");
+    return all_statistics;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Statistics as a printable table
+QStringList DatabaseHelper::GetStatementStatisticsReport(
+    const int mcMaxStatements)
+{
+    CALL_IN(QString("mcMaxStatements=%1")
+        .arg(CALL_SHOW(mcMaxStatements)));
+
+    QStringList report;
+    report << tr("   calls     rows   total ms    p50 ms    p99 ms    max ms  "
+        "statement");
+    const QList < QHash < QString, QVariant > > all_statistics =
+        GetStatementStatistics();
+    for (int index = 0;
+         index < all_statistics.size() && index < mcMaxStatements;
+         index++)
+    {
+        const QHash < QString, QVariant > & entry = all_statistics[index];
+        report << QString("%1 %2 %3 %4 %5 %6  %7")
+            .arg(entry["count"].toString().rightJustified(8),
+                 entry["rows"].toString().rightJustified(8),
+                 QString::number(entry["total_ms"].toDouble(), 'f', 1)
+                    .rightJustified(10),
+                 QString::number(entry["p50_ms"].toDouble(), 'f', 2)
+                    .rightJustified(9),
+                 QString::number(entry["p99_ms"].toDouble(), 'f', 2)
+                    .rightJustified(9),
+                 QString::number(entry["max_ms"].toDouble(), 'f', 2)
+                    .rightJustified(9),
+                 entry["sql"].toString().left(100));
+    }
+
+    CALL_OUT("");
+    return report;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Forget statistics
+void DatabaseHelper::ResetStatementStatistics()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_StatementStatisticsMutex);
+    m_StatementStatistics.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Statistics and slow-query log
+QHash < QString, DatabaseHelper::StatementStatistics >
+    DatabaseHelper::m_StatementStatistics;
+QMutex DatabaseHelper::m_StatementStatisticsMutex;
+QString DatabaseHelper::m_SlowQueryLog;
+int DatabaseHelper::m_SlowQueryThresholdMS = -1;
@@ -9,9 +9,16 @@
 #define DATABASE_H
 
 // Qt includes
+#include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QSet>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
 
 // Class definition
 class DatabaseHelper
@@ -37,6 +44,156 @@ public:
     // Check if query caused an error
     static bool HasSQLError(QSqlQuery & mrQuery,
         const QString mcFileName, const int mcLineNumber);
+
+
+
+    // ============================================================ Connections
+    // Qt SQL connections can only be used by the thread that created them.
+    // Worker threads get a read-only connection of their own, which is
+    // removed when the thread finishes; with SQLite's write-ahead log, they
+    // don't block (and aren't blocked by) the writer. These may be called
+    // from any thread, so they don't report errors through MessageLogger.
+public:
+    // Read-only connection to a database for the calling thread (check
+    // isOpen() and lastError())
+    static QSqlDatabase GetReadConnection(const QString & mcrFilename);
+
+    // Number of read-only connections currently open
+    static int GetNumberOfReadConnections();
+
+    // Attach a database file to a connection as mcrSchema (unless it is
+    // attached already). At most mcMaxAttached files are attached at a time;
+    // the least recently used one is detached to make room. Not within a
+    // transaction.
+    static bool AttachDatabase(const QString & mcrSchema,
+        const QString & mcrFilename, const QSqlDatabase & mcrDatabase,
+        const int mcMaxAttached = 10);
+
+    // Detach it again
+    static bool DetachDatabase(const QString & mcrSchema,
+        const QSqlDatabase & mcrDatabase);
+
+private:
+    // Remove connection when its thread finishes
+    static void RemoveReadConnection(const QString & mcrConnectionName);
+
+    // Names of open read-only connections
+    static QSet < QString > m_ReadConnections;
+    static QMutex m_ReadConnectionsMutex;
+
+    // Connection name to attached schemas (least recently used first)
+    static QHash < QString, QStringList > m_AttachedDatabases;
+    static QMutex m_AttachedDatabasesMutex;
+
+
+
+    // ==================================================== Prepared statements
+    // Statements are prepared once per connection and SQL text and then
+    // reused, so SQLite doesn't parse and plan them again on every call.
+    // Each connection keeps a limited number of them; the least recently
+    // used statement is finished and deleted to make room.
+    // Like the connections, these may be called from any thread.
+public:
+    // Prepared (forward-only) statement for mcrSQL on a connection; bind
+    // values and exec() as usual. The reference stays valid until
+    // GetMaxPreparedQueries() other statements have been prepared on the
+    // same connection.
+    static QSqlQuery & PreparedQuery(const QString & mcrSQL,
+        const QSqlDatabase & mcrDatabase = QSqlDatabase::database());
+
+    // Number of statements kept per connection
+    static void SetMaxPreparedQueries(const int mcMaxPreparedQueries);
+    static int GetMaxPreparedQueries();
+
+    // Drop prepared statements of a connection (before closing it)
+    static void ClearPreparedQueries(const QString & mcrConnectionName =
+        QLatin1String(QSqlDatabase::defaultConnection));
+
+    // Statistics
+    static qint64 GetPreparedQueryHits();
+    static qint64 GetPreparedQueryMisses();
+    static qint64 GetPreparedQueryEvictions();
+    static int GetNumberOfPreparedQueries();
+
+private:
+    // Connection name + "\n" + SQL text to prepared statement
+    static QHash < QString, QSqlQuery * > m_PreparedQueries;
+    static QMutex m_PreparedQueriesMutex;
+    static qint64 m_PreparedQueryHits;
+    static qint64 m_PreparedQueryMisses;
+    static qint64 m_PreparedQueryEvictions;
+
+    // Connection name to keys of its statements (least recently used first)
+    static QHash < QString, QStringList > m_PreparedQueryOrder;
+    static int m_MaxPreparedQueries;
+
+    // Last statement per connection that could not be prepared (not reused,
+    // so it's prepared again next time; e.g. when a table didn't exist yet)
+    static QHash < QString, QSqlQuery * > m_FailedQueries;
+
+
+
+    // ============================================================= Statistics
+    // Every statement executed through Exec() is timed: number of calls,
+    // rows affected and a latency histogram (powers of two in
+    // microseconds). Statements slower than a threshold are written to the
+    // slow-query log together with their query plan.
+public:
+    // Execute prepared statement, record timing and report errors (like
+    // HasSQLError()); true if successful
+    static bool Exec(QSqlQuery & mrQuery, const QString mcFilename,
+        const int mcLineNumber,
+        const QSqlDatabase & mcrDatabase = QSqlDatabase::database());
+
+    // Same for a statement given as text
+    static bool Exec(QSqlQuery & mrQuery, const QString & mcrSQL,
+        const QString mcFilename, const int mcLineNumber,
+        const QSqlDatabase & mcrDatabase = QSqlDatabase::database());
+
+    // Execute and record timing without reporting errors (for worker
+    // threads; check lastError())
+    static bool TimedExec(QSqlQuery & mrQuery, const QString & mcrSQL,
+        const QSqlDatabase & mcrDatabase);
+
+    // Slow-query log
+    static void SetSlowQueryLog(const QString & mcrFilename,
+        const int mcThresholdMS);
+
+    // Statistics per statement (sql, count, rows, total_ms, mean_ms, p50_ms,
+    // p99_ms, max_ms), slowest in total first
+    static QList < QHash < QString, QVariant > > GetStatementStatistics();
+
+    // Same as a printable table (top mcMaxStatements statements)
+    static QStringList GetStatementStatisticsReport(
+        const int mcMaxStatements = 20);
+
+    // Forget statistics
+    static void ResetStatementStatistics();
+
+private:
+    // Record one execution
+    static void RecordStatement(const QString & mcrSQL,
+        const qint64 mcNanoseconds, const int mcRowsAffected);
+
+    // Write statement and its query plan to the slow-query log
+    static void LogSlowStatement(QSqlQuery & mrQuery, const QString & mcrSQL,
+        const qint64 mcNanoseconds, const QSqlDatabase & mcrDatabase);
+
+    // Statistics of one statement
+    struct StatementStatistics
+    {
+        qint64 m_Count = 0;
+        qint64 m_Rows = 0;
+        qint64 m_TotalNS = 0;
+        qint64 m_MaxNS = 0;
+        QVector < qint64 > m_Histogram;
+    };
+    static QHash < QString, StatementStatistics > m_StatementStatistics;
+    static QMutex m_StatementStatisticsMutex;
+
+    // Slow-query log
+    static QString m_SlowQueryLog;
+    static int m_SlowQueryThresholdMS;
 };
 
 #endif
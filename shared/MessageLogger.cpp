@@ -88,6 +88,9 @@ void MessageLogger::Error(const QString mcMethod, const QString mcReason)
     qDebug().noquote() << tr("ERROR: %1:\n\t%2")
         .arg(mcMethod,
              mcReason);
+    CallTracer::AddLogLine(tr("ERROR: %1: %2")
+        .arg(mcMethod,
+             mcReason));
     qDebug().noquote() << tr("Callback stack:\n%1")
         .arg(CALL_STACK());
 }
@@ -122,6 +125,9 @@ void MessageLogger::Message(const QString mcMethod, const QString mcReason)
     qDebug().noquote() << QString("%1:\n\t%2")
         .arg(mcMethod,
              mcReason);
+    CallTracer::AddLogLine(QString("%1: %2")
+        .arg(mcMethod,
+             mcReason));
 }
 
 
@@ -151,9 +157,11 @@ void MessageLogger::Message(const QString mcMethod,
 // Add debug line
 void MessageLogger::Debug(const QString mcMethod, const QString mcReason)
 {
-    qDebug().noquote() << tr("DEBUG: %1: %2")
+    const QString line = tr("DEBUG: %1: %2")
         .arg(mcMethod,
              mcReason);
+    qDebug().noquote() << line;
+    CallTracer::AddLogLine(line);
 }
 
 
@@ -196,6 +204,7 @@ void MessageLogger::Table(const QList < QString > mcTitles,
 void MessageLogger::Print(const QString mcMessage)
 {
     qDebug().noquote() << mcMessage;
+    CallTracer::AddLogLine(mcMessage);
 }
 
 
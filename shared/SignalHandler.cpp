@@ -0,0 +1,193 @@
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// SignalHandler.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "MessageLogger.h"
+#include "SignalHandler.h"
+
+// System includes
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+SignalHandler::SignalHandler()
+{
+    CALL_IN("");
+
+    m_Notifier = nullptr;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+SignalHandler::~SignalHandler()
+{
+    CALL_IN("");
+
+    delete m_Notifier;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instanciator
+SignalHandler * SignalHandler::Instance()
+{
+    CALL_IN("");
+
+    if (!m_Instance)
+    {
+        m_Instance = new SignalHandler();
+    }
+
+    CALL_OUT("");
+    return m_Instance;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instance
+SignalHandler * SignalHandler::m_Instance = nullptr;
+
+
+
+// ==================================================================== Signals
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Catch SIGINT and SIGTERM
+bool SignalHandler::Install()
+{
+    CALL_IN("");
+
+    // Check if we're already installed
+    if (m_Notifier)
+    {
+        const QString reason = tr("Signal handlers are already installed.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Socket pair for getting out of the signal handler
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, m_SocketPair) != 0)
+    {
+        const QString reason = tr("Could not create socket pair.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    m_Notifier = new QSocketNotifier(m_SocketPair[1],
+        QSocketNotifier::Read, this);
+    connect (m_Notifier, &QSocketNotifier::activated,
+        this, &SignalHandler::ReadSignal);
+
+    // Install handlers
+    struct sigaction action;
+    action.sa_handler = SignalHandler::UnixSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGINT, &action, nullptr) != 0 ||
+        sigaction(SIGTERM, &action, nullptr) != 0)
+    {
+        const QString reason = tr("Could not install signal handlers.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The actual Unix signal handler
+void SignalHandler::UnixSignalHandler(int mSignal)
+{
+    // Only async-signal-safe calls in here - no CALL_IN/CALL_OUT either.
+
+    // Keep what we were doing (if the flight recorder is on)
+    CallTracer::WriteFlightRecord(mSignal);
+
+    // Second signal: user insists, don't wait for a graceful shutdown
+    m_ReceivedSignals = m_ReceivedSignals + 1;
+    if (m_ReceivedSignals > 1)
+    {
+        _exit(128 + mSignal);
+    }
+
+    const char signal_number = static_cast < char >(mSignal);
+    const ssize_t written = ::write(m_SocketPair[0], &signal_number, 1);
+    Q_UNUSED(written);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Socket pair
+int SignalHandler::m_SocketPair[2] = { -1, -1 };
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of termination signals received so far
+volatile sig_atomic_t SignalHandler::m_ReceivedSignals = 0;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Signal arrived in the event loop
+void SignalHandler::ReadSignal()
+{
+    CALL_IN("");
+
+    m_Notifier -> setEnabled(false);
+    char signal_number = 0;
+    const ssize_t bytes_read = ::read(m_SocketPair[1], &signal_number, 1);
+    m_Notifier -> setEnabled(true);
+    if (bytes_read != 1)
+    {
+        const QString reason = tr("Could not read signal number.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    emit TerminationRequested(int(signal_number));
+
+    CALL_OUT("");
+}
@@ -0,0 +1,83 @@
+// SignalHandler.h
+// Class definition
+
+/** \class SignalHandler
+  * Turns Unix signals (SIGINT, SIGTERM) into regular Qt signals.
+  *
+  * Very little may be done safely inside a Unix signal handler; in
+  * particular, no Qt or CallTracer code. The handler therefore only writes
+  * the signal number into a socket pair, and a QSocketNotifier picks it up
+  * in the event loop where \link TerminationRequested()\endlink is emitted.
+  * (The one exception is CallTracer::WriteFlightRecord(), which is
+  * async-signal-safe: the flight record shows what the program was doing
+  * when it was asked to terminate.)
+  *
+  * A second signal arriving while the first one is still being dealt with
+  * terminates the process immediately (e.g. pressing Ctrl-C twice).
+  */
+
+#ifndef SIGNALHANDLER_H
+#define SIGNALHANDLER_H
+
+// Qt includes
+#include <QObject>
+#include <QSocketNotifier>
+
+// System includes
+#include <csignal>
+
+
+
+// Class definition
+class SignalHandler
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Constructor
+    SignalHandler();
+
+public:
+    // Destructor
+    virtual ~SignalHandler();
+
+    // Instanciator
+    static SignalHandler * Instance();
+
+private:
+    // Instance
+    static SignalHandler * m_Instance;
+
+
+
+    // ================================================================ Signals
+public:
+    // Catch SIGINT and SIGTERM
+    bool Install();
+
+private:
+    // The actual (async-signal-safe) Unix signal handler
+    static void UnixSignalHandler(int mSignal);
+
+    // Socket pair connecting the Unix signal handler and the event loop
+    static int m_SocketPair[2];
+
+    // Number of termination signals received so far
+    static volatile sig_atomic_t m_ReceivedSignals;
+
+    // Notifier for the read end of the socket pair
+    QSocketNotifier * m_Notifier;
+
+private slots:
+    // Signal arrived in the event loop
+    void ReadSignal();
+
+signals:
+    void TerminationRequested(int mSignal);
+};
+
+#endif
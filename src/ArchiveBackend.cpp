@@ -0,0 +1,697 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// ArchiveBackend.cpp
+// Class implementation
+
+// Project includes
+#include "ArchiveBackend.h"
+#include "CallTracer.h"
+#include "ColumnArchive.h"
+#include "MessageLogger.h"
+
+// Qt includes
+#include <QDir>
+#include <QFile>
+#include <QMap>
+
+// System includes
+#include <limits>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+ArchiveBackend::ArchiveBackend(const QString & mcrDirectory,
+    const QStringList & mcrColumns)
+    : StorageBackend(mcrColumns)
+{
+    CALL_IN(QString("mcrDirectory=%1, mcrColumns=%2")
+        .arg(CALL_SHOW(mcrDirectory),
+             CALL_SHOW(mcrColumns)));
+
+    m_Directory = mcrDirectory;
+    m_IsInTransaction = false;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ArchiveBackend::~ArchiveBackend()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+// =============================================================== Observations
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Name
+QString ArchiveBackend::GetName() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return "Archive";
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Create directory
+bool ArchiveBackend::Migrate()
+{
+    CALL_IN("");
+
+    if (!QDir().mkpath(m_Directory))
+    {
+        const QString reason = tr("Could not create \"%1\".")
+            .arg(m_Directory);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add observations
+bool ArchiveBackend::AppendBatch(
+    const QList < QHash < QString, QString > > & mcrObservations)
+{
+    CALL_IN(QString("mcrObservations=<%1 observations>")
+        .arg(QString::number(mcrObservations.size())));
+
+    // One file per station and month
+    QMap < QString, QList < QHash < QString, QString > > > months;
+    for (const QHash < QString, QString > & observation : mcrObservations)
+    {
+        months[observation["station_id"] + "|" +
+            observation["date_time"].left(7)] << observation;
+    }
+    for (auto month_iterator = months.constBegin();
+         month_iterator != months.constEnd();
+         month_iterator++)
+    {
+        if (!UpdateMonth(month_iterator.key().section("|", 0, 0),
+            month_iterator.key().section("|", 1), month_iterator.value(),
+            false))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Change values of observations
+bool ArchiveBackend::ReviseBatch(
+    const QList < QHash < QString, QString > > & mcrRevisions)
+{
+    CALL_IN(QString("mcrRevisions=<%1 revisions>")
+        .arg(QString::number(mcrRevisions.size())));
+
+    if (!CheckRevisions(mcrRevisions))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Every month is written once
+    QMap < QString, QList < QHash < QString, QString > > > months;
+    for (const QHash < QString, QString > & revision : mcrRevisions)
+    {
+        months[revision["station_id"] + "|" +
+            revision["date_time"].left(7)] << revision;
+    }
+    for (auto month_iterator = months.constBegin();
+         month_iterator != months.constEnd();
+         month_iterator++)
+    {
+        if (!UpdateMonth(month_iterator.key().section("|", 0, 0),
+            month_iterator.key().section("|", 1), month_iterator.value(),
+            true))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add or revise observations in the file of a station and month
+bool ArchiveBackend::UpdateMonth(const QString & mcrStationID,
+    const QString & mcrMonth,
+    const QList < QHash < QString, QString > > & mcrObservations,
+    const bool mcRevise)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrMonth=%2, "
+        "mcrObservations=<%3 observations>, mcRevise=%4")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth),
+             QString::number(mcrObservations.size()),
+             CALL_SHOW(mcRevise)));
+
+    // What we have so far
+    const QString filename = GetFilename(m_Directory, mcrStationID, mcrMonth);
+    QMap < qint64, QVector < double > > rows;
+    QString time_zone = mcrObservations.first()["timezone"];
+    if (mcRevise &&
+        !QFile::exists(filename))
+    {
+        const QString reason = tr("Revised month %1 of station %2 has no "
+            "file.").arg(mcrMonth, mcrStationID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    if (QFile::exists(filename))
+    {
+        ColumnArchive archive;
+        if (!archive.Open(filename))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        if (archive.GetColumns() != m_Metrics)
+        {
+            const QString reason = tr("\"%1\" has different columns.")
+                .arg(filename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        if (!archive.Scan(std::numeric_limits < qint64 >::min(),
+            std::numeric_limits < qint64 >::max(), m_Metrics,
+            [&rows](const qint64 mcTime, const QVector < double > & mcrValues)
+            {
+                rows[mcTime] = mcrValues;
+                return true;
+            }))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        time_zone = archive.GetTimeZone();
+    }
+
+    // New observations replace those at the same time; revisions only
+    // change the columns they have
+    QVector < double > values(m_Metrics.size());
+    for (const QHash < QString, QString > & observation : mcrObservations)
+    {
+        const qint64 time = ToSeconds(observation["date_time"]);
+        if (mcRevise)
+        {
+            if (!rows.contains(time))
+            {
+                const QString reason = tr("Revised observation %1|%2 is "
+                    "unknown.").arg(mcrStationID, observation["date_time"]);
+                MessageLogger::Error(CALL_METHOD, reason);
+                CALL_OUT(reason);
+                return false;
+            }
+            values = rows[time];
+        }
+        for (int metric = 0; metric < m_Metrics.size(); metric++)
+        {
+            if (!mcRevise ||
+                observation.contains(m_Metrics[metric]))
+            {
+                values[metric] = ToValue(observation[m_Metrics[metric]]);
+            }
+        }
+        rows[time] = values;
+    }
+
+    // Write the month again
+    QVector < qint64 > times;
+    QList < QVector < double > > columns;
+    for (int metric = 0; metric < m_Metrics.size(); metric++)
+    {
+        columns << QVector < double >();
+    }
+    for (auto row_iterator = rows.constBegin();
+         row_iterator != rows.constEnd();
+         row_iterator++)
+    {
+        times << row_iterator.key();
+        for (int metric = 0; metric < m_Metrics.size(); metric++)
+        {
+            columns[metric] << row_iterator.value()[metric];
+        }
+    }
+    if (!KeepForUndo(filename))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+    const bool success = ColumnArchive::Write(filename, mcrStationID,
+        time_zone, m_Metrics, times, columns);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Raw values
+bool ArchiveBackend::QueryRange(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback,
+    QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrTimeZone=%5, mcChunkSize=%6, mcrCallback=..., mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id()),
+             CALL_SHOW(mcChunkSize)));
+
+    if (!CheckMetrics(mcrMetrics))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Months without a file have no observations; rows are added a block
+    // at a time
+    mrResult.SetColumns(mcrMetrics);
+    const qint64 from =
+        ColumnArchive::ToSeconds(mcrFrom.date(), mcrFrom.time());
+    const qint64 to = ColumnArchive::ToSeconds(mcrTo.date(), mcrTo.time());
+    const QDate last_day = mcrTo.addSecs(-1).date();
+    QVector < QDateTime > times;
+    bool keep_going = true;
+    for (QDate month = QDate(mcrFrom.date().year(), mcrFrom.date().month(), 1);
+         keep_going && month <= last_day;
+         month = month.addMonths(1))
+    {
+        const QString filename = GetFilename(m_Directory, mcrStationID,
+            month.toString("yyyy-MM"));
+        if (!QFile::exists(filename))
+        {
+            continue;
+        }
+        ColumnArchive archive;
+        if (!archive.Open(filename) ||
+            !archive.ScanBlocks(from, to, mcrMetrics,
+                [&](QSpan < const qint64 > mTimes,
+                    const QList < QSpan < const double > > & mcrValues)
+                {
+                    keep_going = AppendRows(mrResult, mTimes, mcrValues,
+                        mcrTimeZone, mcChunkSize, mcrCallback, times);
+                    return keep_going;
+                }))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+    }
+    if (keep_going)
+    {
+        FinishChunks(mrResult, mcChunkSize, mcrCallback);
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary of a day
+bool ArchiveBackend::DaySummary(const QString & mcrStationID,
+    const QDate & mcrDate, const QStringList & mcrMetrics,
+    const QTimeZone & mcrTimeZone, QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrDate=%2, mcrMetrics=%3, "
+        "mcrTimeZone=%4, mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrDate),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id())));
+
+    if (!CheckMetrics(mcrMetrics))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Blocks entirely within the day come from the block statistics
+    QVector < double > summary = EmptySummary(mcrMetrics.size());
+    const QString filename = GetFilename(m_Directory, mcrStationID,
+        mcrDate.toString("yyyy-MM"));
+    if (QFile::exists(filename))
+    {
+        ColumnArchive archive;
+        if (!archive.Open(filename))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        const qint64 from = ColumnArchive::ToSeconds(mcrDate, QTime(0, 0));
+        const qint64 to =
+            ColumnArchive::ToSeconds(mcrDate.addDays(1), QTime(0, 0));
+        for (int metric = 0; metric < mcrMetrics.size(); metric++)
+        {
+            int count = 0;
+            if (!archive.Summarize(from, to, mcrMetrics[metric], count,
+                summary[4 * metric + 1], summary[4 * metric + 2],
+                summary[4 * metric + 3]))
+            {
+                // Has been reported.
+                CALL_OUT("");
+                return false;
+            }
+            summary[4 * metric] = count;
+        }
+    }
+    AppendSummary(mrResult, mcrMetrics, mcrDate, mcrTimeZone, summary);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// All observations
+bool ArchiveBackend::ReadAll(
+    QList < QHash < QString, QString > > & mrObservations)
+{
+    CALL_IN("mrObservations=...");
+
+    // Every file, whatever its station and month
+    const QStringList filenames =
+        QDir(m_Directory).entryList(QStringList({ "*.wuc" }), QDir::Files,
+            QDir::Name);
+    for (const QString & filename : filenames)
+    {
+        ColumnArchive archive;
+        if (!archive.Open(m_Directory + "/" + filename))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        const QString station_id = archive.GetStationID();
+        const QString time_zone = archive.GetTimeZone();
+        const QStringList columns = archive.GetColumns();
+        if (!archive.Scan(std::numeric_limits < qint64 >::min(),
+            std::numeric_limits < qint64 >::max(), columns,
+            [&](const qint64 mcTime, const QVector < double > & mcrValues)
+            {
+                QHash < QString, QString > observation;
+                observation["station_id"] = station_id;
+                observation["timezone"] = time_zone;
+                observation["date_time"] = ToDateTimeText(mcTime);
+                for (int column = 0; column < columns.size(); column++)
+                {
+                    observation[columns[column]] = ToText(mcrValues[column]);
+                }
+                mrObservations << observation;
+                return true;
+            }))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time zone of a station
+QString ArchiveBackend::GetTimeZone(const QString & mcrStationID)
+{
+    CALL_IN(QString("mcrStationID=%1")
+        .arg(CALL_SHOW(mcrStationID)));
+
+    // From the header of the most recent month
+    const QStringList filenames = QDir(m_Directory).entryList(
+        QStringList({ mcrStationID + "_????-??.wuc" }), QDir::Files,
+        QDir::Name);
+    ColumnArchive archive;
+    if (filenames.isEmpty() ||
+        !archive.Open(m_Directory + "/" + filenames.last()))
+    {
+        CALL_OUT("");
+        return QString();
+    }
+    const QString time_zone = archive.GetTimeZone();
+
+    CALL_OUT("");
+    return time_zone;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// File of a station and month
+QString ArchiveBackend::GetFilename(const QString & mcrDirectory,
+    const QString & mcrStationID, const QString & mcrMonth)
+{
+    CALL_IN(QString("mcrDirectory=%1, mcrStationID=%2, mcrMonth=%3")
+        .arg(CALL_SHOW(mcrDirectory),
+             CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth)));
+
+    const QString filename = QString("%1/%2_%3.wuc")
+        .arg(mcrDirectory,
+             mcrStationID,
+             mcrMonth);
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Every month of a range has a file with all of mcrMetrics
+bool ArchiveBackend::Covers(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics) const
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics)));
+
+    if (mcrTo <= mcrFrom)
+    {
+        CALL_OUT("");
+        return false;
+    }
+
+    // Opening only reads the directory (a file may have been dropped in the
+    // meantime, or predate a column)
+    const QDate last_day = mcrTo.addSecs(-1).date();
+    for (QDate month = QDate(mcrFrom.date().year(), mcrFrom.date().month(), 1);
+         month <= last_day;
+         month = month.addMonths(1))
+    {
+        const QString filename = GetFilename(m_Directory, mcrStationID,
+            month.toString("yyyy-MM"));
+        if (!QFile::exists(filename))
+        {
+            CALL_OUT("");
+            return false;
+        }
+        if (mcrMetrics.isEmpty())
+        {
+            continue;
+        }
+        ColumnArchive archive;
+        if (!archive.Open(filename))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        const QStringList columns = archive.GetColumns();
+        for (const QString & metric : mcrMetrics)
+        {
+            if (!columns.contains(metric))
+            {
+                CALL_OUT("");
+                return false;
+            }
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// =============================================================== Transactions
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start writes that can be undone
+bool ArchiveBackend::Begin()
+{
+    CALL_IN("");
+
+    m_IsInTransaction = true;
+    m_Backups.clear();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Keep writes since Begin()
+bool ArchiveBackend::Commit()
+{
+    CALL_IN("");
+
+    // Backups are not needed anymore
+    for (auto backup_iterator = m_Backups.constBegin();
+         backup_iterator != m_Backups.constEnd();
+         backup_iterator++)
+    {
+        if (backup_iterator.value())
+        {
+            QFile::remove(backup_iterator.key() + ".bak");
+        }
+    }
+    m_IsInTransaction = false;
+    m_Backups.clear();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Undo writes since Begin()
+void ArchiveBackend::Rollback()
+{
+    CALL_IN("");
+
+    // Files as they were (new files are dropped)
+    for (auto backup_iterator = m_Backups.constBegin();
+         backup_iterator != m_Backups.constEnd();
+         backup_iterator++)
+    {
+        const QString & filename = backup_iterator.key();
+        QFile::remove(filename);
+        if (backup_iterator.value() &&
+            !QFile::rename(filename + ".bak", filename))
+        {
+            const QString reason = tr("Could not restore \"%1\" from its "
+                "backup.").arg(filename);
+            MessageLogger::Error(CALL_METHOD, reason);
+        }
+    }
+    m_IsInTransaction = false;
+    m_Backups.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy a file before it is first rewritten in a transaction
+bool ArchiveBackend::KeepForUndo(const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    if (!m_IsInTransaction ||
+        m_Backups.contains(mcrFilename))
+    {
+        CALL_OUT("");
+        return true;
+    }
+    const bool existed = QFile::exists(mcrFilename);
+    if (existed)
+    {
+        QFile::remove(mcrFilename + ".bak");
+        if (!QFile::copy(mcrFilename, mcrFilename + ".bak"))
+        {
+            const QString reason = tr("Could not back up \"%1\".")
+                .arg(mcrFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+    m_Backups[mcrFilename] = existed;
+
+    CALL_OUT("");
+    return true;
+}
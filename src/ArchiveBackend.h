@@ -0,0 +1,121 @@
+// ArchiveBackend.h
+// Class definition
+
+/** \class ArchiveBackend
+  * Observations in ColumnArchive files, one per station and month
+  * ("<station>_<yyyy-MM>.wuc" in a directory, as written by
+  * WundergroundComms::ArchiveMonths()).
+  *
+  * Reading is fast; appending rewrites the months it touches, so this is
+  * for bulk loads of history rather than for live data. Files are replaced
+  * atomically, so reads may run on other threads while one thread writes.
+  */
+
+#ifndef ARCHIVEBACKEND_H
+#define ARCHIVEBACKEND_H
+
+// Project includes
+#include "StorageBackend.h"
+
+
+
+// Class definition
+class ArchiveBackend
+    : public StorageBackend
+{
+    Q_DECLARE_TR_FUNCTIONS(ArchiveBackend)
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    ArchiveBackend(const QString & mcrDirectory,
+        const QStringList & mcrColumns);
+
+    // Destructor
+    virtual ~ArchiveBackend();
+
+
+
+    // =========================================================== Observations
+public:
+    // Name
+    virtual QString GetName() const;
+
+    // Create directory
+    virtual bool Migrate();
+
+    // Add observations
+    virtual bool AppendBatch(
+        const QList < QHash < QString, QString > > & mcrObservations);
+
+    // Change values of observations
+    virtual bool ReviseBatch(
+        const QList < QHash < QString, QString > > & mcrRevisions);
+
+    // Raw values
+    virtual bool QueryRange(const QString & mcrStationID,
+        const QDateTime & mcrFrom, const QDateTime & mcrTo,
+        const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+        const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QueryResult & mrResult);
+
+    // Summary of a day
+    virtual bool DaySummary(const QString & mcrStationID,
+        const QDate & mcrDate, const QStringList & mcrMetrics,
+        const QTimeZone & mcrTimeZone, QueryResult & mrResult);
+
+    // All observations
+    virtual bool ReadAll(
+        QList < QHash < QString, QString > > & mrObservations);
+
+    // Time zone of a station
+    virtual QString GetTimeZone(const QString & mcrStationID);
+
+    // File of a station and month (yyyy-MM)
+    static QString GetFilename(const QString & mcrDirectory,
+        const QString & mcrStationID, const QString & mcrMonth);
+
+    // Every month of a range has a file with all of mcrMetrics (for callers
+    // that use other storage otherwise)
+    bool Covers(const QString & mcrStationID, const QDateTime & mcrFrom,
+        const QDateTime & mcrTo, const QStringList & mcrMetrics) const;
+
+private:
+    // Where the files are
+    QString m_Directory;
+
+    // Add observations to the file of a station and month, or revise
+    // observations that are there
+    bool UpdateMonth(const QString & mcrStationID, const QString & mcrMonth,
+        const QList < QHash < QString, QString > > & mcrObservations,
+        const bool mcRevise);
+
+
+
+    // =========================================================== Transactions
+public:
+    // Start writes that can be undone
+    virtual bool Begin();
+
+    // Keep writes since Begin()
+    virtual bool Commit();
+
+    // Undo writes since Begin()
+    virtual void Rollback();
+
+private:
+    // Within Begin() and Commit()/Rollback()
+    bool m_IsInTransaction;
+
+    // Files written since Begin() to whether they existed before (they
+    // have been copied to "<file>.bak" then)
+    QHash < QString, bool > m_Backups;
+
+    // Copy a file before it is first rewritten in a transaction
+    bool KeepForUndo(const QString & mcrFilename);
+};
+
+#endif
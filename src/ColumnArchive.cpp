@@ -0,0 +1,1186 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// ColumnArchive.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "ColumnArchive.h"
+#include "MessageLogger.h"
+
+// Qt includes
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QtAlgorithms>
+#include <QtNumeric>
+
+// System includes
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+
+// File format
+#define ARCHIVE_MAGIC 0x57554341
+#define ARCHIVE_VERSION 1
+
+// Size of a block's directory entry, and of each of its columns' entries
+#define BLOCK_ENTRY_SIZE (4 + 4 * 8)
+#define COLUMN_ENTRY_SIZE (8 + 8 + 4 + 3 * 8)
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+ColumnArchive::ColumnArchive()
+{
+    CALL_IN("");
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_NumberOfRows = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ColumnArchive::~ColumnArchive()
+{
+    CALL_IN("");
+
+    Close();
+
+    CALL_OUT("");
+}
+
+
+
+// ==================================================================== Writing
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write observations to a file
+bool ColumnArchive::Write(const QString & mcrFilename,
+    const QString & mcrStationID, const QString & mcrTimeZone,
+    const QStringList & mcrColumns, const QVector < qint64 > & mcrTimes,
+    const QList < QVector < double > > & mcrValues)
+{
+    CALL_IN(QString("mcrFilename=%1, mcrStationID=%2, mcrTimeZone=%3, "
+        "mcrColumns=%4, mcrTimes=..., mcrValues=...")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrTimeZone),
+             CALL_SHOW(mcrColumns)));
+
+    // Check input
+    const int num_rows = mcrTimes.size();
+    if (mcrValues.size() != mcrColumns.size())
+    {
+        const QString reason = tr("%1 columns but %2 value vectors.")
+            .arg(QString::number(mcrColumns.size()),
+                 QString::number(mcrValues.size()));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    for (int column_index = 0;
+         column_index < mcrColumns.size();
+         column_index++)
+    {
+        if (mcrValues[column_index].size() != num_rows)
+        {
+            const QString reason = tr("Column \"%1\" has %2 values for %3 "
+                "times.")
+                .arg(mcrColumns[column_index],
+                     QString::number(mcrValues[column_index].size()),
+                     QString::number(num_rows));
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+    for (int row = 1; row < num_rows; row++)
+    {
+        // Block skipping relies on ascending times
+        if (mcrTimes[row] < mcrTimes[row - 1])
+        {
+            const QString reason = tr("Times are not in ascending order.");
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+
+    // Header
+    QByteArray data;
+    QDataStream header(&data, QIODevice::WriteOnly);
+    header.setVersion(QDataStream::Qt_6_0);
+    header << quint32(ARCHIVE_MAGIC)
+        << quint16(ARCHIVE_VERSION)
+        << mcrStationID
+        << mcrTimeZone
+        << mcrColumns
+        << qint32(num_rows);
+
+    // Blocks, and their directory
+    QByteArray directory;
+    QDataStream directory_stream(&directory, QIODevice::WriteOnly);
+    directory_stream.setVersion(QDataStream::Qt_6_0);
+    const int num_blocks = (num_rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    directory_stream << qint32(num_blocks);
+    for (int block = 0; block < num_blocks; block++)
+    {
+        const int first = block * BLOCK_SIZE;
+        const int count = qMin(BLOCK_SIZE, num_rows - first);
+
+        const QByteArray times = EncodeTimes(mcrTimes, first, count);
+        directory_stream << qint32(count)
+            << mcrTimes[first]
+            << mcrTimes[first + count - 1]
+            << qint64(data.size())
+            << qint64(times.size());
+        data += times;
+
+        for (int column_index = 0;
+             column_index < mcrColumns.size();
+             column_index++)
+        {
+            const QVector < double > & column_values =
+                mcrValues[column_index];
+
+            // Statistics
+            int num_values = 0;
+            double minimum = qQNaN();
+            double maximum = qQNaN();
+            double sum = 0;
+            for (int row = first; row < first + count; row++)
+            {
+                const double value = column_values[row];
+                if (qIsNaN(value))
+                {
+                    continue;
+                }
+                if (num_values == 0)
+                {
+                    minimum = value;
+                    maximum = value;
+                } else
+                {
+                    minimum = qMin(minimum, value);
+                    maximum = qMax(maximum, value);
+                }
+                sum += value;
+                num_values++;
+            }
+
+            const QByteArray values =
+                EncodeValues(column_values, first, count);
+            directory_stream << qint64(data.size())
+                << qint64(values.size())
+                << qint32(num_values)
+                << minimum
+                << maximum
+                << sum;
+            data += values;
+        }
+    }
+
+    // Directory at the end; its last 8 bytes are its own position
+    directory_stream << qint64(data.size());
+    data += directory;
+
+    // Either the complete file or nothing
+    QSaveFile file(mcrFilename);
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(data) != data.size() ||
+        !file.commit())
+    {
+        const QString reason = tr("Could not write \"%1\": %2")
+            .arg(mcrFilename,
+                 file.errorString());
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Delta-of-delta encoding of timestamps
+QByteArray ColumnArchive::EncodeTimes(const QVector < qint64 > & mcrTimes,
+    const int mcFirst, const int mcCount)
+{
+    CALL_IN(QString("mcrTimes=..., mcFirst=%1, mcCount=%2")
+        .arg(CALL_SHOW(mcFirst),
+             CALL_SHOW(mcCount)));
+
+    // First time as is; then the change of the difference to the previous
+    // time (the first difference is relative to 0). A regular cadence
+    // gives 0, i.e. one bit per row.
+    QByteArray buffer;
+    qint64 bit_position = 0;
+    WriteBits(buffer, bit_position, quint64(mcrTimes[mcFirst]), 64);
+    qint64 previous_delta = 0;
+    for (int row = mcFirst + 1; row < mcFirst + mcCount; row++)
+    {
+        const qint64 delta = mcrTimes[row] - mcrTimes[row - 1];
+        const qint64 delta_of_delta = delta - previous_delta;
+        previous_delta = delta;
+        if (delta_of_delta == 0)
+        {
+            WriteBits(buffer, bit_position, 0b0, 1);
+        } else if (delta_of_delta >= -64 &&
+            delta_of_delta <= 63)
+        {
+            WriteBits(buffer, bit_position, 0b10, 2);
+            WriteBits(buffer, bit_position, quint64(delta_of_delta), 7);
+        } else if (delta_of_delta >= -256 &&
+            delta_of_delta <= 255)
+        {
+            WriteBits(buffer, bit_position, 0b110, 3);
+            WriteBits(buffer, bit_position, quint64(delta_of_delta), 9);
+        } else if (delta_of_delta >= -2048 &&
+            delta_of_delta <= 2047)
+        {
+            WriteBits(buffer, bit_position, 0b1110, 4);
+            WriteBits(buffer, bit_position, quint64(delta_of_delta), 12);
+        } else
+        {
+            WriteBits(buffer, bit_position, 0b1111, 4);
+            WriteBits(buffer, bit_position, quint64(delta_of_delta), 64);
+        }
+    }
+
+    CALL_OUT("");
+    return buffer;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// XOR encoding of values
+QByteArray ColumnArchive::EncodeValues(const QVector < double > & mcrValues,
+    const int mcFirst, const int mcCount)
+{
+    CALL_IN(QString("mcrValues=..., mcFirst=%1, mcCount=%2")
+        .arg(CALL_SHOW(mcFirst),
+             CALL_SHOW(mcCount)));
+
+    // First value as is; then the XOR with the previous value. Identical
+    // values take one bit; otherwise only the bits between the leading and
+    // trailing zeros of the XOR are stored, reusing the previous window
+    // when they fit into it.
+    QByteArray buffer;
+    qint64 bit_position = 0;
+    quint64 previous = 0;
+    int window_leading = -1;
+    int window_trailing = 0;
+    for (int row = mcFirst; row < mcFirst + mcCount; row++)
+    {
+        // All missing values look the same
+        double value = mcrValues[row];
+        if (qIsNaN(value))
+        {
+            value = std::numeric_limits < double >::quiet_NaN();
+        }
+        quint64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        if (row == mcFirst)
+        {
+            WriteBits(buffer, bit_position, bits, 64);
+            previous = bits;
+            continue;
+        }
+
+        const quint64 xor_bits = bits ^ previous;
+        previous = bits;
+        if (xor_bits == 0)
+        {
+            WriteBits(buffer, bit_position, 0b0, 1);
+            continue;
+        }
+
+        // Leading zeros are stored in 5 bits
+        const int leading = qMin(31, int(qCountLeadingZeroBits(xor_bits)));
+        const int trailing = int(qCountTrailingZeroBits(xor_bits));
+        if (window_leading >= 0 &&
+            leading >= window_leading &&
+            trailing >= window_trailing)
+        {
+            WriteBits(buffer, bit_position, 0b10, 2);
+            WriteBits(buffer, bit_position, xor_bits >> window_trailing,
+                64 - window_leading - window_trailing);
+        } else
+        {
+            // A length of 64 is stored as 0
+            const int length = 64 - leading - trailing;
+            WriteBits(buffer, bit_position, 0b11, 2);
+            WriteBits(buffer, bit_position, quint64(leading), 5);
+            WriteBits(buffer, bit_position, quint64(length & 0x3f), 6);
+            WriteBits(buffer, bit_position, xor_bits >> trailing, length);
+            window_leading = leading;
+            window_trailing = trailing;
+        }
+    }
+
+    CALL_OUT("");
+    return buffer;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Append the lowest mcNumBits bits of mcValue
+void ColumnArchive::WriteBits(QByteArray & mrBuffer, qint64 & mrBitPosition,
+    const quint64 mcValue, const int mcNumBits)
+{
+    // Called for every value - no CALL_IN/CALL_OUT in here.
+
+    // Most significant bit first
+    for (int bit = mcNumBits - 1; bit >= 0; bit--)
+    {
+        const qint64 byte_index = mrBitPosition / 8;
+        if (byte_index >= mrBuffer.size())
+        {
+            mrBuffer.append(char(0));
+        }
+        if ((mcValue >> bit) & 1)
+        {
+            mrBuffer[byte_index] =
+                char(mrBuffer[byte_index] | (0x80 >> (mrBitPosition % 8)));
+        }
+        mrBitPosition++;
+    }
+}
+
+
+
+// ==================================================================== Reading
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Map file, and read header and block directory
+bool ColumnArchive::Open(const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    Close();
+    m_Filename = mcrFilename;
+    m_File.setFileName(mcrFilename);
+    if (!m_File.open(QIODevice::ReadOnly))
+    {
+        const QString reason = tr("Could not open \"%1\": %2")
+            .arg(mcrFilename,
+                 m_File.errorString());
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    m_Size = m_File.size();
+    m_Data = (m_Size > 0 ? m_File.map(0, m_Size) : nullptr);
+    if (!m_Data)
+    {
+        const QString reason = tr("Could not map \"%1\": %2")
+            .arg(mcrFilename,
+                 m_File.errorString());
+        MessageLogger::Error(CALL_METHOD, reason);
+        Close();
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Header and directory are parsed in place (no copy)
+    const QByteArray data = QByteArray::fromRawData(
+        reinterpret_cast < const char * >(m_Data), m_Size);
+    QDataStream header(data);
+    header.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint32 num_rows = 0;
+    header >> magic
+        >> version;
+    if (magic != ARCHIVE_MAGIC ||
+        version != ARCHIVE_VERSION)
+    {
+        const QString reason = tr("\"%1\" is not an archive file (or of an "
+            "unknown version).")
+            .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        Close();
+        CALL_OUT(reason);
+        return false;
+    }
+    header >> m_StationID
+        >> m_TimeZone
+        >> m_Columns
+        >> num_rows;
+    m_NumberOfRows = num_rows;
+
+    // Position of the directory
+    qint64 directory_offset = -1;
+    if (m_Size >= qint64(sizeof(qint64)))
+    {
+        QDataStream trailer(data.right(sizeof(qint64)));
+        trailer.setVersion(QDataStream::Qt_6_0);
+        trailer >> directory_offset;
+    }
+    if (header.status() != QDataStream::Ok ||
+        directory_offset < 0 ||
+        directory_offset >= m_Size)
+    {
+        const QString reason = tr("\"%1\" is truncated.")
+            .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        Close();
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Directory
+    QDataStream directory(data);
+    directory.setVersion(QDataStream::Qt_6_0);
+    directory.skipRawData(int(directory_offset));
+    qint32 num_blocks = 0;
+    directory >> num_blocks;
+    const int num_columns = m_Columns.size();
+
+    // Number of blocks must fit what is left of the directory (less the
+    // trailing position) before anything is allocated for them
+    const qint64 directory_left =
+        m_Size - directory_offset - qint64(sizeof(qint32)) -
+        qint64(sizeof(qint64));
+    const qint64 entry_size =
+        BLOCK_ENTRY_SIZE + qint64(num_columns) * COLUMN_ENTRY_SIZE;
+    if (directory.status() != QDataStream::Ok ||
+        num_blocks < 0 ||
+        directory_left < 0 ||
+        num_blocks > directory_left / entry_size)
+    {
+        const QString reason = tr("Directory of \"%1\" is corrupt.")
+            .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        Close();
+        CALL_OUT(reason);
+        return false;
+    }
+    m_BlockSize.resize(num_blocks);
+    m_BlockFirstTime.resize(num_blocks);
+    m_BlockLastTime.resize(num_blocks);
+    m_TimesOffset.resize(num_blocks);
+    m_TimesLength.resize(num_blocks);
+    m_ValuesOffset.fill(QVector < qint64 >(num_columns), num_blocks);
+    m_ValuesLength.fill(QVector < qint64 >(num_columns), num_blocks);
+    m_Count.fill(QVector < int >(num_columns), num_blocks);
+    m_Minimum.fill(QVector < double >(num_columns), num_blocks);
+    m_Maximum.fill(QVector < double >(num_columns), num_blocks);
+    m_Sum.fill(QVector < double >(num_columns), num_blocks);
+    bool in_bounds = true;
+    for (int block = 0; block < num_blocks; block++)
+    {
+        qint32 block_size = 0;
+        directory >> block_size
+            >> m_BlockFirstTime[block]
+            >> m_BlockLastTime[block]
+            >> m_TimesOffset[block]
+            >> m_TimesLength[block];
+        m_BlockSize[block] = block_size;
+        in_bounds = in_bounds &&
+            block_size >= 0 &&
+            block_size <= BLOCK_SIZE &&
+            m_TimesOffset[block] >= 0 &&
+            m_TimesOffset[block] + m_TimesLength[block] <= directory_offset;
+        for (int column_index = 0;
+             column_index < num_columns;
+             column_index++)
+        {
+            qint32 count = 0;
+            directory >> m_ValuesOffset[block][column_index]
+                >> m_ValuesLength[block][column_index]
+                >> count
+                >> m_Minimum[block][column_index]
+                >> m_Maximum[block][column_index]
+                >> m_Sum[block][column_index];
+            m_Count[block][column_index] = count;
+            in_bounds = in_bounds &&
+                count >= 0 &&
+                count <= block_size &&
+                m_ValuesOffset[block][column_index] >= 0 &&
+                m_ValuesOffset[block][column_index] +
+                    m_ValuesLength[block][column_index] <= directory_offset;
+        }
+    }
+    if (directory.status() != QDataStream::Ok ||
+        !in_bounds)
+    {
+        const QString reason = tr("Directory of \"%1\" is corrupt.")
+            .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        Close();
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unmap file
+void ColumnArchive::Close()
+{
+    CALL_IN("");
+
+    if (m_Data)
+    {
+        m_File.unmap(const_cast < uchar * >(m_Data));
+        m_Data = nullptr;
+    }
+    m_Size = 0;
+    m_File.close();
+    m_BlockSize.clear();
+    m_BlockFirstTime.clear();
+    m_BlockLastTime.clear();
+    m_TimesOffset.clear();
+    m_TimesLength.clear();
+    m_ValuesOffset.clear();
+    m_ValuesLength.clear();
+    m_Count.clear();
+    m_Minimum.clear();
+    m_Maximum.clear();
+    m_Sum.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Station ID
+QString ColumnArchive::GetStationID() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_StationID;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Station time zone
+QString ColumnArchive::GetTimeZone() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_TimeZone;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Columns
+QStringList ColumnArchive::GetColumns() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Columns;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of rows
+int ColumnArchive::GetNumberOfRows() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_NumberOfRows;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of blocks
+int ColumnArchive::GetNumberOfBlocks() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_BlockSize.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of rows in a block
+int ColumnArchive::GetBlockSize(const int mcBlock) const
+{
+    CALL_IN(QString("mcBlock=%1")
+        .arg(CALL_SHOW(mcBlock)));
+
+    CALL_OUT("");
+    return m_BlockSize.value(mcBlock, 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// First time in a block
+qint64 ColumnArchive::GetBlockFirstTime(const int mcBlock) const
+{
+    CALL_IN(QString("mcBlock=%1")
+        .arg(CALL_SHOW(mcBlock)));
+
+    CALL_OUT("");
+    return m_BlockFirstTime.value(mcBlock, 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last time in a block
+qint64 ColumnArchive::GetBlockLastTime(const int mcBlock) const
+{
+    CALL_IN(QString("mcBlock=%1")
+        .arg(CALL_SHOW(mcBlock)));
+
+    CALL_OUT("");
+    return m_BlockLastTime.value(mcBlock, 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of values of a column in a block
+int ColumnArchive::GetBlockCount(const int mcBlock,
+    const QString & mcrColumn) const
+{
+    CALL_IN(QString("mcBlock=%1, mcrColumn=%2")
+        .arg(CALL_SHOW(mcBlock),
+             CALL_SHOW(mcrColumn)));
+
+    const int column_index = m_Columns.indexOf(mcrColumn);
+    if (mcBlock < 0 ||
+        mcBlock >= m_Count.size() ||
+        column_index < 0)
+    {
+        CALL_OUT("");
+        return 0;
+    }
+
+    CALL_OUT("");
+    return m_Count[mcBlock][column_index];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Minimum of a column in a block (NaN if there are no values)
+double ColumnArchive::GetBlockMinimum(const int mcBlock,
+    const QString & mcrColumn) const
+{
+    CALL_IN(QString("mcBlock=%1, mcrColumn=%2")
+        .arg(CALL_SHOW(mcBlock),
+             CALL_SHOW(mcrColumn)));
+
+    const int column_index = m_Columns.indexOf(mcrColumn);
+    if (mcBlock < 0 ||
+        mcBlock >= m_Minimum.size() ||
+        column_index < 0)
+    {
+        CALL_OUT("");
+        return qQNaN();
+    }
+
+    CALL_OUT("");
+    return m_Minimum[mcBlock][column_index];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Maximum of a column in a block (NaN if there are no values)
+double ColumnArchive::GetBlockMaximum(const int mcBlock,
+    const QString & mcrColumn) const
+{
+    CALL_IN(QString("mcBlock=%1, mcrColumn=%2")
+        .arg(CALL_SHOW(mcBlock),
+             CALL_SHOW(mcrColumn)));
+
+    const int column_index = m_Columns.indexOf(mcrColumn);
+    if (mcBlock < 0 ||
+        mcBlock >= m_Maximum.size() ||
+        column_index < 0)
+    {
+        CALL_OUT("");
+        return qQNaN();
+    }
+
+    CALL_OUT("");
+    return m_Maximum[mcBlock][column_index];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sum of a column in a block
+double ColumnArchive::GetBlockSum(const int mcBlock,
+    const QString & mcrColumn) const
+{
+    CALL_IN(QString("mcBlock=%1, mcrColumn=%2")
+        .arg(CALL_SHOW(mcBlock),
+             CALL_SHOW(mcrColumn)));
+
+    const int column_index = m_Columns.indexOf(mcrColumn);
+    if (mcBlock < 0 ||
+        mcBlock >= m_Sum.size() ||
+        column_index < 0)
+    {
+        CALL_OUT("");
+        return 0;
+    }
+
+    CALL_OUT("");
+    return m_Sum[mcBlock][column_index];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Rows in a time range, one block at a time
+bool ColumnArchive::ScanBlocks(const qint64 mcFrom, const qint64 mcTo,
+    const QStringList & mcrColumns,
+    const std::function < bool (QSpan < const qint64 >,
+        const QList < QSpan < const double > > &) > & mcrCallback)
+{
+    CALL_IN(QString("mcFrom=%1, mcTo=%2, mcrColumns=%3, mcrCallback=...")
+        .arg(CALL_SHOW(mcFrom),
+             CALL_SHOW(mcTo),
+             CALL_SHOW(mcrColumns)));
+
+    // Map requested columns
+    QVector < int > column_indices;
+    for (const QString & column : mcrColumns)
+    {
+        const int column_index = m_Columns.indexOf(column);
+        if (column_index < 0)
+        {
+            const QString reason = tr("\"%1\" has no column \"%2\".")
+                .arg(m_Filename,
+                     column);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        column_indices << column_index;
+    }
+
+    while (m_ValuesBuffers.size() < column_indices.size())
+    {
+        m_ValuesBuffers << QVector < double >();
+    }
+    QList < QSpan < const double > > values(column_indices.size());
+    for (int block = 0; block < m_BlockSize.size(); block++)
+    {
+        // Skip blocks outside the range
+        if (m_BlockLastTime[block] < mcFrom ||
+            m_BlockFirstTime[block] >= mcTo)
+        {
+            continue;
+        }
+
+        // Decode only the columns we need
+        DecodeTimes(block, m_TimesBuffer);
+        for (int value_index = 0;
+             value_index < column_indices.size();
+             value_index++)
+        {
+            DecodeValues(block, column_indices[value_index],
+                m_ValuesBuffers[value_index]);
+        }
+
+        // Times are sorted, so the range is one stretch of rows
+        const qint64 * times_begin = m_TimesBuffer.constData();
+        const qint64 * times_end = times_begin + m_TimesBuffer.size();
+        const qint64 first =
+            std::lower_bound(times_begin, times_end, mcFrom) - times_begin;
+        const qint64 last =
+            std::lower_bound(times_begin, times_end, mcTo) - times_begin;
+        if (first == last)
+        {
+            continue;
+        }
+        for (int value_index = 0;
+             value_index < column_indices.size();
+             value_index++)
+        {
+            values[value_index] = QSpan < const double >(
+                m_ValuesBuffers[value_index].constData() + first,
+                last - first);
+        }
+        if (!mcrCallback(QSpan < const qint64 >(times_begin + first,
+            last - first), values))
+        {
+            // Caller has seen enough
+            CALL_OUT("");
+            return true;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Rows in a time range, one row at a time
+bool ColumnArchive::Scan(const qint64 mcFrom, const qint64 mcTo,
+    const QStringList & mcrColumns,
+    const std::function < bool (const qint64,
+        const QVector < double > &) > & mcrCallback)
+{
+    CALL_IN(QString("mcFrom=%1, mcTo=%2, mcrColumns=%3, mcrCallback=...")
+        .arg(CALL_SHOW(mcFrom),
+             CALL_SHOW(mcTo),
+             CALL_SHOW(mcrColumns)));
+
+    QVector < double > row_values(mcrColumns.size());
+    const bool success = ScanBlocks(mcFrom, mcTo, mcrColumns,
+        [&](QSpan < const qint64 > mTimes,
+            const QList < QSpan < const double > > & mcrValues)
+        {
+            for (qsizetype row = 0; row < mTimes.size(); row++)
+            {
+                for (int value_index = 0;
+                     value_index < mcrValues.size();
+                     value_index++)
+                {
+                    row_values[value_index] = mcrValues[value_index][row];
+                }
+                if (!mcrCallback(mTimes[row], row_values))
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Count, minimum, maximum and sum of a column in a time range
+bool ColumnArchive::Summarize(const qint64 mcFrom, const qint64 mcTo,
+    const QString & mcrColumn, int & mrCount, double & mrMinimum,
+    double & mrMaximum, double & mrSum)
+{
+    CALL_IN(QString("mcFrom=%1, mcTo=%2, mcrColumn=%3, mrCount=%4, "
+        "mrMinimum=%5, mrMaximum=%6, mrSum=%7")
+        .arg(CALL_SHOW(mcFrom),
+             CALL_SHOW(mcTo),
+             CALL_SHOW(mcrColumn),
+             CALL_SHOW(mrCount),
+             CALL_SHOW(mrMinimum),
+             CALL_SHOW(mrMaximum),
+             CALL_SHOW(mrSum)));
+
+    const int column_index = m_Columns.indexOf(mcrColumn);
+    if (column_index < 0)
+    {
+        const QString reason = tr("\"%1\" has no column \"%2\".")
+            .arg(m_Filename,
+                 mcrColumn);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    mrCount = 0;
+    mrMinimum = qQNaN();
+    mrMaximum = qQNaN();
+    mrSum = 0;
+    for (int block = 0; block < m_BlockSize.size(); block++)
+    {
+        if (m_BlockLastTime[block] < mcFrom ||
+            m_BlockFirstTime[block] >= mcTo)
+        {
+            continue;
+        }
+
+        // Block entirely in range: statistics from the directory
+        int count = 0;
+        double minimum = qQNaN();
+        double maximum = qQNaN();
+        double sum = 0;
+        if (m_BlockFirstTime[block] >= mcFrom &&
+            m_BlockLastTime[block] < mcTo)
+        {
+            count = m_Count[block][column_index];
+            minimum = m_Minimum[block][column_index];
+            maximum = m_Maximum[block][column_index];
+            sum = m_Sum[block][column_index];
+        } else
+        {
+            // Rows of this block within the range (times are unique, so no
+            // other block has any)
+            const qint64 from = qMax(mcFrom, m_BlockFirstTime[block]);
+            const qint64 to = qMin(mcTo, m_BlockLastTime[block] + 1);
+            if (!ScanBlocks(from, to, { mcrColumn },
+                [&](QSpan < const qint64 >,
+                    const QList < QSpan < const double > > & mcrValues)
+                {
+                    for (const double value : mcrValues[0])
+                    {
+                        if (qIsNaN(value))
+                        {
+                            continue;
+                        }
+                        minimum = (count == 0 ? value : qMin(minimum, value));
+                        maximum = (count == 0 ? value : qMax(maximum, value));
+                        sum += value;
+                        count++;
+                    }
+                    return true;
+                }))
+            {
+                // Has been reported.
+                CALL_OUT("");
+                return false;
+            }
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+
+        mrMinimum = (mrCount == 0 ? minimum : qMin(mrMinimum, minimum));
+        mrMaximum = (mrCount == 0 ? maximum : qMax(mrMaximum, maximum));
+        mrSum += sum;
+        mrCount += count;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Decode a block's timestamps
+void ColumnArchive::DecodeTimes(const int mcBlock,
+    QVector < qint64 > & mrTimes) const
+{
+    CALL_IN(QString("mcBlock=%1, mrTimes=...")
+        .arg(CALL_SHOW(mcBlock)));
+
+    // Straight from the mapped file
+    const uchar * data = m_Data + m_TimesOffset[mcBlock];
+    const qint64 size = m_TimesLength[mcBlock];
+    const int count = m_BlockSize[mcBlock];
+    mrTimes.resize(count);
+    if (count == 0)
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    // Sign extension for the short encodings
+    qint64 bit_position = 0;
+    auto read_signed = [&](const int mcNumBits)
+    {
+        const quint64 value =
+            ReadBits(data, size, bit_position, mcNumBits);
+        if (mcNumBits < 64 &&
+            (value >> (mcNumBits - 1)) & 1)
+        {
+            return qint64(value) - (qint64(1) << mcNumBits);
+        }
+        return qint64(value);
+    };
+
+    qint64 time = qint64(ReadBits(data, size, bit_position, 64));
+    qint64 delta = 0;
+    mrTimes[0] = time;
+    for (int row = 1; row < count; row++)
+    {
+        qint64 delta_of_delta = 0;
+        if (ReadBits(data, size, bit_position, 1) == 0)
+        {
+            delta_of_delta = 0;
+        } else if (ReadBits(data, size, bit_position, 1) == 0)
+        {
+            delta_of_delta = read_signed(7);
+        } else if (ReadBits(data, size, bit_position, 1) == 0)
+        {
+            delta_of_delta = read_signed(9);
+        } else if (ReadBits(data, size, bit_position, 1) == 0)
+        {
+            delta_of_delta = read_signed(12);
+        } else
+        {
+            delta_of_delta = read_signed(64);
+        }
+        delta += delta_of_delta;
+        time += delta;
+        mrTimes[row] = time;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Decode a block's values of a column
+void ColumnArchive::DecodeValues(const int mcBlock, const int mcColumn,
+    QVector < double > & mrValues) const
+{
+    CALL_IN(QString("mcBlock=%1, mcColumn=%2, mrValues=...")
+        .arg(CALL_SHOW(mcBlock),
+             CALL_SHOW(mcColumn)));
+
+    // Straight from the mapped file
+    const uchar * data = m_Data + m_ValuesOffset[mcBlock][mcColumn];
+    const qint64 size = m_ValuesLength[mcBlock][mcColumn];
+    const int count = m_BlockSize[mcBlock];
+    mrValues.resize(count);
+
+    qint64 bit_position = 0;
+    quint64 bits = ReadBits(data, size, bit_position, 64);
+    int window_leading = 0;
+    int window_trailing = 0;
+    for (int row = 0; row < count; row++)
+    {
+        if (row > 0 &&
+            ReadBits(data, size, bit_position, 1) == 1)
+        {
+            if (ReadBits(data, size, bit_position, 1) == 1)
+            {
+                // New window
+                window_leading = int(ReadBits(data, size, bit_position, 5));
+                int length = int(ReadBits(data, size, bit_position, 6));
+                if (length == 0)
+                {
+                    length = 64;
+                }
+                window_trailing = 64 - window_leading - length;
+            }
+            const int length = 64 - window_leading - window_trailing;
+            bits ^= ReadBits(data, size, bit_position, length) <<
+                window_trailing;
+        }
+        std::memcpy(&mrValues[row], &bits, sizeof(double));
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read mcNumBits bits
+quint64 ColumnArchive::ReadBits(const uchar * mcpData, const qint64 mcSize,
+    qint64 & mrBitPosition, const int mcNumBits)
+{
+    // Called for every value - no CALL_IN/CALL_OUT in here.
+
+    // Up to a byte at a time. Past the end reads as 0 bits (a corrupt file
+    // gives garbage, but doesn't crash).
+    quint64 value = 0;
+    int remaining = mcNumBits;
+    while (remaining > 0)
+    {
+        const qint64 byte_index = mrBitPosition / 8;
+        const int available = 8 - int(mrBitPosition % 8);
+        const int num_bits = qMin(available, remaining);
+        const uint byte = (byte_index < mcSize ? mcpData[byte_index] : 0);
+        value = (value << num_bits) |
+            ((byte >> (available - num_bits)) & ((1u << num_bits) - 1));
+        mrBitPosition += num_bits;
+        remaining -= num_bits;
+    }
+    return value;
+}
+
+
+
+// ====================================================================== Times
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Station time as seconds
+qint64 ColumnArchive::ToSeconds(const QDate & mcrDate, const QTime & mcrTime)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    const qint64 seconds = mcrDate.toJulianDay() * 86400 +
+        mcrTime.msecsSinceStartOfDay() / 1000;
+
+    return seconds;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Date part of seconds
+QDate ColumnArchive::DateFromSeconds(const qint64 mcSeconds)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    const QDate date = QDate::fromJulianDay(mcSeconds / 86400);
+
+    return date;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time part of seconds
+QTime ColumnArchive::TimeFromSeconds(const qint64 mcSeconds)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    const QTime time =
+        QTime::fromMSecsSinceStartOfDay(int(mcSeconds % 86400) * 1000);
+
+    return time;
+}
@@ -0,0 +1,193 @@
+// ColumnArchive.h
+// Class definition
+
+/** \class ColumnArchive
+  * Compressed, column-oriented file with the observations of one station
+  * and month, for history that doesn't change any more.
+  *
+  * Rows are stored in blocks of BLOCK_SIZE. Within a block, every column is
+  * compressed on its own: timestamps (seconds, station time) as
+  * delta-of-delta, values as the XOR with the previous value (as in
+  * Facebook's Gorilla). At a five-minute cadence most timestamps take one
+  * bit and unchanged values take one bit. A directory at the end of the
+  * file has the position of every column of every block plus its count,
+  * minimum, maximum and sum, so scans only decode the blocks and columns
+  * they need.
+  *
+  * Missing values are NaN.
+  *
+  * Files are memory-mapped for reading: opening one only reads the
+  * directory, blocks are decoded straight from the page cache, and
+  * ScanBlocks() hands out every block's rows as spans of plain arrays that
+  * are reused from block to block, so scans don't allocate per row.
+  */
+
+#ifndef COLUMNARCHIVE_H
+#define COLUMNARCHIVE_H
+
+// Qt includes
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDate>
+#include <QFile>
+#include <QList>
+#include <QSpan>
+#include <QString>
+#include <QStringList>
+#include <QTime>
+#include <QVector>
+
+// System includes
+#include <functional>
+
+
+
+// Class definition
+class ColumnArchive
+{
+    Q_DECLARE_TR_FUNCTIONS(ColumnArchive)
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    ColumnArchive();
+
+    // Mapped files can't be copied
+    Q_DISABLE_COPY(ColumnArchive)
+
+    // Destructor
+    virtual ~ColumnArchive();
+
+    // Rows per block
+    static const int BLOCK_SIZE = 1024;
+
+
+
+    // ================================================================ Writing
+public:
+    // Write observations to a file: times (see ToSeconds()), and for every
+    // column one value per time
+    static bool Write(const QString & mcrFilename,
+        const QString & mcrStationID, const QString & mcrTimeZone,
+        const QStringList & mcrColumns, const QVector < qint64 > & mcrTimes,
+        const QList < QVector < double > > & mcrValues);
+
+private:
+    // Delta-of-delta encoding of timestamps
+    static QByteArray EncodeTimes(const QVector < qint64 > & mcrTimes,
+        const int mcFirst, const int mcCount);
+
+    // XOR encoding of values
+    static QByteArray EncodeValues(const QVector < double > & mcrValues,
+        const int mcFirst, const int mcCount);
+
+    // Append the lowest mcNumBits bits of mcValue
+    static void WriteBits(QByteArray & mrBuffer, qint64 & mrBitPosition,
+        const quint64 mcValue, const int mcNumBits);
+
+
+
+    // ================================================================ Reading
+public:
+    // Map file, and read header and block directory
+    bool Open(const QString & mcrFilename);
+
+    // Unmap file
+    void Close();
+
+    // Header
+    QString GetStationID() const;
+    QString GetTimeZone() const;
+    QStringList GetColumns() const;
+    int GetNumberOfRows() const;
+
+    // Blocks and their statistics
+    int GetNumberOfBlocks() const;
+    int GetBlockSize(const int mcBlock) const;
+    qint64 GetBlockFirstTime(const int mcBlock) const;
+    qint64 GetBlockLastTime(const int mcBlock) const;
+    int GetBlockCount(const int mcBlock, const QString & mcrColumn) const;
+    double GetBlockMinimum(const int mcBlock, const QString & mcrColumn) const;
+    double GetBlockMaximum(const int mcBlock, const QString & mcrColumn) const;
+    double GetBlockSum(const int mcBlock, const QString & mcrColumn) const;
+
+    // Rows from mcFrom (inclusive) to mcTo (exclusive) with the values of
+    // mcrColumns, one block at a time: times and one span per column (in
+    // the order of mcrColumns), valid during the call only. Only blocks
+    // that overlap the range are decoded. mcrCallback returns false to
+    // stop.
+    bool ScanBlocks(const qint64 mcFrom, const qint64 mcTo,
+        const QStringList & mcrColumns,
+        const std::function < bool (QSpan < const qint64 >,
+            const QList < QSpan < const double > > &) > & mcrCallback);
+
+    // Same, one row at a time
+    bool Scan(const qint64 mcFrom, const qint64 mcTo,
+        const QStringList & mcrColumns,
+        const std::function < bool (const qint64,
+            const QVector < double > &) > & mcrCallback);
+
+    // Count, minimum, maximum and sum of a column from mcFrom (inclusive) to
+    // mcTo (exclusive); blocks that are entirely within the range aren't
+    // decoded at all
+    bool Summarize(const qint64 mcFrom, const qint64 mcTo,
+        const QString & mcrColumn, int & mrCount, double & mrMinimum,
+        double & mrMaximum, double & mrSum);
+
+private:
+    // Decode a block's timestamps (into a buffer that is reused)
+    void DecodeTimes(const int mcBlock, QVector < qint64 > & mrTimes) const;
+
+    // Decode a block's values of a column (into a buffer that is reused)
+    void DecodeValues(const int mcBlock, const int mcColumn,
+        QVector < double > & mrValues) const;
+
+    // Read mcNumBits bits from mcSize bytes at mcpData
+    static quint64 ReadBits(const uchar * mcpData, const qint64 mcSize,
+        qint64 & mrBitPosition, const int mcNumBits);
+
+    // Mapped file
+    QString m_Filename;
+    QFile m_File;
+    const uchar * m_Data;
+    qint64 m_Size;
+
+    // Decoding buffers
+    QVector < qint64 > m_TimesBuffer;
+    QList < QVector < double > > m_ValuesBuffers;
+
+    // Header
+    QString m_StationID;
+    QString m_TimeZone;
+    QStringList m_Columns;
+    int m_NumberOfRows;
+
+    // Directory: per block...
+    QVector < int > m_BlockSize;
+    QVector < qint64 > m_BlockFirstTime;
+    QVector < qint64 > m_BlockLastTime;
+    QVector < qint64 > m_TimesOffset;
+    QVector < qint64 > m_TimesLength;
+
+    // ...and column
+    QVector < QVector < qint64 > > m_ValuesOffset;
+    QVector < QVector < qint64 > > m_ValuesLength;
+    QVector < QVector < int > > m_Count;
+    QVector < QVector < double > > m_Minimum;
+    QVector < QVector < double > > m_Maximum;
+    QVector < QVector < double > > m_Sum;
+
+
+
+    // ================================================================== Times
+public:
+    // Station time as seconds (no time zone involved, so no gaps or
+    // repeated hours), and back
+    static qint64 ToSeconds(const QDate & mcrDate, const QTime & mcrTime);
+    static QDate DateFromSeconds(const qint64 mcSeconds);
+    static QTime TimeFromSeconds(const qint64 mcSeconds);
+};
+
+#endif
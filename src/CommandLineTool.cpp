@@ -0,0 +1,1958 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// CommandLineTool.cpp
+// Class implementation
+
+// Project includes
+#include "ArchiveBackend.h"
+#include "CallTracer.h"
+#include "ColumnArchive.h"
+#include "CommandLineTool.h"
+#include "Config.h"
+#include "DatabaseHelper.h"
+#include "MemoryBackend.h"
+#include "MessageLogger.h"
+#include "SignalHandler.h"
+#include "SqliteBackend.h"
+#include "StringHelper.h"
+#include "WundergroundComms.h"
+
+// Qt includes
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QtMath>
+#include <QtNumeric>
+
+// System includes
+#include <cstdio>
+#include <limits>
+
+// Classes and methods that are traced (see CallTracer::SetScopes())
+#ifndef CALL_TRACER_SCOPES
+#define CALL_TRACER_SCOPES QString()
+#endif
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+CommandLineTool::CommandLineTool()
+{
+    CALL_IN("");
+
+    m_Concurrency = 4;
+    m_Format = "csv";
+    m_BackfillDone = 0;
+    m_BackfillTotal = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+CommandLineTool::~CommandLineTool()
+{
+    CALL_IN("");
+
+    m_Output.flush();
+
+    // Call history as trace events
+    if (!m_TraceFilename.isEmpty() &&
+        !CallTracer::WriteChromeTrace(m_TraceFilename))
+    {
+        MessageLogger::Error(CALL_METHOD,
+            tr("Could not write trace to \"%1\".").arg(m_TraceFilename));
+    }
+
+#ifdef TRACE_ALLOCATIONS
+    // Where the command allocated
+    CallTracer::ShowAllocations();
+#endif
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instanciator
+CommandLineTool * CommandLineTool::Instance()
+{
+    CALL_IN("");
+
+    if (!m_Instance)
+    {
+        m_Instance = new CommandLineTool();
+    }
+
+    CALL_OUT("");
+    return m_Instance;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instance
+CommandLineTool * CommandLineTool::m_Instance = nullptr;
+
+
+
+// =============================================================== Command line
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if the arguments contain a command
+bool CommandLineTool::ParseArguments(const QStringList & mcrArguments)
+{
+    CALL_IN(QString("mcrArguments=%1")
+        .arg(CALL_SHOW(mcrArguments)));
+
+    QCommandLineParser parser;
+    parser.addPositionalArgument("command",
+        tr("backfill, verify, export, stats, rollup-rebuild, split, "
+            "archive, bench-insert, bench-archive, bench-backend, "
+            "bench-tracer or flight-decode"));
+    const QCommandLineOption option_concurrency("concurrency",
+        tr("Number of parallel downloads or threads."), "n", "4");
+    const QCommandLineOption option_from("from",
+        tr("First date (YYYYMMDD or YYYY-MM-DD)."), "date");
+    const QCommandLineOption option_to("to",
+        tr("Last date (YYYYMMDD or YYYY-MM-DD)."), "date");
+    const QCommandLineOption option_format("format",
+        tr("Export format: csv, tsv or jsonl."), "format", "csv");
+    const QCommandLineOption option_output("output",
+        tr("Export to file instead of standard output."), "file");
+    const QCommandLineOption option_trace("trace",
+        tr("Write the call history as Chrome trace events (for Perfetto) "
+            "to file."), "file");
+    const QCommandLineOption option_flight_recorder("flight-recorder",
+        tr("Write recent calls and log lines to file if the command "
+            "crashes or is terminated."), "file");
+    const QCommandLineOption option_backend("backend",
+        tr("Where observations are kept: sqlite, memory or archive."),
+        "name");
+    const QCommandLineOption option_trace_scopes("trace-scopes",
+        tr("Classes and methods to trace, e.g. "
+            "\"*=off,WundergroundComms=verbose,DatabaseHelper=100\"."),
+        "rules");
+    parser.addOption(option_concurrency);
+    parser.addOption(option_from);
+    parser.addOption(option_to);
+    parser.addOption(option_format);
+    parser.addOption(option_output);
+    parser.addOption(option_trace);
+    parser.addOption(option_flight_recorder);
+    parser.addOption(option_backend);
+    parser.addOption(option_trace_scopes);
+    if (!parser.parse(mcrArguments))
+    {
+        MessageLogger::Error(CALL_METHOD, parser.errorText());
+        m_Command = "invalid";
+        CALL_OUT("");
+        return true;
+    }
+
+    // Tracing scopes: configuration, then environment, then command line
+    // (later rules override earlier ones); for the daemon, too
+    const QString scopes = QStringList {
+        QString(CALL_TRACER_SCOPES),
+        qEnvironmentVariable("WU_TRACE_SCOPES"),
+        parser.value(option_trace_scopes) }.join(",");
+    if (!CallTracer::SetScopes(scopes))
+    {
+        MessageLogger::Error(CALL_METHOD,
+            tr("Invalid tracing scopes \"%1\".").arg(scopes));
+        m_Command = "invalid";
+        CALL_OUT("");
+        return true;
+    }
+
+    // Storage backend (before anything opens the database; for the daemon,
+    // too)
+    if (parser.isSet(option_backend) &&
+        !WundergroundComms::Instance() ->
+            SetStorageBackend(parser.value(option_backend)))
+    {
+        // Has been reported.
+        m_Command = "invalid";
+        CALL_OUT("");
+        return true;
+    }
+
+    // No command: run as daemon
+    const QStringList positional = parser.positionalArguments();
+    if (positional.isEmpty())
+    {
+        CALL_OUT("");
+        return false;
+    }
+    m_Command = positional.first();
+    m_Parameters = positional.mid(1);
+
+    // Options
+    bool ok = false;
+    m_Concurrency = parser.value(option_concurrency).toInt(&ok);
+    if (!ok ||
+        m_Concurrency < 1)
+    {
+        MessageLogger::Error(CALL_METHOD,
+            tr("Invalid concurrency \"%1\".")
+                .arg(parser.value(option_concurrency)));
+        m_Command = "invalid";
+    }
+    if (parser.isSet(option_from))
+    {
+        m_From = ParseDate(parser.value(option_from));
+        if (!m_From.isValid())
+        {
+            MessageLogger::Error(CALL_METHOD,
+                tr("Invalid date \"%1\".").arg(parser.value(option_from)));
+            m_Command = "invalid";
+        }
+    }
+    if (parser.isSet(option_to))
+    {
+        m_To = ParseDate(parser.value(option_to));
+        if (!m_To.isValid())
+        {
+            MessageLogger::Error(CALL_METHOD,
+                tr("Invalid date \"%1\".").arg(parser.value(option_to)));
+            m_Command = "invalid";
+        }
+    }
+    m_Format = parser.value(option_format);
+    m_OutputFilename = parser.value(option_output);
+
+    // Keep the entire call history for the trace
+    m_TraceFilename = parser.value(option_trace);
+    if (!m_TraceFilename.isEmpty())
+    {
+        CallTracer::SetKeepAllHistory(true);
+    }
+
+    // Flight record on crashes and termination
+    if (parser.isSet(option_flight_recorder) &&
+        !CallTracer::StartFlightRecorder(
+            parser.value(option_flight_recorder)))
+    {
+        MessageLogger::Error(CALL_METHOD,
+            tr("Could not start flight recorder \"%1\".")
+                .arg(parser.value(option_flight_recorder)));
+        m_Command = "invalid";
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Execute command
+void CommandLineTool::Run()
+{
+    CALL_IN("");
+
+    // Output goes to stdout unless there is an output file
+    bool output_open = false;
+    if (m_OutputFilename.isEmpty())
+    {
+        output_open = m_OutputFile.open(stdout, QIODevice::WriteOnly);
+    } else
+    {
+        m_OutputFile.setFileName(m_OutputFilename);
+        output_open = m_OutputFile.open(QIODevice::WriteOnly);
+    }
+    if (!output_open)
+    {
+        const QString reason = tr("Could not open output \"%1\".")
+            .arg(m_OutputFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        QCoreApplication::exit(1);
+        CALL_OUT(reason);
+        return;
+    }
+    m_Output.setDevice(&m_OutputFile);
+
+    // Execute command
+    int result = 0;
+    if (m_Command == "backfill")
+    {
+        result = Command_Backfill();
+        if (result < 0)
+        {
+            // Still running; exit code will be sent when done.
+            CALL_OUT("");
+            return;
+        }
+    } else if (m_Command == "verify")
+    {
+        result = Command_Verify();
+    } else if (m_Command == "export")
+    {
+        result = Command_Export();
+    } else if (m_Command == "stats")
+    {
+        result = Command_Stats();
+    } else if (m_Command == "rollup-rebuild")
+    {
+        result = Command_RollupRebuild();
+    } else if (m_Command == "split")
+    {
+        result = Command_Split();
+    } else if (m_Command == "archive")
+    {
+        result = Command_Archive();
+    } else if (m_Command == "bench-insert")
+    {
+        result = Command_BenchInsert();
+    } else if (m_Command == "bench-archive")
+    {
+        result = Command_BenchArchive();
+    } else if (m_Command == "bench-backend")
+    {
+        result = Command_BenchBackend();
+    } else if (m_Command == "bench-tracer")
+    {
+        result = Command_BenchTracer();
+    } else if (m_Command == "flight-decode")
+    {
+        result = Command_FlightDecode();
+    } else
+    {
+        if (m_Command != "help")
+        {
+            MessageLogger::Error(CALL_METHOD,
+                tr("Unknown command \"%1\".").arg(m_Command));
+            result = 1;
+        }
+        Output(Usage());
+    }
+
+    QCoreApplication::exit(result);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Usage information
+QString CommandLineTool::Usage() const
+{
+    CALL_IN("");
+
+    const QString usage = tr(
+        "Usage: WundergroundDaemon [command] [options]\n"
+        "\n"
+        "Without a command, runs as a daemon downloading updates.\n"
+        "\n"
+        "Commands:\n"
+        "  backfill <from> <to>  Download all dates in the range\n"
+        "                        (--concurrency n, default 4)\n"
+        "  verify                Report incomplete, missing and duplicate\n"
+        "                        observations (--from, --to)\n"
+        "  export                Export observations (--from, --to,\n"
+        "                        --format csv|tsv|jsonl, --output file)\n"
+        "  stats                 Row counts, database size, per-day\n"
+        "                        coverage and SQL timing (--from, --to)\n"
+        "  rollup-rebuild        Recompute hourly, daily and monthly\n"
+        "                        rollups (--concurrency n threads)\n"
+        "  split                 Move observations into one database file\n"
+        "                        per station and year\n"
+        "  archive               Export months that are over to compressed\n"
+        "                        column files\n"
+        "  bench-insert [rows]   Insert speed with and without prepared\n"
+        "                        statement cache (scratch database)\n"
+        "  bench-archive         Scan speed and size of archived months\n"
+        "                        compared to SQLite\n"
+        "  bench-backend [rows]  Append, range query and day summary speed\n"
+        "                        of each storage backend (scratch data)\n"
+        "  bench-tracer [calls]  Cost of CALL_IN/CALL_OUT per call\n"
+        "  flight-decode <file>  Show a flight record\n"
+        "\n"
+        "Any command with --trace file writes its call history as Chrome\n"
+        "trace events (JSON; open in Perfetto or chrome://tracing).\n"
+        "With --flight-recorder file, recent calls and log lines are\n"
+        "written to file if the command crashes or is terminated.\n"
+        "--backend sqlite|memory|archive chooses where observations are\n"
+        "kept.\n"
+        "--trace-scopes rules (or WU_TRACE_SCOPES) chooses what is\n"
+        "traced: comma-separated scope=setting, scope being * or a class\n"
+        "or Class::method, setting off, on, verbose or N (every N-th\n"
+        "call).\n"
+        "\n"
+        "Exit codes: 0 success, 1 error, 2 problems found (backfill,\n"
+        "verify), 130 interrupted.");
+
+    CALL_OUT("");
+    return usage;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open the ingest engine's database
+bool CommandLineTool::OpenEngine(const bool mcReadData)
+{
+    CALL_IN(QString("mcReadData=%1")
+        .arg(CALL_SHOW(mcReadData)));
+
+    WundergroundComms * wc = WundergroundComms::Instance();
+    if (!wc -> SetPWSName(WU_PWS_NAME) ||
+        !wc -> SetToken(WU_TOKEN))
+    {
+        const QString reason = tr("Invalid configuration.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    wc -> SetDatabaseFile(WU_DATABASE_FILE);
+    if (!wc -> OpenDatabase(mcReadData))
+    {
+        const QString reason = tr("Could not open database.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Date from YYYYMMDD or YYYY-MM-DD
+QDate CommandLineTool::ParseDate(const QString & mcrDate)
+{
+    CALL_IN(QString("mcrDate=%1")
+        .arg(CALL_SHOW(mcrDate)));
+
+    QDate date = QDate::fromString(mcrDate, "yyyyMMdd");
+    if (!date.isValid())
+    {
+        date = QDate::fromString(mcrDate, "yyyy-MM-dd");
+    }
+
+    CALL_OUT("");
+    return date;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write a line to the output
+void CommandLineTool::Output(const QString & mcrLine)
+{
+    CALL_IN(QString("mcrLine=%1")
+        .arg(CALL_SHOW(mcrLine)));
+
+    // Qt::endl flushes, so output can be followed while it's being produced
+    m_Output << mcrLine << Qt::endl;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SQL condition for --from/--to
+QString CommandLineTool::RangeCondition() const
+{
+    CALL_IN("");
+
+    QStringList conditions;
+    if (m_From.isValid())
+    {
+        conditions << "date_time >= :from";
+    }
+    if (m_To.isValid())
+    {
+        conditions << "date_time < :to";
+    }
+    if (conditions.isEmpty())
+    {
+        CALL_OUT("");
+        return QString();
+    }
+
+    CALL_OUT("");
+    return " WHERE " + conditions.join(" AND ");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Partitions for --from/--to
+QStringList CommandLineTool::RangePartitions() const
+{
+    CALL_IN("");
+
+    // Main database first (observations that haven't been split)
+    WundergroundComms * wc = WundergroundComms::Instance();
+    const QStringList partitions = QStringList({ QString() }) +
+        wc -> GetPartitions(QString(),
+            m_From.isValid() ? m_From.year() : 0,
+            m_To.isValid() ? m_To.year() : 9999);
+
+    CALL_OUT("");
+    return partitions;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Bind values for --from/--to
+void CommandLineTool::BindRange(QSqlQuery & mrQuery) const
+{
+    CALL_IN(QString("mrQuery=%1")
+        .arg(CALL_SHOW(mrQuery)));
+
+    // date_time is stored as "yyyy-MM-dd hh:mm:ss", so text comparison works
+    if (m_From.isValid())
+    {
+        mrQuery.bindValue(":from", m_From.toString("yyyy-MM-dd"));
+    }
+    if (m_To.isValid())
+    {
+        mrQuery.bindValue(":to", m_To.addDays(1).toString("yyyy-MM-dd"));
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// =================================================================== Commands
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Download a range of dates
+int CommandLineTool::Command_Backfill()
+{
+    CALL_IN("");
+
+    // backfill <from> <to>
+    if (m_Parameters.size() != 2)
+    {
+        const QString reason = tr("backfill needs a first and a last date.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    const QDate from = ParseDate(m_Parameters[0]);
+    const QDate to = ParseDate(m_Parameters[1]);
+    if (!from.isValid() ||
+        !to.isValid() ||
+        from > to)
+    {
+        const QString reason = tr("Invalid date range \"%1\" to \"%2\".")
+            .arg(m_Parameters[0],
+                 m_Parameters[1]);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+
+    // Need the known observations to avoid duplicates
+    if (!OpenEngine(true))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    WundergroundComms * wc = WundergroundComms::Instance();
+    connect (wc, SIGNAL(DataReceived(const QString)),
+        this, SLOT(Backfill_DataReceived(const QString)));
+    connect (wc, SIGNAL(DownloadFailed(const QString)),
+        this, SLOT(Backfill_DownloadFailed(const QString)));
+    connect (wc, SIGNAL(QueueFinished()),
+        this, SLOT(Backfill_Finished()));
+    connect (wc, SIGNAL(ShutdownComplete()),
+        this, SLOT(ShutdownComplete()));
+    SignalHandler * signal_handler = SignalHandler::Instance();
+    connect (signal_handler, SIGNAL(TerminationRequested(int)),
+        this, SLOT(TerminationRequested(int)));
+
+    QStringList dates;
+    for (QDate date = from; date <= to; date = date.addDays(1))
+    {
+        dates << date.toString("yyyyMMdd");
+    }
+    m_BackfillDone = 0;
+    Output(tr("Backfilling %1 date(s) from %2 to %3, %4 in parallel")
+        .arg(QString::number(dates.size()),
+             from.toString("yyyy-MM-dd"),
+             to.toString("yyyy-MM-dd"),
+             QString::number(m_Concurrency)));
+
+    // Downloads left over from an interrupted run are done as well
+    const int num_resumed = wc -> GetQueueSize();
+    if (num_resumed > 0)
+    {
+        Output(tr("Resuming %1 date(s) from a previous run")
+            .arg(QString::number(num_resumed)));
+    }
+    m_BackfillTotal = num_resumed + dates.size();
+
+    wc -> SetMaxRequestsInFlight(m_Concurrency);
+    const int num_new = wc -> QueueDates(dates);
+    m_BackfillTotal -= dates.size() - num_new;
+
+    // Continues in Backfill_Finished()
+    CALL_OUT("");
+    return -1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Backfill progress: date done
+void CommandLineTool::Backfill_DataReceived(const QString & mcrDate)
+{
+    CALL_IN(QString("mcrDate=%1")
+        .arg(CALL_SHOW(mcrDate)));
+
+    m_BackfillDone++;
+    Output(tr("[%1/%2] %3 done")
+        .arg(QString::number(m_BackfillDone),
+             QString::number(m_BackfillTotal),
+             mcrDate.isEmpty() ? tr("(no observations)") : mcrDate));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Backfill progress: date failed
+void CommandLineTool::Backfill_DownloadFailed(const QString & mcrDate)
+{
+    CALL_IN(QString("mcrDate=%1")
+        .arg(CALL_SHOW(mcrDate)));
+
+    m_BackfillDone++;
+    m_BackfillFailed << mcrDate;
+    Output(tr("[%1/%2] %3 FAILED")
+        .arg(QString::number(m_BackfillDone),
+             QString::number(m_BackfillTotal),
+             mcrDate));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Backfill done
+void CommandLineTool::Backfill_Finished()
+{
+    CALL_IN("");
+
+    if (m_BackfillFailed.isEmpty())
+    {
+        Output(tr("Backfill complete."));
+        QCoreApplication::exit(0);
+    } else
+    {
+        Output(tr("Backfill complete; %1 date(s) failed: %2")
+            .arg(QString::number(m_BackfillFailed.size()),
+                 m_BackfillFailed.join(" ")));
+        QCoreApplication::exit(2);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SIGINT/SIGTERM received
+void CommandLineTool::TerminationRequested(int mSignal)
+{
+    CALL_IN(QString("mSignal=%1")
+        .arg(CALL_SHOW(mSignal)));
+
+    Output(tr("Interrupted; finishing requests in flight."));
+    WundergroundComms * wc = WundergroundComms::Instance();
+    wc -> Shutdown();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Engine has shut down after an interrupt
+void CommandLineTool::ShutdownComplete()
+{
+    CALL_IN("");
+
+    QCoreApplication::exit(130);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Completeness and duplicate scan
+int CommandLineTool::Command_Verify()
+{
+    CALL_IN("");
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Reads "wu_data" and its partitions directly
+    if (!WundergroundComms::Instance() -> CheckSqliteStorage(
+        tr("Verifying")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    const QString today = QDate::currentDate().toString("yyyy-MM-dd");
+    int num_days = 0;
+    int num_incomplete = 0;
+    int num_missing = 0;
+    int num_duplicates = 0;
+    QString last_station;
+    QDate last_date;
+
+    // Observations per station and day (partitions are in the same order)
+    WundergroundComms * wc = WundergroundComms::Instance();
+    for (const QString & partition : RangePartitions())
+    {
+        const QString table = wc -> GetPartitionTable(partition);
+        if (table.isEmpty())
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return 1;
+        }
+        QSqlQuery & query = DatabaseHelper::PreparedQuery(
+            "SELECT station_id, substr(date_time, 1, 10) AS day, "
+            "count(*), count(DISTINCT date_time) FROM " + table
+            + RangeCondition()
+            + " GROUP BY station_id, day ORDER BY station_id, day;");
+        BindRange(query);
+        if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error scanning \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+        while (query.next())
+        {
+            const QString station = query.value(0).toString();
+            const QString day = query.value(1).toString();
+            const int count = query.value(2).toInt();
+            const int distinct = query.value(3).toInt();
+            const QDate date = QDate::fromString(day, "yyyy-MM-dd");
+            num_days++;
+
+            // Days without any observations
+            if (station == last_station &&
+                last_date.isValid())
+            {
+                for (QDate missing = last_date.addDays(1);
+                     missing < date;
+                     missing = missing.addDays(1))
+                {
+                    Output(QString("%1 %2 missing")
+                        .arg(station,
+                             missing.toString("yyyy-MM-dd")));
+                    num_missing++;
+                }
+            }
+
+            // Incomplete days (first day of a station and today are
+            // expected to be incomplete)
+            if (distinct < WundergroundComms::OBSERVATIONS_PER_DAY &&
+                station == last_station &&
+                day != today)
+            {
+                Output(QString("%1 %2 incomplete (%3/%4)")
+                    .arg(station,
+                         day,
+                         QString::number(distinct),
+                         QString::number(
+                            WundergroundComms::OBSERVATIONS_PER_DAY)));
+                num_incomplete++;
+            }
+
+            // Duplicates
+            if (count > distinct)
+            {
+                Output(QString("%1 %2 %3 duplicate observation(s)")
+                    .arg(station,
+                         day,
+                         QString::number(count - distinct)));
+                num_duplicates += count - distinct;
+            }
+
+            last_station = station;
+            last_date = date;
+        }
+    }
+
+    Output(tr("Verified %1 day(s): %2 incomplete, %3 missing, "
+        "%4 duplicate observation(s).")
+        .arg(QString::number(num_days),
+             QString::number(num_incomplete),
+             QString::number(num_missing),
+             QString::number(num_duplicates)));
+
+    const bool is_clean = (num_incomplete == 0 &&
+        num_missing == 0 &&
+        num_duplicates == 0);
+
+    CALL_OUT("");
+    return is_clean ? 0 : 2;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Export observations
+int CommandLineTool::Command_Export()
+{
+    CALL_IN("");
+
+    // Check format
+    if (m_Format != "csv" &&
+        m_Format != "tsv" &&
+        m_Format != "jsonl")
+    {
+        const QString reason = tr("Unknown export format \"%1\".")
+            .arg(m_Format);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Reads "wu_data" and its partitions directly
+    if (!WundergroundComms::Instance() -> CheckSqliteStorage(
+        tr("Exporting")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Header
+    WundergroundComms * wc = WundergroundComms::Instance();
+    const QStringList columns = wc -> GetDatabaseColumns();
+    const QString separator = (m_Format == "tsv" ? "\t" : ",");
+    if (m_Format != "jsonl")
+    {
+        Output(columns.join(separator));
+    }
+
+    // Stream rows (partitions are in the same order)
+    for (const QString & partition : RangePartitions())
+    {
+        const QString table = wc -> GetPartitionTable(partition);
+        if (table.isEmpty())
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return 1;
+        }
+        QSqlQuery & query = DatabaseHelper::PreparedQuery(
+            QString("SELECT %1 FROM %2%3 "
+                "ORDER BY station_id, date_time;")
+                .arg(columns.join(", "),
+                     table,
+                     RangeCondition()));
+        BindRange(query);
+        if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error reading \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+        while (query.next())
+        {
+            if (m_Format == "jsonl")
+            {
+                QJsonObject line;
+                for (int col_index = 0;
+                     col_index < columns.size();
+                     col_index++)
+                {
+                    const QString & column = columns[col_index];
+                    if (column == "station_id" ||
+                        column == "timezone" ||
+                        column == "date_time")
+                    {
+                        line[column] = query.value(col_index).toString();
+                    } else
+                    {
+                        line[column] = query.value(col_index).toDouble();
+                    }
+                }
+                Output(QString::fromUtf8(
+                    QJsonDocument(line).toJson(QJsonDocument::Compact)));
+            } else
+            {
+                QStringList values;
+                for (int col_index = 0;
+                     col_index < columns.size();
+                     col_index++)
+                {
+                    const QString value = query.value(col_index).toString();
+                    values << (m_Format == "csv" ?
+                        StringHelper::EncodeToCSV(value) : value);
+                }
+                Output(values.join(separator));
+            }
+        }
+    }
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Database statistics
+int CommandLineTool::Command_Stats()
+{
+    CALL_IN("");
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Reads "wu_data" and its partitions directly
+    if (!WundergroundComms::Instance() -> CheckSqliteStorage(
+        tr("Statistics")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Database size
+    const qint64 file_size = QFileInfo(WU_DATABASE_FILE).size();
+    QSqlQuery query;
+    query.exec("PRAGMA page_count;");
+    const qint64 page_count = query.next() ? query.value(0).toLongLong() : 0;
+    query.exec("PRAGMA page_size;");
+    const qint64 page_size = query.next() ? query.value(0).toLongLong() : 0;
+    query.exec("PRAGMA freelist_count;");
+    const qint64 free_pages = query.next() ? query.value(0).toLongLong() : 0;
+    Output(tr("Database file:  %1").arg(WU_DATABASE_FILE));
+    Output(tr("File size:      %1 (%2 pages of %3 bytes, %4 free)")
+        .arg(StringHelper::ConvertFileSize(file_size),
+             QString::number(page_count),
+             QString::number(page_size),
+             QString::number(free_pages)));
+
+    // Partitions
+    WundergroundComms * wc = WundergroundComms::Instance();
+    if (wc -> IsPartitioned())
+    {
+        const QStringList partitions = wc -> GetPartitions(QString());
+        qint64 partition_size = 0;
+        int num_sealed = 0;
+        for (const QString & partition : partitions)
+        {
+            const QFileInfo info(wc -> GetPartitionFilename(partition));
+            partition_size += info.size();
+            num_sealed += (info.isWritable() ? 0 : 1);
+        }
+        Output(tr("Partitions:     %1 (%2 sealed), %3")
+            .arg(QString::number(partitions.size()),
+                 QString::number(num_sealed),
+                 StringHelper::ConvertFileSize(partition_size)));
+    }
+
+    // Archive
+    const QStringList archived_months = wc -> GetArchivedMonths(QString());
+    if (!archived_months.isEmpty())
+    {
+        qint64 archive_size = 0;
+        for (const QString & month : archived_months)
+        {
+            archive_size += QFileInfo(wc -> GetArchiveFilename(
+                month.section("|", 0, 0), month.section("|", 1))).size();
+        }
+        Output(tr("Archive:        %1 month(s), %2")
+            .arg(QString::number(archived_months.size()),
+                 StringHelper::ConvertFileSize(archive_size)));
+    }
+
+    // Row counts (per station, so partitions can be added up)
+    qint64 num_observations = 0;
+    QSet < QString > stations;
+    QString first;
+    QString last;
+    QMap < QString, int > coverage;
+    for (const QString & partition : RangePartitions())
+    {
+        const QString table = wc -> GetPartitionTable(partition);
+        if (table.isEmpty())
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return 1;
+        }
+        QSqlQuery & count_query = DatabaseHelper::PreparedQuery(
+            "SELECT station_id, count(*), min(date_time), max(date_time) "
+            "FROM " + table + RangeCondition() + " GROUP BY station_id;");
+        BindRange(count_query);
+        if (!DatabaseHelper::Exec(count_query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error counting \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+        while (count_query.next())
+        {
+            stations += count_query.value(0).toString();
+            num_observations += count_query.value(1).toLongLong();
+            const QString station_first = count_query.value(2).toString();
+            const QString station_last = count_query.value(3).toString();
+            first = (first.isEmpty() ?
+                station_first : qMin(first, station_first));
+            last = qMax(last, station_last);
+        }
+
+        // Per-day coverage
+        QSqlQuery & coverage_query = DatabaseHelper::PreparedQuery(
+            "SELECT substr(date_time, 1, 10) AS day, "
+            "count(DISTINCT date_time) FROM " + table
+            + RangeCondition()
+            + " GROUP BY day ORDER BY day;");
+        BindRange(coverage_query);
+        if (!DatabaseHelper::Exec(coverage_query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error scanning \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+        while (coverage_query.next())
+        {
+            coverage[coverage_query.value(0).toString()] +=
+                coverage_query.value(1).toInt();
+        }
+    }
+    Output(tr("Observations:   %1").arg(QString::number(num_observations)));
+    Output(tr("Stations:       %1").arg(QString::number(stations.size())));
+    Output(tr("First:          %1").arg(first));
+    Output(tr("Last:           %1").arg(last));
+
+    // Corrections WU made after the fact
+    QSqlQuery & revision_query = DatabaseHelper::PreparedQuery(
+        "SELECT count(*), count(DISTINCT date_time) "
+        "FROM wu_revisions"
+        + RangeCondition() + ";");
+    BindRange(revision_query);
+    if (!DatabaseHelper::Exec(revision_query, __FILE__, __LINE__) ||
+        !revision_query.next())
+    {
+        const QString reason = tr("SQL error counting \"wu_revisions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    Output(tr("Revisions:      %1 values in %2 observations")
+        .arg(revision_query.value(0).toString(),
+             revision_query.value(1).toString()));
+
+    // Per-day coverage
+    Output(tr("Coverage per day:"));
+    for (auto day_iterator = coverage.constBegin();
+         day_iterator != coverage.constEnd();
+         day_iterator++)
+    {
+        const int count = day_iterator.value();
+        const double percentage =
+            100. * count / WundergroundComms::OBSERVATIONS_PER_DAY;
+        Output(QString("  %1 %2 %3%")
+            .arg(day_iterator.key(),
+                 QString::number(count).rightJustified(4),
+                 QString::number(percentage, 'f', 1).rightJustified(5)));
+    }
+
+    // Prepared statement cache (this run)
+    Output(tr("Prepared:       %1 statement(s) (at most %2 per connection), "
+        "%3 hits, %4 misses, %5 dropped")
+        .arg(QString::number(DatabaseHelper::GetNumberOfPreparedQueries()),
+             QString::number(DatabaseHelper::GetMaxPreparedQueries()),
+             QString::number(DatabaseHelper::GetPreparedQueryHits()),
+             QString::number(DatabaseHelper::GetPreparedQueryMisses()),
+             QString::number(DatabaseHelper::GetPreparedQueryEvictions())));
+
+    // Time spent in SQL (this run, including reading by the engine)
+    Output(tr("SQL statements:"));
+    for (const QString & line :
+        DatabaseHelper::GetStatementStatisticsReport())
+    {
+        Output("  " + line);
+    }
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recompute rollups from observations
+int CommandLineTool::Command_RollupRebuild()
+{
+    CALL_IN("");
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    WundergroundComms * wc = WundergroundComms::Instance();
+    if (!wc -> RebuildRollups(m_Concurrency))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+    Output(tr("Rollups rebuilt in %1 ms using %2 thread(s).")
+        .arg(QString::number(timer.elapsed()),
+             QString::number(m_Concurrency)));
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Move observations into partitions
+int CommandLineTool::Command_Split()
+{
+    CALL_IN("");
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Copies one station and year at a time, then vacuums the main database
+    WundergroundComms * wc = WundergroundComms::Instance();
+    QElapsedTimer timer;
+    timer.start();
+    if (!wc -> SplitDatabase())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+    Output(tr("Split into %1 partition(s) in %2 ms.")
+        .arg(QString::number(wc -> GetPartitions(QString()).size()),
+             QString::number(timer.elapsed())));
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Export months that are over to the archive
+int CommandLineTool::Command_Archive()
+{
+    CALL_IN("");
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Months that have been archived before are skipped
+    WundergroundComms * wc = WundergroundComms::Instance();
+    const int num_before = wc -> GetArchivedMonths(QString()).size();
+    QElapsedTimer timer;
+    timer.start();
+    if (!wc -> ArchiveMonths())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+    const int num_after = wc -> GetArchivedMonths(QString()).size();
+    Output(tr("Archived %1 month(s) in %2 ms; %3 in total.")
+        .arg(QString::number(num_after - num_before),
+             QString::number(timer.elapsed()),
+             QString::number(num_after)));
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Insert benchmark
+int CommandLineTool::Command_BenchInsert()
+{
+    CALL_IN("");
+
+    // Number of rows
+    int num_rows = 10000;
+    if (!m_Parameters.isEmpty())
+    {
+        bool ok = false;
+        num_rows = m_Parameters.first().toInt(&ok);
+        if (!ok ||
+            num_rows < 1)
+        {
+            const QString reason = tr("Invalid number of rows \"%1\".")
+                .arg(m_Parameters.first());
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+    }
+
+    // Scratch database with the same columns as the real one
+    QTemporaryDir scratch_dir;
+    if (!scratch_dir.isValid())
+    {
+        const QString reason = tr("Could not create scratch directory.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    const QString connection_name = "CommandLineTool_bench";
+    int result = 0;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+            connection_name);
+        db.setDatabaseName(scratch_dir.filePath("bench.sql"));
+        db.open();
+        WundergroundComms * wc = WundergroundComms::Instance();
+        const QStringList columns = wc -> GetDatabaseColumns();
+        QSqlQuery setup_query(db);
+        setup_query.exec("PRAGMA journal_mode=WAL;");
+        setup_query.exec("PRAGMA synchronous=NORMAL;");
+        setup_query.exec(QString("CREATE TABLE wu_data (%1);")
+            .arg(columns.join(", ")));
+        if (DatabaseHelper::HasSQLError(setup_query, __FILE__, __LINE__))
+        {
+            result = 1;
+        }
+        const QString sql = QString("INSERT INTO wu_data (%1) VALUES (:%2);")
+            .arg(columns.join(", "),
+                 columns.join(", :"));
+        const QDateTime start_time(QDate(2025, 1, 1), QTime(0, 0));
+        auto insert_row = [&](QSqlQuery & mrQuery, const int mcRow)
+        {
+            for (const QString & column : columns)
+            {
+                mrQuery.bindValue(":" + column, 0.1 * (mcRow % 100));
+            }
+            mrQuery.bindValue(":station_id", "BENCH");
+            mrQuery.bindValue(":timezone", "UTC");
+            mrQuery.bindValue(":date_time", start_time.addSecs(300 * mcRow)
+                .toString("yyyy-MM-dd hh:mm:ss"));
+            mrQuery.exec();
+            return !DatabaseHelper::HasSQLError(mrQuery, __FILE__, __LINE__);
+        };
+
+        // Round 0: prepare every statement; round 1: prepared statement cache
+        qint64 elapsed[2] = { 0, 0 };
+        const qint64 hits_before = DatabaseHelper::GetPreparedQueryHits();
+        for (int round = 0; round < 2 && result == 0; round++)
+        {
+            setup_query.exec("DELETE FROM wu_data;");
+            QElapsedTimer timer;
+            timer.start();
+            db.transaction();
+            for (int row = 0; row < num_rows && result == 0; row++)
+            {
+                if (round == 0)
+                {
+                    QSqlQuery query(db);
+                    query.prepare(sql);
+                    result = insert_row(query, row) ? 0 : 1;
+                } else
+                {
+                    QSqlQuery & query = DatabaseHelper::PreparedQuery(sql, db);
+                    result = insert_row(query, row) ? 0 : 1;
+                }
+            }
+            db.commit();
+            elapsed[round] = qMax(qint64(1), timer.elapsed());
+        }
+        const qint64 hits = DatabaseHelper::GetPreparedQueryHits() -
+            hits_before;
+        DatabaseHelper::ClearPreparedQueries(connection_name);
+
+        if (result == 0)
+        {
+            Output(tr("Inserted %1 rows per round into a scratch database.")
+                .arg(QString::number(num_rows)));
+            Output(tr("Prepared per row:    %1 ms (%2 rows/s)")
+                .arg(QString::number(elapsed[0]),
+                     QString::number(1000 * num_rows / elapsed[0])));
+            Output(tr("Statement cache:     %1 ms (%2 rows/s, %3 hits)")
+                .arg(QString::number(elapsed[1]),
+                     QString::number(1000 * num_rows / elapsed[1]),
+                     QString::number(hits)));
+            Output(tr("Speedup:             %1x")
+                .arg(QString::number(double(elapsed[0]) / elapsed[1],
+                    'f', 2)));
+        }
+    }
+    QSqlDatabase::removeDatabase(connection_name);
+
+    CALL_OUT("");
+    return result;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Archive benchmark
+int CommandLineTool::Command_BenchArchive()
+{
+    CALL_IN("");
+
+    if (!OpenEngine(false))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return 1;
+    }
+
+    WundergroundComms * wc = WundergroundComms::Instance();
+    const QStringList months = wc -> GetArchivedMonths(QString());
+    if (months.isEmpty())
+    {
+        const QString reason =
+            tr("No archived months; run \"archive\" first.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    const QStringList columns = wc -> GetMetricColumns();
+
+    // Full scans: SQLite...
+    qint64 num_rows = 0;
+    qint64 sql_elapsed = 0;
+    qint64 archive_elapsed = 0;
+    qint64 span_elapsed = 0;
+    qint64 summary_elapsed = 0;
+    qint64 archive_size = 0;
+    QList < QVector < qint64 > > all_times;
+    QList < QList < QVector < double > > > all_values;
+    for (const QString & month : months)
+    {
+        const QString station_id = month.section("|", 0, 0);
+        const QString month_name = month.section("|", 1);
+        QVector < qint64 > times;
+        QList < QVector < double > > values;
+        QElapsedTimer timer;
+        timer.start();
+        if (!wc -> ReadMonth(station_id, month_name, times, values))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return 1;
+        }
+        sql_elapsed += timer.nsecsElapsed();
+        num_rows += times.size();
+        all_times << times;
+        all_values << values;
+
+        // ...and the archive (opening included)
+        const QString filename =
+            wc -> GetArchiveFilename(station_id, month_name);
+        archive_size += QFileInfo(filename).size();
+        timer.restart();
+        ColumnArchive archive;
+        qint64 num_scanned = 0;
+        if (!archive.Open(filename) ||
+            !archive.Scan(std::numeric_limits < qint64 >::min(),
+                std::numeric_limits < qint64 >::max(), columns,
+                [&num_scanned](const qint64, const QVector < double > &)
+                {
+                    num_scanned++;
+                    return true;
+                }))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return 1;
+        }
+        archive_elapsed += timer.nsecsElapsed();
+        if (num_scanned != times.size())
+        {
+            const QString reason = tr("Archive of %1 has %2 rows, the "
+                "database %3; run \"archive\" again.")
+                .arg(month,
+                     QString::number(num_scanned),
+                     QString::number(times.size()));
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+
+        // Whole blocks as spans (no per-row copies)
+        timer.restart();
+        double span_sum = 0;
+        archive.ScanBlocks(std::numeric_limits < qint64 >::min(),
+            std::numeric_limits < qint64 >::max(), columns,
+            [&span_sum](QSpan < const qint64 >,
+                const QList < QSpan < const double > > & mcrValues)
+            {
+                for (const QSpan < const double > & column_values : mcrValues)
+                {
+                    for (const double value : column_values)
+                    {
+                        span_sum += (qIsNaN(value) ? 0 : value);
+                    }
+                }
+                return true;
+            });
+        span_elapsed += timer.nsecsElapsed();
+
+        // Aggregates from block statistics
+        timer.restart();
+        for (const QString & column : columns)
+        {
+            int count = 0;
+            double minimum = 0;
+            double maximum = 0;
+            double sum = 0;
+            archive.Summarize(std::numeric_limits < qint64 >::min(),
+                std::numeric_limits < qint64 >::max(), column, count,
+                minimum, maximum, sum);
+        }
+        summary_elapsed += timer.nsecsElapsed();
+    }
+
+    // Size of the same rows in a scratch SQLite database
+    QTemporaryDir scratch_dir;
+    if (!scratch_dir.isValid())
+    {
+        const QString reason = tr("Could not create scratch directory.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    const QString connection_name = "CommandLineTool_bench";
+    const QString scratch_filename = scratch_dir.filePath("bench.sql");
+    int result = 0;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+            connection_name);
+        db.setDatabaseName(scratch_filename);
+        db.open();
+        QSqlQuery setup_query(db);
+        if (!DatabaseHelper::Exec(setup_query,
+            QString("CREATE TABLE wu_data (station_id, date_time, %1, "
+                "PRIMARY KEY (station_id, date_time));")
+                .arg(columns.join(", ")),
+            __FILE__, __LINE__, db))
+        {
+            result = 1;
+        }
+        const QString sql = QString("INSERT INTO wu_data "
+            "VALUES (:station_id, :date_time, :%1);")
+            .arg(columns.join(", :"));
+        db.transaction();
+        for (int month_index = 0;
+             month_index < months.size() && result == 0;
+             month_index++)
+        {
+            const QVector < qint64 > & times = all_times[month_index];
+            const QList < QVector < double > > & values =
+                all_values[month_index];
+            for (int row = 0; row < times.size() && result == 0; row++)
+            {
+                QSqlQuery & query = DatabaseHelper::PreparedQuery(sql, db);
+                query.bindValue(":station_id",
+                    months[month_index].section("|", 0, 0));
+                query.bindValue(":date_time", QString("%1 %2")
+                    .arg(ColumnArchive::DateFromSeconds(times[row])
+                            .toString("yyyy-MM-dd"),
+                         ColumnArchive::TimeFromSeconds(times[row])
+                            .toString("hh:mm:ss")));
+                for (int column = 0; column < columns.size(); column++)
+                {
+                    const double value = values[column][row];
+                    query.bindValue(":" + columns[column], qIsNaN(value) ?
+                        QVariant() : QVariant(value));
+                }
+                result = DatabaseHelper::Exec(query, __FILE__, __LINE__, db) ?
+                    0 : 1;
+            }
+        }
+        db.commit();
+        DatabaseHelper::ClearPreparedQueries(connection_name);
+        if (result == 0 &&
+            !DatabaseHelper::Exec(setup_query, "VACUUM;", __FILE__, __LINE__,
+                db))
+        {
+            result = 1;
+        }
+    }
+    QSqlDatabase::removeDatabase(connection_name);
+    if (result != 0)
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return result;
+    }
+    const qint64 sql_size = QFileInfo(scratch_filename).size();
+
+    // Results (times in ms)
+    sql_elapsed = qMax(qint64(1), sql_elapsed / 1000000);
+    archive_elapsed = qMax(qint64(1), archive_elapsed / 1000000);
+    span_elapsed = qMax(qint64(1), span_elapsed / 1000000);
+    summary_elapsed = qMax(qint64(1), summary_elapsed / 1000000);
+    Output(tr("%1 archived month(s), %2 rows, %3 columns.")
+        .arg(QString::number(months.size()),
+             QString::number(num_rows),
+             QString::number(columns.size())));
+    Output(tr("SQLite scan:         %1 ms (%2 rows/s)")
+        .arg(QString::number(sql_elapsed),
+             QString::number(1000 * num_rows / sql_elapsed)));
+    Output(tr("Archive scan:        %1 ms (%2 rows/s, %3x)")
+        .arg(QString::number(archive_elapsed),
+             QString::number(1000 * num_rows / archive_elapsed),
+             QString::number(double(sql_elapsed) / archive_elapsed, 'f', 2)));
+    Output(tr("Archive block scan:  %1 ms (%2 rows/s, %3x; spans, summed)")
+        .arg(QString::number(span_elapsed),
+             QString::number(1000 * num_rows / span_elapsed),
+             QString::number(double(sql_elapsed) / span_elapsed, 'f', 2)));
+    Output(tr("Archive aggregates:  %1 ms (count/min/max/sum of every "
+        "column)")
+        .arg(QString::number(summary_elapsed)));
+    Output(tr("SQLite size:         %1")
+        .arg(StringHelper::ConvertFileSize(sql_size)));
+    Output(tr("Archive size:        %1 (%2x smaller)")
+        .arg(StringHelper::ConvertFileSize(archive_size),
+             QString::number(double(sql_size) / qMax(qint64(1), archive_size),
+                 'f', 2)));
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Storage backend benchmark
+int CommandLineTool::Command_BenchBackend()
+{
+    CALL_IN("");
+
+    // Number of rows
+    int num_rows = 10000;
+    if (!m_Parameters.isEmpty())
+    {
+        bool ok = false;
+        num_rows = m_Parameters.first().toInt(&ok);
+        if (!ok ||
+            num_rows < 1)
+        {
+            const QString reason = tr("Invalid number of rows \"%1\".")
+                .arg(m_Parameters.first());
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+    }
+
+    // Same observations for every backend: one station, five-minute
+    // cadence, values that change slowly
+    WundergroundComms * wc = WundergroundComms::Instance();
+    const QStringList columns = wc -> GetDatabaseColumns();
+    const QStringList metrics = wc -> GetMetricColumns();
+    const QTimeZone time_zone("UTC");
+    const QDateTime start_time(QDate(2025, 1, 1), QTime(0, 0), time_zone);
+    QList < QHash < QString, QString > > observations;
+    for (int row = 0; row < num_rows; row++)
+    {
+        QHash < QString, QString > observation;
+        for (int metric = 0; metric < metrics.size(); metric++)
+        {
+            observation[metrics[metric]] = QString::number(
+                10 + metric + 5 * qSin((row + 7 * metric) / 50.0), 'f', 1);
+        }
+        observation["station_id"] = "BENCH";
+        observation["timezone"] = "UTC";
+        observation["date_time"] =
+            start_time.addSecs(300 * row).toString("yyyy-MM-dd hh:mm:ss");
+        observations << observation;
+    }
+    const QDateTime end_time = start_time.addSecs(300 * num_rows);
+    const int num_days = int(start_time.date().daysTo(end_time.date())) + 1;
+
+    // Scratch storage
+    QTemporaryDir scratch_dir;
+    if (!scratch_dir.isValid())
+    {
+        const QString reason = tr("Could not create scratch directory.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    const QString connection_name = "CommandLineTool_bench";
+    int result = 0;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+            connection_name);
+        db.setDatabaseName(scratch_dir.filePath("bench.sql"));
+        db.open();
+        QSqlQuery setup_query(db);
+        setup_query.exec("PRAGMA journal_mode=WAL;");
+        setup_query.exec("PRAGMA synchronous=NORMAL;");
+        QList < StorageBackend * > backends;
+        backends << new SqliteBackend(db, "wu_data", columns)
+            << new MemoryBackend(columns)
+            << new ArchiveBackend(scratch_dir.filePath("archive"), columns);
+
+        Output(tr("%1 rows (%2 days), appended one day per batch.")
+            .arg(QString::number(num_rows),
+                 QString::number(num_days)));
+        Output(tr("Backend    append ms   range ms  summary ms"));
+        for (StorageBackend * backend : backends)
+        {
+            // Append, one day at a time (as downloads arrive)
+            QElapsedTimer timer;
+            timer.start();
+            bool success = backend -> Migrate();
+            for (int first = 0;
+                 success && first < num_rows;
+                 first += WundergroundComms::OBSERVATIONS_PER_DAY)
+            {
+                success = backend -> AppendBatch(observations.mid(first,
+                    WundergroundComms::OBSERVATIONS_PER_DAY));
+            }
+            const qint64 append_elapsed = timer.elapsed();
+
+            // Everything in one range query
+            timer.restart();
+            QueryResult range_result;
+            success = success &&
+                backend -> QueryRange("BENCH", start_time, end_time,
+                    metrics, time_zone, 0, nullptr, range_result) &&
+                range_result.Size() == num_rows;
+            const qint64 range_elapsed = timer.elapsed();
+
+            // Summary of every day
+            timer.restart();
+            for (int day = 0; success && day < num_days; day++)
+            {
+                QueryResult summary_result;
+                success = backend -> DaySummary("BENCH",
+                    start_time.date().addDays(day), metrics, time_zone,
+                    summary_result);
+            }
+            const qint64 summary_elapsed = timer.elapsed();
+
+            if (!success)
+            {
+                MessageLogger::Error(CALL_METHOD,
+                    tr("%1 backend failed.").arg(backend -> GetName()));
+                result = 1;
+                break;
+            }
+            Output(QString("%1 %2 %3 %4")
+                .arg(backend -> GetName(), -8)
+                .arg(append_elapsed, 11)
+                .arg(range_elapsed, 10)
+                .arg(summary_elapsed, 11));
+        }
+        qDeleteAll(backends);
+        DatabaseHelper::ClearPreparedQueries(connection_name);
+    }
+    QSqlDatabase::removeDatabase(connection_name);
+
+    CALL_OUT("");
+    return result;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Tracer benchmark
+int CommandLineTool::Command_BenchTracer()
+{
+    CALL_IN("");
+
+    // Number of calls
+    int num_calls = 1000000;
+    if (!m_Parameters.isEmpty())
+    {
+        bool ok = false;
+        num_calls = m_Parameters.first().toInt(&ok);
+        if (!ok ||
+            num_calls < 1)
+        {
+            const QString reason = tr("Invalid number of calls \"%1\".")
+                .arg(m_Parameters.first());
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+    }
+
+    // Same function without and with CALL_IN/CALL_OUT
+    volatile int sink = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int call = 0; call < num_calls; call++)
+    {
+        sink = BenchTracer_Untraced(call);
+    }
+    const qint64 untraced_ns = timer.nsecsElapsed();
+    timer.restart();
+    for (int call = 0; call < num_calls; call++)
+    {
+        sink = BenchTracer_Traced(call);
+    }
+    const qint64 traced_ns = timer.nsecsElapsed();
+
+    // Estimate of what entering and exiting a method cost before method
+    // IDs. The former CallTracer is gone, so this only repeats its main
+    // steps inline (class name from the filename, "Class::method" on both
+    // ends, formatted time stamps and three string lists for the stack);
+    // the calls through the macros and CallTracer::Instance() are missing
+    const QString function_name = "BenchTracer_Traced";
+    QHash < QString, QHash < QString, int > > call_count;
+    QHash < QString, QHash < QString, int > > originator_count;
+    QList < QString > stack_time;
+    QList < QString > stack_method;
+    QList < QString > stack_text;
+    timer.restart();
+    for (int call = 0; call < num_calls; call++)
+    {
+        const QString parameters = QString("mcValue=%1")
+            .arg(CALL_SHOW(call));
+        const QString class_name = CallTracer::ClassName(__FILE__);
+        const QString called_method = QString("%1::%2")
+            .arg(class_name,
+                 function_name);
+        stack_time << QDateTime::currentDateTime()
+            .toString("yyyy-MM-dd hh:mm:ss.zzz");
+        stack_method << called_method;
+        stack_text << QString("(%1)").arg(parameters);
+        call_count[class_name][function_name]++;
+        originator_count[called_method][QString()]++;
+        sink = call + 1;
+        const QString exit_method = QString("%1::%2")
+            .arg(CallTracer::ClassName(__FILE__),
+                 function_name);
+        const QString exit_time = QDateTime::currentDateTime()
+            .toString("yyyy-MM-dd hh:mm:ss.zzz");
+        if (stack_method.last() == exit_method &&
+            !exit_time.isEmpty())
+        {
+            stack_time.takeLast();
+            stack_method.takeLast();
+            stack_text.takeLast();
+        }
+    }
+    const qint64 former_ns = timer.nsecsElapsed();
+
+    // Parse_SingleObservation() shows the entire observation in CALL_IN();
+    // it is only formatted if it's needed, where it used to be formatted
+    // for every observation
+    const QStringList metric_keys = { "tempHigh", "tempLow", "tempAvg",
+        "windspeedHigh", "windspeedLow", "windspeedAvg", "dewptHigh",
+        "dewptLow", "dewptAvg", "pressureMax", "pressureMin", "precipRate",
+        "precipTotal" };
+    QJsonObject metric;
+    for (const QString & key : metric_keys)
+    {
+        metric[key] = 12.3;
+    }
+    QJsonObject observation;
+    observation["stationID"] = "BENCH";
+    observation["tz"] = "Europe/Berlin";
+    observation["obsTimeUtc"] = "2025-05-01T16:39:49Z";
+    observation["obsTimeLocal"] = "2025-05-01 18:39:49";
+    observation["epoch"] = 1746117589;
+    observation["humidityAvg"] = 24.0;
+    observation["winddirAvg"] = 112;
+    observation["metric"] = metric;
+    const int num_observations = qMax(1, num_calls / 10);
+    timer.restart();
+    for (int index = 0; index < num_observations; index++)
+    {
+        sink = BenchTracer_Observation(observation);
+    }
+    const qint64 lazy_ns = qMax(qint64(1), timer.nsecsElapsed());
+    timer.restart();
+    for (int index = 0; index < num_observations; index++)
+    {
+        const QString parameters = QString("mcrObservation=%1")
+            .arg(CALL_SHOW_FULL(observation));
+        sink = BenchTracer_Observation(observation) + parameters.size();
+    }
+    const qint64 eager_ns = qMax(qint64(1), timer.nsecsElapsed());
+    Q_UNUSED(sink)
+
+    Output(tr("Calls:               %1").arg(QString::number(num_calls)));
+    Output(tr("Untraced:            %1 ns per call")
+        .arg(QString::number(double(untraced_ns) / num_calls, 'f', 1)));
+    Output(tr("CALL_IN/CALL_OUT:    %1 ns per call")
+        .arg(QString::number(double(traced_ns) / num_calls, 'f', 1)));
+    Output(tr("Before method IDs:   ~%1 ns per call (estimate: main "
+        "steps of the former CallTracer, re-created inline)")
+        .arg(QString::number(double(former_ns) / num_calls, 'f', 1)));
+    Output(tr("Observations:        %1 per second (%2 per second when "
+        "formatted right away)")
+        .arg(QString::number(qint64(1e9 * num_observations / lazy_ns)),
+             QString::number(qint64(1e9 * num_observations / eager_ns))));
+#if DEPLOY
+    Output(tr("Note: DEPLOY build, CALL_IN/CALL_OUT are compiled out."));
+#endif
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Tracer benchmark: function without tracing
+int CommandLineTool::BenchTracer_Untraced(const int mcValue)
+{
+    return mcValue + 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Tracer benchmark: same function with tracing
+int CommandLineTool::BenchTracer_Traced(const int mcValue)
+{
+    CALL_IN(QString("mcValue=%1")
+        .arg(CALL_SHOW(mcValue)));
+
+    CALL_OUT("");
+    return mcValue + 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Tracer benchmark: observation shown in full
+int CommandLineTool::BenchTracer_Observation(
+    const QJsonObject & mcrObservation)
+{
+    CALL_IN(QString("mcrObservation=%1")
+        .arg(CALL_SHOW_FULL(mcrObservation)));
+
+    CALL_OUT("");
+    return int(mcrObservation.size());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Show a flight record
+int CommandLineTool::Command_FlightDecode()
+{
+    CALL_IN("");
+
+    // flight-decode <file>
+    if (m_Parameters.size() != 1)
+    {
+        const QString reason = tr("flight-decode needs a file.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+
+    QString trace;
+    if (!CallTracer::DecodeFlightRecord(m_Parameters.first(), trace))
+    {
+        const QString reason = tr("\"%1\" could not be read or is not a "
+            "flight record of this build.").arg(m_Parameters.first());
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    m_Output << trace;
+    m_Output.flush();
+
+    CALL_OUT("");
+    return 0;
+}
@@ -0,0 +1,145 @@
+// CommandLineTool.h
+// Class definition
+
+#ifndef COMMANDLINETOOL_H
+#define COMMANDLINETOOL_H
+
+// Qt includes
+#include <QDate>
+#include <QFile>
+#include <QJsonObject>
+#include <QObject>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+
+
+// Class definition
+class CommandLineTool
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Constructor
+    CommandLineTool();
+
+public:
+    // Destructor
+    virtual ~CommandLineTool();
+
+    // Instanciator
+    static CommandLineTool * Instance();
+
+private:
+    // Instance
+    static CommandLineTool * m_Instance;
+
+
+
+    // =========================================================== Command line
+public:
+    // Check if the arguments contain a command (as opposed to daemon mode)
+    bool ParseArguments(const QStringList & mcrArguments);
+
+public slots:
+    // Execute command and leave the event loop with its exit code
+    void Run();
+
+private:
+    // Usage information
+    QString Usage() const;
+
+    // Open the ingest engine's database
+    bool OpenEngine(const bool mcReadData);
+
+    // Date from YYYYMMDD or YYYY-MM-DD
+    static QDate ParseDate(const QString & mcrDate);
+
+    // Write a line to the output (flushed right away)
+    void Output(const QString & mcrLine);
+
+    // SQL condition for --from/--to (empty if no range was given)
+    QString RangeCondition() const;
+    void BindRange(QSqlQuery & mrQuery) const;
+
+    // Partitions for --from/--to ("" for the main database first)
+    QStringList RangePartitions() const;
+
+    // Command and its options
+    QString m_Command;
+    QStringList m_Parameters;
+    int m_Concurrency;
+    QDate m_From;
+    QDate m_To;
+    QString m_Format;
+    QString m_OutputFilename;
+    QString m_TraceFilename;
+
+    // Where output goes
+    QFile m_OutputFile;
+    QTextStream m_Output;
+
+
+
+    // =============================================================== Commands
+private:
+    // Download a range of dates; exit code is sent when done
+    int Command_Backfill();
+    QStringList m_BackfillFailed;
+    int m_BackfillDone;
+    int m_BackfillTotal;
+
+    // Completeness and duplicate scan
+    int Command_Verify();
+
+    // Export observations
+    int Command_Export();
+
+    // Database statistics
+    int Command_Stats();
+
+    // Recompute rollups from observations
+    int Command_RollupRebuild();
+
+    // Move observations into partitions
+    int Command_Split();
+
+    // Export months that are over to the archive
+    int Command_Archive();
+
+    // Insert benchmark
+    int Command_BenchInsert();
+
+    // Archive scan speed and size compared to SQLite
+    int Command_BenchArchive();
+
+    // Storage backends compared
+    int Command_BenchBackend();
+
+    // CALL_IN/CALL_OUT overhead per call
+    int Command_BenchTracer();
+    static int BenchTracer_Untraced(const int mcValue);
+    static int BenchTracer_Traced(const int mcValue);
+    static int BenchTracer_Observation(const QJsonObject & mcrObservation);
+
+    // Show a flight record
+    int Command_FlightDecode();
+
+private slots:
+    // Backfill progress
+    void Backfill_DataReceived(const QString & mcrDate);
+    void Backfill_DownloadFailed(const QString & mcrDate);
+    void Backfill_Finished();
+
+    // SIGINT/SIGTERM received during a command
+    void TerminationRequested(int mSignal);
+    void ShutdownComplete();
+};
+
+#endif
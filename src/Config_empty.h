@@ -5,6 +5,46 @@
 #define CHECK_START_TIME "06:00"
 #define CHECK_END_TIME "22:00"
 
+// Maximum time to wait for downloads in flight when shutting down (ms)
+#define SHUTDOWN_TIMEOUT (10*1000)
+
+// Failed downloads are retried on start until they failed this many times
+#define JOB_MAX_ATTEMPTS 3
+
+// Size of the query result cache (number of values)
+#define QUERY_CACHE_SIZE 1000000
+
+// Apply corrections WU makes to observations we already have (and log them)
+#define WU_TRACK_REVISIONS true
+
+// One database file per station and year; past years are sealed (read-only)
+// this many days after they are over
+#define WU_PARTITIONED false
+#define PARTITION_SEAL_DAYS 31
+
+// Where observations are kept: "sqlite" (the database), "memory" (lost when
+// the program ends) or "archive" (column files next to the database); see
+// --backend
+#define STORAGE_BACKEND "sqlite"
+
+// Statements slower than this (ms) are logged with their query plan
+#define SQL_SLOW_QUERY_MS 100
+#define SQL_SLOW_QUERY_LOG (WU_DATABASE_DIR + "slow_queries.log")
+
+// Prepared statements kept per database connection (least recently used
+// ones are dropped)
+#define SQL_PREPARED_QUERIES 100
+
+// The daemon keeps its most recent calls and log lines in memory and writes
+// them to this file when it crashes or is terminated (read it with
+// "WundergroundDaemon flight-decode file"); empty to turn off
+#define FLIGHT_RECORDER_FILE (WU_DATABASE_DIR + "flight_recorder.bin")
+
+// Classes and methods that are traced, e.g. "*=off,WundergroundComms=on";
+// WU_TRACE_SCOPES and --trace-scopes add to this (see
+// CallTracer::SetScopes())
+#define CALL_TRACER_SCOPES ""
+
 // But configuration
 #define WU_PWS_NAME "your pws name"
 #define WU_TOKEN "your wu api token"
@@ -0,0 +1,231 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// Daemon.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Config.h"
+#include "Daemon.h"
+#include "DatabaseHelper.h"
+#include "MessageLogger.h"
+#include "SignalHandler.h"
+#include "StringHelper.h"
+#include "WundergroundComms.h"
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDateTime>
+
+// Flight record on crashes and termination (empty: off)
+#ifndef FLIGHT_RECORDER_FILE
+#define FLIGHT_RECORDER_FILE QString()
+#endif
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+Daemon::Daemon()
+{
+    CALL_IN("");
+
+    // Graceful shutdown on SIGINT/SIGTERM
+    SignalHandler * signal_handler = SignalHandler::Instance();
+    connect (signal_handler, SIGNAL(TerminationRequested(int)),
+        this, SLOT(TerminationRequested(int)));
+
+    // Ingest engine
+    WundergroundComms * wc = WundergroundComms::Instance();
+    connect (wc, SIGNAL(StatusUpdate(const QString)),
+        this, SLOT(UpdateStatus(const QString)));
+    connect (wc, SIGNAL(ShutdownComplete()),
+        this, SLOT(ShutdownComplete()));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+Daemon::~Daemon()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instanciator
+Daemon * Daemon::Instance()
+{
+    CALL_IN("");
+
+    if (!m_Instance)
+    {
+        m_Instance = new Daemon();
+    }
+
+    CALL_OUT("");
+    return m_Instance;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instance
+Daemon * Daemon::m_Instance = nullptr;
+
+
+
+// ===================================================================== Ingest
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Configure and start the ingest engine
+bool Daemon::Start()
+{
+    CALL_IN("");
+
+    // Keep recent calls and log lines for a flight record
+    const QString flight_recorder_file = FLIGHT_RECORDER_FILE;
+    if (!flight_recorder_file.isEmpty() &&
+        !CallTracer::StartFlightRecorder(flight_recorder_file))
+    {
+        MessageLogger::Error(CALL_METHOD,
+            tr("Could not start flight recorder \"%1\".")
+                .arg(flight_recorder_file));
+    }
+
+    // Same setup as the GUI does it
+    WundergroundComms * wc = WundergroundComms::Instance();
+    if (!wc -> SetPWSName(WU_PWS_NAME) ||
+        !wc -> SetToken(WU_TOKEN))
+    {
+        const QString reason = tr("Invalid configuration.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    wc -> SetDatabaseFile(WU_DATABASE_FILE);
+    if (!wc -> OpenDatabase())
+    {
+        const QString reason = tr("Could not open database.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Start bot
+    wc -> StartUpdates();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Status updates from the ingest engine
+void Daemon::UpdateStatus(const QString & mcrStatus)
+{
+    CALL_IN(QString("mcrStatus=%1")
+        .arg(CALL_SHOW(mcrStatus)));
+
+    // Status messages are meant for the GUI log; make them plain text
+    QString status = mcrStatus;
+    status.replace("<br/>", "\n    ");
+    status = StringHelper::StripHTMLTags(status);
+
+    const QString now =
+        QDateTime::currentDateTime().toString("dd MMM yyyy hh:mm:ss");
+    MessageLogger::Print(QString("[%1] %2")
+        .arg(now,
+             status));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SIGINT/SIGTERM received
+void Daemon::TerminationRequested(int mSignal)
+{
+    CALL_IN(QString("mSignal=%1")
+        .arg(CALL_SHOW(mSignal)));
+
+    const QString message =
+        tr("Received signal %1; shutting down (repeat to force).")
+            .arg(QString::number(mSignal));
+    UpdateStatus(message);
+
+    WundergroundComms * wc = WundergroundComms::Instance();
+    wc -> Shutdown();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Ingest engine has shut down
+void Daemon::ShutdownComplete()
+{
+    CALL_IN("");
+
+    // Where the database time went while we were running
+    MessageLogger::Print(tr("SQL statements:"));
+    for (const QString & line :
+        DatabaseHelper::GetStatementStatisticsReport())
+    {
+        MessageLogger::Print("  " + line);
+    }
+
+#if !DEPLOY
+    // Where the rest of the time went
+    MessageLogger::Print(tr("Methods:"));
+    for (const QString & line : CallTracer::GetProfileReport())
+    {
+        MessageLogger::Print("  " + line);
+    }
+#ifdef TRACE_ALLOCATIONS
+    MessageLogger::Print(tr("Allocations:"));
+    for (const QString & line : CallTracer::GetAllocationReport())
+    {
+        MessageLogger::Print("  " + line);
+    }
+#endif
+#endif
+
+    QCoreApplication::quit();
+
+    CALL_OUT("");
+}
@@ -0,0 +1,55 @@
+// Daemon.h
+// Class definition
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+// Qt includes
+#include <QObject>
+#include <QString>
+
+
+
+// Class definition
+class Daemon
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Constructor
+    Daemon();
+
+public:
+    // Destructor
+    virtual ~Daemon();
+
+    // Instanciator
+    static Daemon * Instance();
+
+private:
+    // Instance
+    static Daemon * m_Instance;
+
+
+
+    // ================================================================= Ingest
+public:
+    // Configure and start the ingest engine
+    bool Start();
+
+private slots:
+    // Status updates from the ingest engine
+    void UpdateStatus(const QString & mcrStatus);
+
+    // SIGINT/SIGTERM received
+    void TerminationRequested(int mSignal);
+
+    // Ingest engine has shut down
+    void ShutdownComplete();
+};
+
+#endif
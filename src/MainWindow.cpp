@@ -23,9 +23,12 @@
 #include "CallTracer.h"
 #include "Config.h"
 #include "MainWindow.h"
+#include "MessageLogger.h"
+#include "SignalHandler.h"
 #include "WundergroundComms.h"
 
 // Qt includes
+#include <QApplication>
 #include <QDialog>
 #include <QDir>
 #include <QHBoxLayout>
@@ -36,6 +39,11 @@
 #include <QThread>
 #include <QTimer>
 
+// Classes and methods that are traced (see CallTracer::SetScopes())
+#ifndef CALL_TRACER_SCOPES
+#define CALL_TRACER_SCOPES QString()
+#endif
+
 
 
 // ================================================================== Lifecycle
@@ -48,6 +56,19 @@ MainWindow::MainWindow()
 {
     CALL_IN("");
 
+    // Tracing scopes: configuration, then environment (later rules override
+    // earlier ones)
+    const QString scopes = QStringList {
+        QString(CALL_TRACER_SCOPES),
+        qEnvironmentVariable("WU_TRACE_SCOPES") }.join(",");
+    if (!CallTracer::SetScopes(scopes))
+    {
+        MessageLogger::Error(CALL_METHOD,
+            tr("Invalid tracing scopes \"%1\".").arg(scopes));
+    }
+
+    m_IsShutdownComplete = false;
+
     // Initialize Widgets
     InitWidgets();
 
@@ -57,6 +78,13 @@ MainWindow::MainWindow()
         this, SLOT(DataReceived(const QString)));
     connect (wc, SIGNAL(StatusUpdate(const QString)),
         this, SLOT(UpdateStatus(const QString)));
+    connect (wc, SIGNAL(ShutdownComplete()),
+        this, SLOT(ShutdownComplete()));
+
+    // Graceful shutdown on SIGINT/SIGTERM
+    SignalHandler * signal_handler = SignalHandler::Instance();
+    connect (signal_handler, SIGNAL(TerminationRequested(int)),
+        this, SLOT(TerminationRequested(int)));
 
     // Open database
     wc -> SetPWSName(WU_PWS_NAME);
@@ -257,3 +285,66 @@ void MainWindow::DataReceived(const QString & mcrDate)
 
     CALL_OUT("");
 }
+
+
+
+// =================================================================== Shutdown
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Window closed: shut down gracefully first
+void MainWindow::closeEvent(QCloseEvent * mpEvent)
+{
+    CALL_IN(QString("mpEvent=%1")
+        .arg(CALL_SHOW(mpEvent)));
+
+    // Done shutting down; window can go
+    if (m_IsShutdownComplete)
+    {
+        mpEvent -> accept();
+        CALL_OUT("");
+        return;
+    }
+
+    // Finish downloads and writes first; ShutdownComplete() closes us
+    mpEvent -> ignore();
+    WundergroundComms * wc = WundergroundComms::Instance();
+    if (!wc -> IsShuttingDown())
+    {
+        wc -> Shutdown();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SIGINT/SIGTERM received
+void MainWindow::TerminationRequested(int mSignal)
+{
+    CALL_IN(QString("mSignal=%1")
+        .arg(CALL_SHOW(mSignal)));
+
+    UpdateStatus(tr("Received signal %1; shutting down (repeat to force).")
+        .arg(QString::number(mSignal)));
+    close();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Downloads and database are done
+void MainWindow::ShutdownComplete()
+{
+    CALL_IN("");
+
+    m_IsShutdownComplete = true;
+    close();
+    QApplication::quit();
+
+    CALL_OUT("");
+}
@@ -5,6 +5,7 @@
 #define MAINWINDOW_H
 
 // Qt includes
+#include <QCloseEvent>
 #include <QLabel>
 #include <QMainWindow>
 #include <QTextEdit>
@@ -65,6 +66,23 @@ private:
 private slots:
     // Data received
     void DataReceived(const QString & mcrDate);
+
+
+
+    // =============================================================== Shutdown
+protected:
+    // Window closed: shut down gracefully first
+    virtual void closeEvent(QCloseEvent * mpEvent) override;
+
+private slots:
+    // SIGINT/SIGTERM received
+    void TerminationRequested(int mSignal);
+
+    // Downloads and database are done
+    void ShutdownComplete();
+
+private:
+    bool m_IsShutdownComplete;
 };
 
 #endif
@@ -0,0 +1,474 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// MemoryBackend.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "ColumnArchive.h"
+#include "MemoryBackend.h"
+#include "MessageLogger.h"
+
+// Qt includes
+#include <QMutexLocker>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+MemoryBackend::MemoryBackend(const QStringList & mcrColumns)
+    : StorageBackend(mcrColumns)
+{
+    CALL_IN(QString("mcrColumns=%1")
+        .arg(CALL_SHOW(mcrColumns)));
+
+    m_IsInTransaction = false;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+MemoryBackend::~MemoryBackend()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+// =============================================================== Observations
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Name
+QString MemoryBackend::GetName() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return "Memory";
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Nothing to do
+bool MemoryBackend::Migrate()
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add observations
+bool MemoryBackend::AppendBatch(
+    const QList < QHash < QString, QString > > & mcrObservations)
+{
+    CALL_IN(QString("mcrObservations=<%1 observations>")
+        .arg(QString::number(mcrObservations.size())));
+
+    QMutexLocker locker(&m_Mutex);
+    QVector < double > values(m_Metrics.size());
+    for (const QHash < QString, QString > & observation : mcrObservations)
+    {
+        const QString date_time = observation["date_time"];
+        if (date_time.size() != 19)
+        {
+            const QString reason = tr("Invalid time \"%1\".").arg(date_time);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        const qint64 time = ToSeconds(date_time);
+        KeepForUndo(observation["station_id"], time);
+        for (int metric = 0; metric < m_Metrics.size(); metric++)
+        {
+            values[metric] = ToValue(observation[m_Metrics[metric]]);
+        }
+        m_Observations[observation["station_id"]][time] = values;
+        m_TimeZones[observation["station_id"]] = observation["timezone"];
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Change values of observations
+bool MemoryBackend::ReviseBatch(
+    const QList < QHash < QString, QString > > & mcrRevisions)
+{
+    CALL_IN(QString("mcrRevisions=<%1 revisions>")
+        .arg(QString::number(mcrRevisions.size())));
+
+    if (!CheckRevisions(mcrRevisions))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // All revisions must be for known observations before any is applied
+    QMutexLocker locker(&m_Mutex);
+    for (const QHash < QString, QString > & revision : mcrRevisions)
+    {
+        if (!m_Observations.value(revision["station_id"])
+            .contains(ToSeconds(revision["date_time"])))
+        {
+            const QString reason = tr("Revised observation %1|%2 is unknown.")
+                .arg(revision["station_id"],
+                     revision["date_time"]);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+    for (const QHash < QString, QString > & revision : mcrRevisions)
+    {
+        KeepForUndo(revision["station_id"],
+            ToSeconds(revision["date_time"]));
+        QVector < double > & values = m_Observations[revision["station_id"]]
+            [ToSeconds(revision["date_time"])];
+        for (int metric = 0; metric < m_Metrics.size(); metric++)
+        {
+            if (revision.contains(m_Metrics[metric]))
+            {
+                values[metric] = ToValue(revision[m_Metrics[metric]]);
+            }
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Raw values
+bool MemoryBackend::QueryRange(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback,
+    QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrTimeZone=%5, mcChunkSize=%6, mcrCallback=..., mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id()),
+             CALL_SHOW(mcChunkSize)));
+
+    if (!CheckMetrics(mcrMetrics))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    QVector < int > indices;
+    for (const QString & metric : mcrMetrics)
+    {
+        indices << m_Metrics.indexOf(metric);
+    }
+    QMutexLocker locker(&m_Mutex);
+    mrResult.SetColumns(mcrMetrics);
+    QVector < double > values(mcrMetrics.size());
+    bool keep_going = true;
+    ForRange(mcrStationID,
+        ColumnArchive::ToSeconds(mcrFrom.date(), mcrFrom.time()),
+        ColumnArchive::ToSeconds(mcrTo.date(), mcrTo.time()),
+        [&](const qint64 mcTime, const QVector < double > & mcrValues)
+        {
+            if (!keep_going)
+            {
+                return;
+            }
+            for (int column = 0; column < indices.size(); column++)
+            {
+                values[column] = mcrValues[indices[column]];
+            }
+            keep_going = AppendRow(mrResult,
+                ToDateTime(mcTime, mcrTimeZone), values, mcChunkSize,
+                mcrCallback);
+        });
+    if (keep_going)
+    {
+        FinishChunks(mrResult, mcChunkSize, mcrCallback);
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary of a day
+bool MemoryBackend::DaySummary(const QString & mcrStationID,
+    const QDate & mcrDate, const QStringList & mcrMetrics,
+    const QTimeZone & mcrTimeZone, QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrDate=%2, mcrMetrics=%3, "
+        "mcrTimeZone=%4, mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrDate),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id())));
+
+    if (!CheckMetrics(mcrMetrics))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    QVector < int > indices;
+    for (const QString & metric : mcrMetrics)
+    {
+        indices << m_Metrics.indexOf(metric);
+    }
+    QVector < double > summary = EmptySummary(mcrMetrics.size());
+    QMutexLocker locker(&m_Mutex);
+    ForRange(mcrStationID,
+        ColumnArchive::ToSeconds(mcrDate, QTime(0, 0)),
+        ColumnArchive::ToSeconds(mcrDate.addDays(1), QTime(0, 0)),
+        [&](const qint64, const QVector < double > & mcrValues)
+        {
+            for (int metric = 0; metric < indices.size(); metric++)
+            {
+                AddToSummary(summary, metric, mcrValues[indices[metric]]);
+            }
+        });
+    AppendSummary(mrResult, mcrMetrics, mcrDate, mcrTimeZone, summary);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// All observations
+bool MemoryBackend::ReadAll(
+    QList < QHash < QString, QString > > & mrObservations)
+{
+    CALL_IN("mrObservations=...");
+
+    QMutexLocker locker(&m_Mutex);
+    for (auto station_iterator = m_Observations.constBegin();
+         station_iterator != m_Observations.constEnd();
+         station_iterator++)
+    {
+        const QMap < qint64, QVector < double > > & observations =
+            station_iterator.value();
+        for (auto observation_iterator = observations.constBegin();
+             observation_iterator != observations.constEnd();
+             observation_iterator++)
+        {
+            QHash < QString, QString > observation;
+            observation["station_id"] = station_iterator.key();
+            observation["timezone"] =
+                m_TimeZones.value(station_iterator.key());
+            observation["date_time"] =
+                ToDateTimeText(observation_iterator.key());
+            for (int metric = 0; metric < m_Metrics.size(); metric++)
+            {
+                observation[m_Metrics[metric]] =
+                    ToText(observation_iterator.value()[metric]);
+            }
+            mrObservations << observation;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time zone of a station
+QString MemoryBackend::GetTimeZone(const QString & mcrStationID)
+{
+    CALL_IN(QString("mcrStationID=%1")
+        .arg(CALL_SHOW(mcrStationID)));
+
+    QMutexLocker locker(&m_Mutex);
+    const QString time_zone = m_TimeZones.value(mcrStationID);
+
+    CALL_OUT("");
+    return time_zone;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Visit the rows of a station in a range
+void MemoryBackend::ForRange(const QString & mcrStationID,
+    const qint64 mcFrom, const qint64 mcTo,
+    const std::function < void (const qint64,
+        const QVector < double > &) > & mcrVisitor) const
+{
+    CALL_IN(QString("mcrStationID=%1, mcFrom=%2, mcTo=%3, mcrVisitor=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcFrom),
+             CALL_SHOW(mcTo)));
+
+    const auto station_iterator = m_Observations.constFind(mcrStationID);
+    if (station_iterator == m_Observations.constEnd())
+    {
+        CALL_OUT("");
+        return;
+    }
+    const QMap < qint64, QVector < double > > & observations =
+        station_iterator.value();
+    for (auto observation_iterator = observations.lowerBound(mcFrom);
+         observation_iterator != observations.constEnd() &&
+            observation_iterator.key() < mcTo;
+         observation_iterator++)
+    {
+        mcrVisitor(observation_iterator.key(), observation_iterator.value());
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// =============================================================== Transactions
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start writes that can be undone
+bool MemoryBackend::Begin()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_Mutex);
+    m_IsInTransaction = true;
+    m_Undo.clear();
+    m_UndoTimeZones = m_TimeZones;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Keep writes since Begin()
+bool MemoryBackend::Commit()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_Mutex);
+    m_IsInTransaction = false;
+    m_Undo.clear();
+    m_UndoTimeZones.clear();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Undo writes since Begin()
+void MemoryBackend::Rollback()
+{
+    CALL_IN("");
+
+    QMutexLocker locker(&m_Mutex);
+    if (!m_IsInTransaction)
+    {
+        CALL_OUT("");
+        return;
+    }
+    for (auto station_iterator = m_Undo.constBegin();
+         station_iterator != m_Undo.constEnd();
+         station_iterator++)
+    {
+        QMap < qint64, QVector < double > > & observations =
+            m_Observations[station_iterator.key()];
+        const QMap < qint64, QVector < double > > & undo =
+            station_iterator.value();
+        for (auto row_iterator = undo.constBegin();
+             row_iterator != undo.constEnd();
+             row_iterator++)
+        {
+            if (row_iterator.value().isEmpty())
+            {
+                observations.remove(row_iterator.key());
+            } else
+            {
+                observations[row_iterator.key()] = row_iterator.value();
+            }
+        }
+        if (observations.isEmpty())
+        {
+            m_Observations.remove(station_iterator.key());
+        }
+    }
+    m_TimeZones = m_UndoTimeZones;
+    m_IsInTransaction = false;
+    m_Undo.clear();
+    m_UndoTimeZones.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remember a row before it changes
+void MemoryBackend::KeepForUndo(const QString & mcrStationID,
+    const qint64 mcTime)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    // Only the first change of a row counts
+    if (!m_IsInTransaction ||
+        m_Undo.value(mcrStationID).contains(mcTime))
+    {
+        return;
+    }
+    m_Undo[mcrStationID][mcTime] =
+        m_Observations.value(mcrStationID).value(mcTime);
+}
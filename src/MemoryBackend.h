@@ -0,0 +1,122 @@
+// MemoryBackend.h
+// Class definition
+
+/** \class MemoryBackend
+  * Observations in memory, per station ordered by time. Nothing is kept
+  * when the process ends; meant for tests, benchmarks and short-lived
+  * tools. An observation for a time that is already there replaces it.
+  * Calls may come from several threads.
+  */
+
+#ifndef MEMORYBACKEND_H
+#define MEMORYBACKEND_H
+
+// Project includes
+#include "StorageBackend.h"
+
+// Qt includes
+#include <QMap>
+#include <QMutex>
+
+// System includes
+#include <functional>
+
+
+
+// Class definition
+class MemoryBackend
+    : public StorageBackend
+{
+    Q_DECLARE_TR_FUNCTIONS(MemoryBackend)
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    MemoryBackend(const QStringList & mcrColumns);
+
+    // Destructor
+    virtual ~MemoryBackend();
+
+
+
+    // =========================================================== Observations
+public:
+    // Name
+    virtual QString GetName() const;
+
+    // Nothing to do
+    virtual bool Migrate();
+
+    // Add observations
+    virtual bool AppendBatch(
+        const QList < QHash < QString, QString > > & mcrObservations);
+
+    // Change values of observations
+    virtual bool ReviseBatch(
+        const QList < QHash < QString, QString > > & mcrRevisions);
+
+    // Raw values
+    virtual bool QueryRange(const QString & mcrStationID,
+        const QDateTime & mcrFrom, const QDateTime & mcrTo,
+        const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+        const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QueryResult & mrResult);
+
+    // Summary of a day
+    virtual bool DaySummary(const QString & mcrStationID,
+        const QDate & mcrDate, const QStringList & mcrMetrics,
+        const QTimeZone & mcrTimeZone, QueryResult & mrResult);
+
+    // All observations
+    virtual bool ReadAll(
+        QList < QHash < QString, QString > > & mrObservations);
+
+    // Time zone of a station
+    virtual QString GetTimeZone(const QString & mcrStationID);
+
+private:
+    // Station to time (see ColumnArchive::ToSeconds()) to values of all
+    // metrics
+    QHash < QString, QMap < qint64, QVector < double > > > m_Observations;
+
+    // Station to its time zone
+    QHash < QString, QString > m_TimeZones;
+
+    // Observations and time zones
+    mutable QMutex m_Mutex;
+
+    // Visit the rows of a station in a range
+    void ForRange(const QString & mcrStationID, const qint64 mcFrom,
+        const qint64 mcTo,
+        const std::function < void (const qint64,
+            const QVector < double > &) > & mcrVisitor) const;
+
+
+
+    // =========================================================== Transactions
+public:
+    // Start writes that can be undone
+    virtual bool Begin();
+
+    // Keep writes since Begin()
+    virtual bool Commit();
+
+    // Undo writes since Begin()
+    virtual void Rollback();
+
+private:
+    // Within Begin() and Commit()/Rollback()
+    bool m_IsInTransaction;
+
+    // Rows as they were before the transaction (empty if there was none)
+    QHash < QString, QMap < qint64, QVector < double > > > m_Undo;
+    QHash < QString, QString > m_UndoTimeZones;
+
+    // Remember a row before it changes
+    void KeepForUndo(const QString & mcrStationID, const qint64 mcTime);
+};
+
+#endif
@@ -0,0 +1,217 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// QueryResult.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "QueryResult.h"
+
+// Qt includes
+#include <QtNumeric>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+QueryResult::QueryResult()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+QueryResult::~QueryResult()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+// ===================================================================== Access
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Set columns
+void QueryResult::SetColumns(const QStringList & mcrColumns)
+{
+    CALL_IN(QString("mcrColumns=%1")
+        .arg(CALL_SHOW(mcrColumns)));
+
+    m_Columns = mcrColumns;
+    m_Times.clear();
+    m_Values.clear();
+    for (int column = 0; column < m_Columns.size(); column++)
+    {
+        m_Values << QVector < double >();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Names of the value columns
+QStringList QueryResult::GetColumns() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Columns;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a row
+void QueryResult::Append(const QDateTime & mcrTime,
+    const QVector < double > & mcrValues)
+{
+    CALL_IN(QString("mcrTime=%1, mcrValues=...")
+        .arg(CALL_SHOW(mcrTime)));
+
+    m_Times << mcrTime;
+    for (int column = 0; column < m_Values.size(); column++)
+    {
+        m_Values[column] << mcrValues.value(column, qQNaN());
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add rows
+void QueryResult::Append(QSpan < const QDateTime > mTimes,
+    const QList < QSpan < const double > > & mcrValues)
+{
+    CALL_IN(QString("mTimes=<%1 rows>, mcrValues=...")
+        .arg(QString::number(mTimes.size())));
+
+    m_Times.reserve(m_Times.size() + mTimes.size());
+    for (const QDateTime & time : mTimes)
+    {
+        m_Times << time;
+    }
+    for (int column = 0; column < m_Values.size(); column++)
+    {
+        QVector < double > & values = m_Values[column];
+        if (column >= mcrValues.size())
+        {
+            values.insert(values.size(), mTimes.size(), qQNaN());
+            continue;
+        }
+        values.reserve(values.size() + mTimes.size());
+        for (const double value : mcrValues[column])
+        {
+            values << value;
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of rows
+int QueryResult::Size() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Times.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove all rows
+void QueryResult::Clear()
+{
+    CALL_IN("");
+
+    m_Times.clear();
+    for (QVector < double > & values : m_Values)
+    {
+        values.clear();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time column
+const QVector < QDateTime > & QueryResult::GetTimes() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Times;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Value column
+const QVector < double > & QueryResult::GetColumn(
+    const QString & mcrColumn) const
+{
+    CALL_IN(QString("mcrColumn=%1")
+        .arg(CALL_SHOW(mcrColumn)));
+
+    const int index = m_Columns.indexOf(mcrColumn);
+    if (index < 0)
+    {
+        static const QVector < double > empty;
+        CALL_OUT("");
+        return empty;
+    }
+
+    CALL_OUT("");
+    return m_Values[index];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Size for the result cache
+int QueryResult::GetCost() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return qMax(1, m_Times.size() * (m_Columns.size() + 1));
+}
@@ -0,0 +1,77 @@
+// QueryResult.h
+// Class definition
+
+/** \class QueryResult
+  * Result of WundergroundComms::Query(): a time column plus one column of
+  * doubles per requested value (NaN where there is no value).
+  *
+  * Raw observations have one column per metric. Rollups have the mean as
+  * column "<metric>" plus "<metric>_min", "<metric>_max" and
+  * "<metric>_count".
+  */
+
+#ifndef QUERYRESULT_H
+#define QUERYRESULT_H
+
+// Qt includes
+#include <QDateTime>
+#include <QList>
+#include <QSpan>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+
+
+// Class definition
+class QueryResult
+{
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    QueryResult();
+
+    // Destructor
+    virtual ~QueryResult();
+
+
+
+    // ================================================================= Access
+public:
+    // Set columns (clears all data)
+    void SetColumns(const QStringList & mcrColumns);
+
+    // Names of the value columns
+    QStringList GetColumns() const;
+
+    // Add a row (values in the order of the columns)
+    void Append(const QDateTime & mcrTime,
+        const QVector < double > & mcrValues);
+
+    // Add rows: times and one span of values per column (as handed out by
+    // ColumnArchive::ScanBlocks())
+    void Append(QSpan < const QDateTime > mTimes,
+        const QList < QSpan < const double > > & mcrValues);
+
+    // Number of rows
+    int Size() const;
+
+    // Remove all rows (columns are kept)
+    void Clear();
+
+    // Time column
+    const QVector < QDateTime > & GetTimes() const;
+
+    // Value column (empty if there is no such column)
+    const QVector < double > & GetColumn(const QString & mcrColumn) const;
+
+    // Size for the result cache (number of values)
+    int GetCost() const;
+
+private:
+    QStringList m_Columns;
+    QVector < QDateTime > m_Times;
+    QList < QVector < double > > m_Values;
+};
+
+#endif
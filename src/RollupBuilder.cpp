@@ -0,0 +1,207 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// RollupBuilder.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "DatabaseHelper.h"
+#include "RollupBuilder.h"
+
+// Qt includes
+#include <QDate>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+RollupBuilder::RollupBuilder(const QString & mcrDatabaseFilename,
+    const QString & mcrStationID, const QString & mcrMonth,
+    const QStringList & mcrMetrics)
+{
+    CALL_IN(QString("mcrDatabaseFilename=%1, mcrStationID=%2, mcrMonth=%3, "
+        "mcrMetrics=%4")
+        .arg(CALL_SHOW(mcrDatabaseFilename),
+             CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth),
+             CALL_SHOW(mcrMetrics)));
+
+    m_DatabaseFilename = mcrDatabaseFilename;
+    m_StationID = mcrStationID;
+    m_Month = mcrMonth;
+    m_Metrics = mcrMetrics;
+    m_Source = "wu_data";
+
+    // Results are collected by the caller after the pool is done
+    setAutoDelete(false);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+RollupBuilder::~RollupBuilder()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+// ==================================================================== Rollups
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SELECT for hourly rollups of one station and date/time range
+QString RollupBuilder::HourlySQL(const QStringList & mcrMetrics,
+    const QString & mcrSource)
+{
+    CALL_IN(QString("mcrMetrics=%1, mcrSource=%2")
+        .arg(CALL_SHOW(mcrMetrics),
+             CALL_SHOW(mcrSource)));
+
+    // Long format: one SELECT per metric, all on the same rows
+    QStringList selects;
+    for (const QString & metric : mcrMetrics)
+    {
+        selects << QString("SELECT station_id, substr(date_time, 1, 13), "
+            "'%1', count(%1), min(%1), max(%1), sum(%1) FROM observations "
+            "GROUP BY station_id, substr(date_time, 1, 13) "
+            "HAVING count(%1) > 0")
+            .arg(metric);
+    }
+    const QString sql = QString("WITH observations AS "
+        "(SELECT * FROM %1 WHERE station_id = :station_id "
+        "AND date_time >= :from AND date_time < :to) %2")
+        .arg(mcrSource,
+             selects.join(" UNION ALL "));
+
+    CALL_OUT("");
+    return sql;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read observations from a table or subquery
+void RollupBuilder::SetDataSource(const QString & mcrSource,
+    const QHash < QString, QString > & mcrAttachments)
+{
+    CALL_IN(QString("mcrSource=%1, mcrAttachments=%2")
+        .arg(CALL_SHOW(mcrSource),
+             CALL_SHOW(mcrAttachments)));
+
+    m_Source = mcrSource;
+    m_Attachments = mcrAttachments;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compute rollups
+void RollupBuilder::run()
+{
+    CALL_IN("");
+
+    // Qt SQL connections can't be shared between threads
+    QSqlDatabase db = DatabaseHelper::GetReadConnection(m_DatabaseFilename);
+    if (!db.isOpen())
+    {
+        m_Error = db.lastError().text();
+        CALL_OUT(m_Error);
+        return;
+    }
+
+    // Partitions
+    for (auto attachment_iterator = m_Attachments.constBegin();
+         attachment_iterator != m_Attachments.constEnd();
+         attachment_iterator++)
+    {
+        if (!DatabaseHelper::AttachDatabase(attachment_iterator.key(),
+            attachment_iterator.value(), db))
+        {
+            m_Error = QString("Could not attach %1")
+                .arg(attachment_iterator.value());
+            CALL_OUT(m_Error);
+            return;
+        }
+    }
+
+    const QDate first = QDate::fromString(m_Month + "-01", "yyyy-MM-dd");
+    QSqlQuery & query =
+        DatabaseHelper::PreparedQuery(HourlySQL(m_Metrics, m_Source), db);
+    query.bindValue(":station_id", m_StationID);
+    query.bindValue(":from", first.toString("yyyy-MM-dd"));
+    query.bindValue(":to", first.addMonths(1).toString("yyyy-MM-dd"));
+    if (!DatabaseHelper::TimedExec(query, QString(), db))
+    {
+        m_Error = query.lastError().text();
+        CALL_OUT(m_Error);
+        return;
+    }
+    while (query.next())
+    {
+        QVariantList row;
+        for (int column = 0; column < 7; column++)
+        {
+            row << query.value(column);
+        }
+        m_Results << row;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Results
+const QList < QVariantList > & RollupBuilder::GetResults() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Results;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Error message
+QString RollupBuilder::GetError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Error;
+}
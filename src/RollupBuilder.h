@@ -0,0 +1,78 @@
+// RollupBuilder.h
+// Class definition
+
+/** \class RollupBuilder
+  * Computes the hourly rollups of one station and month from the raw
+  * observations, for rebuilding the rollup tables in parallel.
+  *
+  * Runs in a QThreadPool thread with its own read-only database connection
+  * (see DatabaseHelper::GetReadConnection()); the results are written by the
+  * caller on the main thread.
+  * CallTracer keeps a call stack per thread, so run() is traced like
+  * anything else; MessageLogger is not thread-safe, so run() doesn't use it.
+  */
+
+#ifndef ROLLUPBUILDER_H
+#define ROLLUPBUILDER_H
+
+// Qt includes
+#include <QHash>
+#include <QList>
+#include <QRunnable>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+
+
+// Class definition
+class RollupBuilder
+    : public QRunnable
+{
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    RollupBuilder(const QString & mcrDatabaseFilename,
+        const QString & mcrStationID, const QString & mcrMonth,
+        const QStringList & mcrMetrics);
+
+    // Destructor
+    virtual ~RollupBuilder();
+
+
+
+    // ================================================================ Rollups
+public:
+    // SELECT for hourly rollups of one station and date/time range
+    // (:station_id, :from, :to); one row per hour and metric with
+    // station_id, period, metric, count, min, max, sum. mcrSource is the
+    // table (or subquery) with the observations.
+    static QString HourlySQL(const QStringList & mcrMetrics,
+        const QString & mcrSource = "wu_data");
+
+    // Read observations from mcrSource, with database files to attach first
+    // (schema to filename; for partitions)
+    void SetDataSource(const QString & mcrSource,
+        const QHash < QString, QString > & mcrAttachments);
+
+    // Compute rollups
+    virtual void run() override;
+
+    // Results (one row per hour and metric, as in HourlySQL())
+    const QList < QVariantList > & GetResults() const;
+
+    // Error message (empty if everything went fine)
+    QString GetError() const;
+
+private:
+    QString m_DatabaseFilename;
+    QString m_StationID;
+    QString m_Month;
+    QStringList m_Metrics;
+    QString m_Source;
+    QHash < QString, QString > m_Attachments;
+    QList < QVariantList > m_Results;
+    QString m_Error;
+};
+
+#endif
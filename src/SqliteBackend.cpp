@@ -0,0 +1,785 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// SqliteBackend.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "DatabaseHelper.h"
+#include "MessageLogger.h"
+#include "SqliteBackend.h"
+
+// Qt includes
+#include <QMap>
+#include <QSqlQuery>
+#include <QtNumeric>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+SqliteBackend::SqliteBackend(const QSqlDatabase & mcrDatabase,
+    const QString & mcrTable, const QStringList & mcrColumns)
+    : StorageBackend(mcrColumns)
+{
+    CALL_IN(QString("mcrDatabase=..., mcrTable=%1, mcrColumns=%2")
+        .arg(CALL_SHOW(mcrTable),
+             CALL_SHOW(mcrColumns)));
+
+    m_Database = mcrDatabase;
+    m_Table = mcrTable;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+SqliteBackend::~SqliteBackend()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+// ===================================================================== Layout
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Connection of the calling thread
+void SqliteBackend::SetConnection(
+    const std::function < QSqlDatabase () > & mcrConnection)
+{
+    CALL_IN("mcrConnection=...");
+
+    m_Connection = mcrConnection;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Partitioned layout
+void SqliteBackend::SetPartitioning(
+    const std::function < QString (const QString &,
+        const QString &) > & mcrTableOf,
+    const std::function < QStringList () > & mcrTables,
+    const std::function < QString (const QString &, const int,
+        const int, const QSqlDatabase &) > & mcrSource,
+    const std::function < int (const QString &) > & mcrLastYear)
+{
+    CALL_IN("mcrTableOf=..., mcrTables=..., mcrSource=..., "
+        "mcrLastYear=...");
+
+    m_TableOf = mcrTableOf;
+    m_Tables = mcrTables;
+    m_Source = mcrSource;
+    m_LastYear = mcrLastYear;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Connection of the calling thread
+QSqlDatabase SqliteBackend::GetConnection() const
+{
+    CALL_IN("");
+
+    if (!m_Connection)
+    {
+        CALL_OUT("");
+        return m_Database;
+    }
+
+    CALL_OUT("");
+    return m_Connection();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Table an observation goes to
+QString SqliteBackend::GetTable(const QString & mcrStationID,
+    const QString & mcrDateTime) const
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    return (m_TableOf ? m_TableOf(mcrStationID, mcrDateTime) : m_Table);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// All tables
+QStringList SqliteBackend::GetTables() const
+{
+    CALL_IN("");
+
+    if (!m_Tables)
+    {
+        CALL_OUT("");
+        return QStringList({ m_Table });
+    }
+
+    CALL_OUT("");
+    return m_Tables();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FROM clause for a station's observations within a range of years
+QString SqliteBackend::GetSource(const QString & mcrStationID,
+    const int mcFirstYear, const int mcLastYear,
+    const QSqlDatabase & mcrDatabase) const
+{
+    CALL_IN(QString("mcrStationID=%1, mcFirstYear=%2, mcLastYear=%3, "
+        "mcrDatabase=%4")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcFirstYear),
+             CALL_SHOW(mcLastYear),
+             CALL_SHOW(mcrDatabase.connectionName())));
+
+    if (!m_Source)
+    {
+        CALL_OUT("");
+        return m_Table;
+    }
+
+    CALL_OUT("");
+    return m_Source(mcrStationID, mcFirstYear, mcLastYear, mcrDatabase);
+}
+
+
+
+// =============================================================== Observations
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Name
+QString SqliteBackend::GetName() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return "SQLite";
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Create table and index
+bool SqliteBackend::Migrate()
+{
+    CALL_IN("");
+
+    // Partitions get their table when they are created
+    const QSqlDatabase db = GetConnection();
+    QSqlQuery query(db);
+    if (!DatabaseHelper::Exec(query,
+        QString("CREATE TABLE IF NOT EXISTS %1 ("
+            "station_id text, "
+            "timezone text, "
+            "date_time datetime, "
+            "latitude float, "
+            "longitude float, "
+            "solar_radiation_high float, "
+            "uv_high float, "
+            "wind_direction_avg_degree float, "
+            "humidity_high_percent float, "
+            "humidity_low_percent float, "
+            "humidity_avg_percent float, "
+            "temperature_high_c float, "
+            "temperature_low_c float, "
+            "temperature_avg_c float, "
+            "windspeed_high_kmh float, "
+            "windspeed_low_kmh float, "
+            "windspeed_avg_kmh float, "
+            "wind_gust_high_kmh float, "
+            "wind_gust_low_kmh float, "
+            "wind_gust_avg_kmh float, "
+            "dew_point_high_c float, "
+            "dew_point_low_c float, "
+            "dew_point_avg_c float, "
+            "wind_chill_high_c float, "
+            "wind_chill_low_c float, "
+            "wind_chill_avg_c float, "
+            "heat_index_high_c float, "
+            "heat_index_low_c float, "
+            "heat_index_avg_c float, "
+            "pressure_max_hpa float, "
+            "pressure_min_hpa float, "
+            "pressure_trend_hpa float, "
+            "precipitation_rate_mm float, "
+            "precipitation_total_mm float);")
+            .arg(m_Table),
+        __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error creating table \"%1\"")
+            .arg(m_Table);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Observations are looked up by station and time (the index goes into
+    // the table's schema)
+    const QString schema = m_Table.section(".", 0, -2);
+    const QString table = m_Table.section(".", -1);
+    if (!DatabaseHelper::Exec(query,
+        QString("CREATE INDEX IF NOT EXISTS %1%2_station_date_time "
+            "ON %2 (station_id, date_time);")
+            .arg(schema.isEmpty() ? QString() : schema + ".",
+                 table),
+        __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error creating index on \"%1\"")
+            .arg(m_Table);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add observations
+bool SqliteBackend::AppendBatch(
+    const QList < QHash < QString, QString > > & mcrObservations)
+{
+    CALL_IN(QString("mcrObservations=<%1 observations>")
+        .arg(QString::number(mcrObservations.size())));
+
+    // Observations by table, so every table's statement is looked up once
+    QMap < QString, QVector < int > > tables;
+    for (int index = 0; index < mcrObservations.size(); index++)
+    {
+        const QHash < QString, QString > & observation =
+            mcrObservations[index];
+        tables[GetTable(observation["station_id"],
+            observation["date_time"])] << index;
+    }
+    QStringList item_tables;
+    QVector < int > items;
+    for (auto table_iterator = tables.constBegin();
+         table_iterator != tables.constEnd();
+         table_iterator++)
+    {
+        for (const int index : table_iterator.value())
+        {
+            item_tables << table_iterator.key();
+            items << index;
+        }
+    }
+
+    // All or nothing
+    const QSqlDatabase db = GetConnection();
+    QSqlQuery * insert_query = nullptr;
+    const bool success = RunBatch("append_batch", items.size(),
+        [&](const int mcItem)
+        {
+            if (mcItem == 0 ||
+                item_tables[mcItem] != item_tables[mcItem - 1])
+            {
+                insert_query = &DatabaseHelper::PreparedQuery(
+                    QString("INSERT INTO %1 (%2) VALUES (:%3);")
+                        .arg(item_tables[mcItem],
+                             m_Columns.join(", "),
+                             m_Columns.join(", :")),
+                    db);
+            }
+            const QHash < QString, QString > & observation =
+                mcrObservations[items[mcItem]];
+            for (const QString & column : m_Columns)
+            {
+                insert_query -> bindValue(":" + column, observation[column]);
+            }
+            return DatabaseHelper::Exec(*insert_query, __FILE__, __LINE__,
+                db);
+        });
+    if (!success)
+    {
+        const QString reason = tr("SQL error adding observations");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Change values of observations
+bool SqliteBackend::ReviseBatch(
+    const QList < QHash < QString, QString > > & mcrRevisions)
+{
+    CALL_IN(QString("mcrRevisions=<%1 revisions>")
+        .arg(QString::number(mcrRevisions.size())));
+
+    if (!CheckRevisions(mcrRevisions))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Corrections usually affect the same columns throughout a day, so the
+    // statement for them is prepared only once
+    const QSqlDatabase db = GetConnection();
+    const bool success = RunBatch("revise_batch", mcrRevisions.size(),
+        [&](const int mcItem)
+        {
+            const QHash < QString, QString > & revision =
+                mcrRevisions[mcItem];
+            QStringList columns = revision.keys();
+            columns.removeAll("station_id");
+            columns.removeAll("date_time");
+            columns.sort();
+            if (columns.isEmpty())
+            {
+                return true;
+            }
+            QStringList assignments;
+            for (const QString & column : columns)
+            {
+                assignments << QString("%1 = :%1").arg(column);
+            }
+            QSqlQuery & query = DatabaseHelper::PreparedQuery(
+                QString("UPDATE %1 SET %2 WHERE station_id = :station_id "
+                    "AND date_time = :date_time;")
+                    .arg(GetTable(revision["station_id"],
+                             revision["date_time"]),
+                         assignments.join(", ")),
+                db);
+            for (auto value_iterator = revision.constBegin();
+                 value_iterator != revision.constEnd();
+                 value_iterator++)
+            {
+                query.bindValue(":" + value_iterator.key(),
+                    value_iterator.value());
+            }
+            return DatabaseHelper::Exec(query, __FILE__, __LINE__, db);
+        });
+    if (!success)
+    {
+        const QString reason = tr("SQL error revising observations");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Raw values
+bool SqliteBackend::QueryRange(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback,
+    QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrTimeZone=%5, mcChunkSize=%6, mcrCallback=..., mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id()),
+             CALL_SHOW(mcChunkSize)));
+
+    if (!CheckMetrics(mcrMetrics))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    const QSqlDatabase db = GetConnection();
+    const QString source = GetSource(mcrStationID, mcrFrom.date().year(),
+        mcrTo.addSecs(-1).date().year(), db);
+    if (source.isEmpty())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        QString("SELECT date_time, %1 FROM %2 "
+            "WHERE station_id = :station_id "
+            "AND date_time >= :from AND date_time < :to "
+            "ORDER BY date_time;")
+            .arg(mcrMetrics.join(", "),
+                 source),
+        db);
+    query.bindValue(":station_id", mcrStationID);
+    query.bindValue(":from", mcrFrom.toString("yyyy-MM-dd hh:mm:ss"));
+    query.bindValue(":to", mcrTo.toString("yyyy-MM-dd hh:mm:ss"));
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error reading observations of "
+            "station \"%1\"").arg(mcrStationID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    mrResult.SetColumns(mcrMetrics);
+    QVector < double > values(mcrMetrics.size());
+    bool keep_going = true;
+    while (keep_going &&
+        query.next())
+    {
+        for (int column = 0; column < mcrMetrics.size(); column++)
+        {
+            const QVariant value = query.value(column + 1);
+            values[column] = value.isNull() ? qQNaN() : value.toDouble();
+        }
+        keep_going = AppendRow(mrResult,
+            ToDateTime(ToSeconds(query.value(0).toString()), mcrTimeZone),
+            values, mcChunkSize, mcrCallback);
+    }
+    if (keep_going)
+    {
+        FinishChunks(mrResult, mcChunkSize, mcrCallback);
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary of a day
+bool SqliteBackend::DaySummary(const QString & mcrStationID,
+    const QDate & mcrDate, const QStringList & mcrMetrics,
+    const QTimeZone & mcrTimeZone, QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrDate=%2, mcrMetrics=%3, "
+        "mcrTimeZone=%4, mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrDate),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id())));
+
+    if (!CheckMetrics(mcrMetrics))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // All metrics in one pass
+    QStringList aggregates;
+    for (const QString & metric : mcrMetrics)
+    {
+        aggregates << QString("count(%1), min(%1), max(%1), sum(%1)")
+            .arg(metric);
+    }
+    const QSqlDatabase db = GetConnection();
+    const QString source = GetSource(mcrStationID, mcrDate.year(),
+        mcrDate.year(), db);
+    if (source.isEmpty())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        QString("SELECT %1 FROM %2 "
+            "WHERE station_id = :station_id "
+            "AND date_time >= :from AND date_time < :to;")
+            .arg(aggregates.join(", "),
+                 source),
+        db);
+    query.bindValue(":station_id", mcrStationID);
+    query.bindValue(":from", mcrDate.toString("yyyy-MM-dd"));
+    query.bindValue(":to", mcrDate.addDays(1).toString("yyyy-MM-dd"));
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__, db) ||
+        !query.next())
+    {
+        const QString reason = tr("SQL error reading observations of "
+            "station \"%1\"").arg(mcrStationID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    QVector < double > summary = EmptySummary(mcrMetrics.size());
+    for (int metric = 0; metric < mcrMetrics.size(); metric++)
+    {
+        const int count = query.value(4 * metric).toInt();
+        if (count > 0)
+        {
+            summary[4 * metric] = count;
+            summary[4 * metric + 1] = query.value(4 * metric + 1).toDouble();
+            summary[4 * metric + 2] = query.value(4 * metric + 2).toDouble();
+            summary[4 * metric + 3] = query.value(4 * metric + 3).toDouble();
+        }
+    }
+    AppendSummary(mrResult, mcrMetrics, mcrDate, mcrTimeZone, summary);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// All observations
+bool SqliteBackend::ReadAll(
+    QList < QHash < QString, QString > > & mrObservations)
+{
+    CALL_IN("mrObservations=...");
+
+    // Main table and partitions
+    const QStringList tables = GetTables();
+    if (tables.isEmpty())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+    const QSqlDatabase db = GetConnection();
+    for (const QString & table : tables)
+    {
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        if (!DatabaseHelper::Exec(query,
+            QString("SELECT %1 FROM %2;")
+                .arg(m_Columns.join(", "),
+                     table),
+            __FILE__, __LINE__, db))
+        {
+            const QString reason = tr("SQL error reading table \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        while (query.next())
+        {
+            QHash < QString, QString > observation;
+            for (int column = 0; column < m_Columns.size(); column++)
+            {
+                const QVariant value = query.value(column);
+                if (m_Columns[column] == "date_time")
+                {
+                    observation["date_time"] =
+                        value.toDateTime().toString("yyyy-MM-dd hh:mm:ss");
+                } else
+                {
+                    observation[m_Columns[column]] =
+                        (value.isNull() ? QString() : value.toString());
+                }
+            }
+            mrObservations << observation;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time zone of a station
+QString SqliteBackend::GetTimeZone(const QString & mcrStationID)
+{
+    CALL_IN(QString("mcrStationID=%1")
+        .arg(CALL_SHOW(mcrStationID)));
+
+    // WU sends the IANA name (e.g. "Europe/Berlin") with every observation;
+    // the most recent partition will do
+    const QSqlDatabase db = GetConnection();
+    const int year = (m_LastYear ? m_LastYear(mcrStationID) : 0);
+    QString source = GetSource(mcrStationID, year, year, db);
+    if (source.isEmpty())
+    {
+        // Has been reported; try the main table.
+        source = m_Table;
+    }
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        QString("SELECT timezone FROM %1 "
+            "WHERE station_id = :station_id AND timezone IS NOT NULL "
+            "LIMIT 1;")
+            .arg(source),
+        db);
+    query.bindValue(":station_id", mcrStationID);
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__, db) ||
+        !query.next())
+    {
+        CALL_OUT("");
+        return QString();
+    }
+    const QString time_zone = query.value(0).toString();
+
+    CALL_OUT("");
+    return time_zone;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Run statements for a batch within a savepoint
+bool SqliteBackend::RunBatch(const QString & mcrSavepoint, const int mcSize,
+    const std::function < bool (const int) > & mcrStatement)
+{
+    CALL_IN(QString("mcrSavepoint=%1, mcSize=%2, mcrStatement=...")
+        .arg(CALL_SHOW(mcrSavepoint),
+             CALL_SHOW(mcSize)));
+
+    const QSqlDatabase db = GetConnection();
+    QSqlQuery query(db);
+    if (!DatabaseHelper::Exec(query,
+        QString("SAVEPOINT %1;").arg(mcrSavepoint),
+        __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error starting batch");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    for (int item = 0; item < mcSize; item++)
+    {
+        if (!mcrStatement(item))
+        {
+            // Undo the items before
+            DatabaseHelper::Exec(query,
+                QString("ROLLBACK TO %1;").arg(mcrSavepoint),
+                __FILE__, __LINE__, db);
+            DatabaseHelper::Exec(query,
+                QString("RELEASE %1;").arg(mcrSavepoint),
+                __FILE__, __LINE__, db);
+            const QString reason = tr("SQL error in batch item %1")
+                .arg(QString::number(item));
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+    if (!DatabaseHelper::Exec(query,
+        QString("RELEASE %1;").arg(mcrSavepoint),
+        __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error finishing batch");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// =============================================================== Transactions
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start writes that can be undone
+bool SqliteBackend::Begin()
+{
+    CALL_IN("");
+
+    const QSqlDatabase db = GetConnection();
+    QSqlQuery query(db);
+    if (!DatabaseHelper::Exec(query, "SAVEPOINT storage_transaction;",
+        __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error starting transaction");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Keep writes since Begin()
+bool SqliteBackend::Commit()
+{
+    CALL_IN("");
+
+    const QSqlDatabase db = GetConnection();
+    QSqlQuery query(db);
+    if (!DatabaseHelper::Exec(query, "RELEASE storage_transaction;",
+        __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error finishing transaction");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Undo writes since Begin()
+void SqliteBackend::Rollback()
+{
+    CALL_IN("");
+
+    // Errors have been reported; the caller rolls back its transaction, too
+    const QSqlDatabase db = GetConnection();
+    QSqlQuery query(db);
+    DatabaseHelper::Exec(query, "ROLLBACK TO storage_transaction;",
+        __FILE__, __LINE__, db);
+    DatabaseHelper::Exec(query, "RELEASE storage_transaction;",
+        __FILE__, __LINE__, db);
+
+    CALL_OUT("");
+}
@@ -0,0 +1,151 @@
+// SqliteBackend.h
+// Class definition
+
+/** \class SqliteBackend
+  * Observations in a table of an SQLite connection: "wu_data" of the main
+  * database, "<schema>.wu_data" of an attached partition, or a scratch
+  * database.
+  *
+  * The engine's backend is partitioned (see SetPartitioning()): new
+  * observations go to the table of their station and year, and reads cover
+  * the main table plus the partitions they need. With SetConnection(),
+  * every call uses the connection of the calling thread, so queries can
+  * run on worker threads.
+  *
+  * AppendBatch() and ReviseBatch() use a savepoint, so they are atomic on
+  * their own and nest within a transaction of the caller; so does Begin().
+  */
+
+#ifndef SQLITEBACKEND_H
+#define SQLITEBACKEND_H
+
+// Project includes
+#include "StorageBackend.h"
+
+// Qt includes
+#include <QSqlDatabase>
+
+// System includes
+#include <functional>
+
+
+
+// Class definition
+class SqliteBackend
+    : public StorageBackend
+{
+    Q_DECLARE_TR_FUNCTIONS(SqliteBackend)
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    SqliteBackend(const QSqlDatabase & mcrDatabase, const QString & mcrTable,
+        const QStringList & mcrColumns);
+
+    // Destructor
+    virtual ~SqliteBackend();
+
+
+
+    // ================================================================= Layout
+public:
+    // Connection of the calling thread (instead of the constructor's)
+    void SetConnection(
+        const std::function < QSqlDatabase () > & mcrConnection);
+
+    // Partitioned layout: table an observation goes to (station and
+    // date_time), all tables, the FROM clause (table or subquery) with a
+    // station's observations within a range of years on a connection, and
+    // the latest year a station has a partition for (0 if none). Tables and
+    // FROM clauses are empty if they couldn't be set up (which has been
+    // reported).
+    void SetPartitioning(
+        const std::function < QString (const QString &,
+            const QString &) > & mcrTableOf,
+        const std::function < QStringList () > & mcrTables,
+        const std::function < QString (const QString &, const int,
+            const int, const QSqlDatabase &) > & mcrSource,
+        const std::function < int (const QString &) > & mcrLastYear);
+
+private:
+    // Connection, tables and FROM clause (defaults without a layout)
+    QSqlDatabase GetConnection() const;
+    QString GetTable(const QString & mcrStationID,
+        const QString & mcrDateTime) const;
+    QStringList GetTables() const;
+    QString GetSource(const QString & mcrStationID, const int mcFirstYear,
+        const int mcLastYear, const QSqlDatabase & mcrDatabase) const;
+
+    // Connection and main table
+    QSqlDatabase m_Database;
+    QString m_Table;
+
+    // Layout
+    std::function < QSqlDatabase () > m_Connection;
+    std::function < QString (const QString &, const QString &) > m_TableOf;
+    std::function < QStringList () > m_Tables;
+    std::function < QString (const QString &, const int, const int,
+        const QSqlDatabase &) > m_Source;
+    std::function < int (const QString &) > m_LastYear;
+
+
+
+    // =========================================================== Observations
+public:
+    // Name
+    virtual QString GetName() const;
+
+    // Create main table and index
+    virtual bool Migrate();
+
+    // Add observations
+    virtual bool AppendBatch(
+        const QList < QHash < QString, QString > > & mcrObservations);
+
+    // Change values of observations
+    virtual bool ReviseBatch(
+        const QList < QHash < QString, QString > > & mcrRevisions);
+
+    // Raw values
+    virtual bool QueryRange(const QString & mcrStationID,
+        const QDateTime & mcrFrom, const QDateTime & mcrTo,
+        const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+        const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QueryResult & mrResult);
+
+    // Summary of a day
+    virtual bool DaySummary(const QString & mcrStationID,
+        const QDate & mcrDate, const QStringList & mcrMetrics,
+        const QTimeZone & mcrTimeZone, QueryResult & mrResult);
+
+    // All observations
+    virtual bool ReadAll(
+        QList < QHash < QString, QString > > & mrObservations);
+
+    // Time zone of a station
+    virtual QString GetTimeZone(const QString & mcrStationID);
+
+private:
+    // Run statements for a batch within a savepoint; mcrStatement executes
+    // one item and returns false on an error
+    bool RunBatch(const QString & mcrSavepoint, const int mcSize,
+        const std::function < bool (const int) > & mcrStatement);
+
+
+
+    // =========================================================== Transactions
+public:
+    // Start writes that can be undone
+    virtual bool Begin();
+
+    // Keep writes since Begin()
+    virtual bool Commit();
+
+    // Undo writes since Begin()
+    virtual void Rollback();
+};
+
+#endif
@@ -0,0 +1,401 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+
+// StorageBackend.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "ColumnArchive.h"
+#include "MessageLogger.h"
+#include "StorageBackend.h"
+
+// Qt includes
+#include <QtNumeric>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+StorageBackend::StorageBackend(const QStringList & mcrColumns)
+{
+    CALL_IN(QString("mcrColumns=%1")
+        .arg(CALL_SHOW(mcrColumns)));
+
+    m_Columns = mcrColumns;
+    m_Metrics = mcrColumns;
+    m_Metrics.removeAll("station_id");
+    m_Metrics.removeAll("timezone");
+    m_Metrics.removeAll("date_time");
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+StorageBackend::~StorageBackend()
+{
+    CALL_IN("");
+
+    // Nothing to do
+
+    CALL_OUT("");
+}
+
+
+
+// =============================================================== Observations
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Numeric columns
+QStringList StorageBackend::GetMetricColumns() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Metrics;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Metrics must be known columns
+bool StorageBackend::CheckMetrics(const QStringList & mcrMetrics) const
+{
+    CALL_IN(QString("mcrMetrics=%1")
+        .arg(CALL_SHOW(mcrMetrics)));
+
+    // Metrics may go into SQL
+    for (const QString & metric : mcrMetrics)
+    {
+        if (!m_Metrics.contains(metric))
+        {
+            const QString reason = tr("Unknown metric \"%1\".").arg(metric);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Revisions must name an observation and change known columns
+bool StorageBackend::CheckRevisions(
+    const QList < QHash < QString, QString > > & mcrRevisions) const
+{
+    CALL_IN(QString("mcrRevisions=<%1 revisions>")
+        .arg(QString::number(mcrRevisions.size())));
+
+    // Columns may go into SQL
+    for (const QHash < QString, QString > & revision : mcrRevisions)
+    {
+        if (!revision.contains("station_id") ||
+            !revision.contains("date_time"))
+        {
+            const QString reason =
+                tr("Revision without station or time.");
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        for (auto value_iterator = revision.constBegin();
+             value_iterator != revision.constEnd();
+             value_iterator++)
+        {
+            if (!m_Columns.contains(value_iterator.key()))
+            {
+                const QString reason = tr("Unknown column \"%1\".")
+                    .arg(value_iterator.key());
+                MessageLogger::Error(CALL_METHOD, reason);
+                CALL_OUT(reason);
+                return false;
+            }
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Observation value
+double StorageBackend::ToValue(const QString & mcrValue)
+{
+    // Called for every value - no CALL_IN/CALL_OUT in here.
+
+    bool ok = false;
+    const double value = mcrValue.toDouble(&ok);
+
+    return (ok ? value : qQNaN());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// "yyyy-MM-dd hh:mm:ss" as seconds
+qint64 StorageBackend::ToSeconds(const QString & mcrDateTime)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    // Date and time separately: station time doesn't necessarily exist in
+    // our time zone
+    const qint64 seconds = ColumnArchive::ToSeconds(
+        QDate::fromString(mcrDateTime.left(10), "yyyy-MM-dd"),
+        QTime::fromString(mcrDateTime.mid(11), "hh:mm:ss"));
+
+    return seconds;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Seconds as a time in a time zone
+QDateTime StorageBackend::ToDateTime(const qint64 mcSeconds,
+    const QTimeZone & mcrTimeZone)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    const QDateTime date_time(ColumnArchive::DateFromSeconds(mcSeconds),
+        ColumnArchive::TimeFromSeconds(mcSeconds), mcrTimeZone);
+
+    return date_time;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Seconds as "yyyy-MM-dd hh:mm:ss"
+QString StorageBackend::ToDateTimeText(const qint64 mcSeconds)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    const QString text =
+        ColumnArchive::DateFromSeconds(mcSeconds).toString("yyyy-MM-dd") +
+        " " + ColumnArchive::TimeFromSeconds(mcSeconds).toString("hh:mm:ss");
+
+    return text;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Value as text
+QString StorageBackend::ToText(const double mcValue)
+{
+    // Called for every value - no CALL_IN/CALL_OUT in here.
+
+    const QString text =
+        (qIsNaN(mcValue) ? QString() : QString::number(mcValue, 'g', 17));
+
+    return text;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a row to a range result
+bool StorageBackend::AppendRow(QueryResult & mrResult,
+    const QDateTime & mcrTime, const QVector < double > & mcrValues,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback)
+{
+    // Called for every row - no CALL_IN/CALL_OUT in here.
+
+    mrResult.Append(mcrTime, mcrValues);
+
+    // Hand over a full chunk
+    if (mcChunkSize > 0 &&
+        mrResult.Size() >= mcChunkSize)
+    {
+        const bool keep_going = mcrCallback(mrResult);
+        mrResult.Clear();
+        return keep_going;
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a block of rows to a range result
+bool StorageBackend::AppendRows(QueryResult & mrResult,
+    QSpan < const qint64 > mTimes,
+    const QList < QSpan < const double > > & mcrValues,
+    const QTimeZone & mcrTimeZone, const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback,
+    QVector < QDateTime > & mrTimesBuffer)
+{
+    CALL_IN(QString("mrResult=..., mTimes=<%1 rows>, mcrValues=..., "
+        "mcrTimeZone=%2, mcChunkSize=%3, mcrCallback=..., mrTimesBuffer=...")
+        .arg(QString::number(mTimes.size()),
+             QString(mcrTimeZone.id()),
+             CALL_SHOW(mcChunkSize)));
+
+    // As much as fits into the current chunk at a time
+    QList < QSpan < const double > > values(mcrValues.size());
+    qsizetype first = 0;
+    while (first < mTimes.size())
+    {
+        qsizetype count = mTimes.size() - first;
+        if (mcChunkSize > 0)
+        {
+            count = qMin(count, qsizetype(mcChunkSize - mrResult.Size()));
+        }
+        mrTimesBuffer.resize(count);
+        for (qsizetype row = 0; row < count; row++)
+        {
+            mrTimesBuffer[row] = ToDateTime(mTimes[first + row], mcrTimeZone);
+        }
+        for (int column = 0; column < mcrValues.size(); column++)
+        {
+            values[column] = mcrValues[column].subspan(first, count);
+        }
+        mrResult.Append(QSpan < const QDateTime >(mrTimesBuffer.constData(),
+            count), values);
+        first += count;
+
+        // Hand over a full chunk
+        if (mcChunkSize > 0 &&
+            mrResult.Size() >= mcChunkSize)
+        {
+            const bool keep_going = mcrCallback(mrResult);
+            mrResult.Clear();
+            if (!keep_going)
+            {
+                CALL_OUT("");
+                return false;
+            }
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Hand over the rest of a range result
+void StorageBackend::FinishChunks(QueryResult & mrResult,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback)
+{
+    CALL_IN(QString("mrResult=..., mcChunkSize=%1, mcrCallback=...")
+        .arg(CALL_SHOW(mcChunkSize)));
+
+    if (mcChunkSize > 0 &&
+        mrResult.Size() > 0)
+    {
+        mcrCallback(mrResult);
+        mrResult.Clear();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary without values
+QVector < double > StorageBackend::EmptySummary(const int mcNumMetrics)
+{
+    CALL_IN(QString("mcNumMetrics=%1")
+        .arg(CALL_SHOW(mcNumMetrics)));
+
+    QVector < double > summary;
+    for (int metric = 0; metric < mcNumMetrics; metric++)
+    {
+        summary << 0 << qQNaN() << qQNaN() << 0;
+    }
+
+    CALL_OUT("");
+    return summary;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a value to a summary
+void StorageBackend::AddToSummary(QVector < double > & mrSummary,
+    const int mcMetric, const double mcValue)
+{
+    // Called for every value - no CALL_IN/CALL_OUT in here.
+
+    if (qIsNaN(mcValue))
+    {
+        return;
+    }
+    const int index = 4 * mcMetric;
+    const bool is_first = (mrSummary[index] == 0);
+    mrSummary[index]++;
+    mrSummary[index + 1] =
+        (is_first ? mcValue : qMin(mrSummary[index + 1], mcValue));
+    mrSummary[index + 2] =
+        (is_first ? mcValue : qMax(mrSummary[index + 2], mcValue));
+    mrSummary[index + 3] += mcValue;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary as a result row
+void StorageBackend::AppendSummary(QueryResult & mrResult,
+    const QStringList & mcrMetrics, const QDate & mcrDate,
+    const QTimeZone & mcrTimeZone, const QVector < double > & mcrSummary)
+{
+    CALL_IN(QString("mrResult=..., mcrMetrics=%1, mcrDate=%2, "
+        "mcrTimeZone=%3, mcrSummary=...")
+        .arg(CALL_SHOW(mcrMetrics),
+             CALL_SHOW(mcrDate),
+             QString(mcrTimeZone.id())));
+
+    // Same layout as rollups in WundergroundComms::Query()
+    QStringList columns;
+    QVector < double > values;
+    for (int metric = 0; metric < mcrMetrics.size(); metric++)
+    {
+        const double count = mcrSummary[4 * metric];
+        columns << mcrMetrics[metric]
+            << mcrMetrics[metric] + "_min"
+            << mcrMetrics[metric] + "_max"
+            << mcrMetrics[metric] + "_count";
+        values << (count > 0 ? mcrSummary[4 * metric + 3] / count : qQNaN())
+            << mcrSummary[4 * metric + 1]
+            << mcrSummary[4 * metric + 2]
+            << count;
+    }
+    mrResult.SetColumns(columns);
+    mrResult.Append(QDateTime(mcrDate, QTime(0, 0), mcrTimeZone), values);
+
+    CALL_OUT("");
+}
@@ -0,0 +1,169 @@
+// StorageBackend.h
+// Class definition
+
+/** \class StorageBackend
+  * Where observations are kept: append, read a range, summarize a day and
+  * create or update the storage itself.
+  *
+  * Observations are passed the way WundergroundComms has them (database
+  * column to value as text, "date_time" as "yyyy-MM-dd hh:mm:ss" in
+  * station time; empty means no value). Ranges are in station time, from
+  * (inclusive) to (exclusive).
+  *
+  * Implementations: SqliteBackend (the engine's own tables), MemoryBackend
+  * and ArchiveBackend (ColumnArchive files).
+  */
+
+#ifndef STORAGEBACKEND_H
+#define STORAGEBACKEND_H
+
+// Project includes
+#include "QueryResult.h"
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDate>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QSpan>
+#include <QString>
+#include <QStringList>
+#include <QTimeZone>
+#include <QVector>
+
+// System includes
+#include <functional>
+
+
+
+// Class definition
+class StorageBackend
+{
+    Q_DECLARE_TR_FUNCTIONS(StorageBackend)
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor (all database columns, including station_id, timezone and
+    // date_time)
+    StorageBackend(const QStringList & mcrColumns);
+
+    // Destructor
+    virtual ~StorageBackend();
+
+
+
+    // =========================================================== Observations
+public:
+    // Name (for reports)
+    virtual QString GetName() const = 0;
+
+    // Create or update storage
+    virtual bool Migrate() = 0;
+
+    // Add observations
+    virtual bool AppendBatch(
+        const QList < QHash < QString, QString > > & mcrObservations) = 0;
+
+    // Change values of observations that are there already (station_id,
+    // date_time and the changed columns)
+    virtual bool ReviseBatch(
+        const QList < QHash < QString, QString > > & mcrRevisions) = 0;
+
+    // Raw values of mcrMetrics; times of the result are in mcrTimeZone. With
+    // a chunk size, rows are handed to mcrCallback in chunks of that many
+    // (and mrResult is empty afterwards) until it returns false.
+    virtual bool QueryRange(const QString & mcrStationID,
+        const QDateTime & mcrFrom, const QDateTime & mcrTo,
+        const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+        const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QueryResult & mrResult) = 0;
+
+    // Summary of a day as one row with the same columns as a rollup
+    // (mean as "<metric>", plus "<metric>_min", "<metric>_max" and
+    // "<metric>_count")
+    virtual bool DaySummary(const QString & mcrStationID,
+        const QDate & mcrDate, const QStringList & mcrMetrics,
+        const QTimeZone & mcrTimeZone, QueryResult & mrResult) = 0;
+
+    // All observations (values as text, empty if there is none)
+    virtual bool ReadAll(
+        QList < QHash < QString, QString > > & mrObservations) = 0;
+
+    // Time zone (IANA name) of a station's most recent observations; empty
+    // if there are none
+    virtual QString GetTimeZone(const QString & mcrStationID) = 0;
+
+    // Numeric columns
+    QStringList GetMetricColumns() const;
+
+
+
+    // =========================================================== Transactions
+    // Writes of a flush: AppendBatch() and ReviseBatch() after Begin() are
+    // undone by Rollback() and kept by Commit(). SQLite's transaction is a
+    // savepoint within the caller's transaction, so Commit() comes before
+    // the caller commits; the others only discard what they needed to undo.
+public:
+    virtual bool Begin() = 0;
+    virtual bool Commit() = 0;
+    virtual void Rollback() = 0;
+
+protected:
+    // All database columns
+    QStringList m_Columns;
+
+    // Numeric columns
+    QStringList m_Metrics;
+
+    // Metrics must be known columns
+    bool CheckMetrics(const QStringList & mcrMetrics) const;
+
+    // Revisions must name an observation and change known columns
+    bool CheckRevisions(
+        const QList < QHash < QString, QString > > & mcrRevisions) const;
+
+    // Observation value (NaN if empty)
+    static double ToValue(const QString & mcrValue);
+
+    // "yyyy-MM-dd hh:mm:ss" as seconds (see ColumnArchive::ToSeconds()),
+    // and back to a time in a time zone
+    static qint64 ToSeconds(const QString & mcrDateTime);
+    static QDateTime ToDateTime(const qint64 mcSeconds,
+        const QTimeZone & mcrTimeZone);
+
+    // Seconds as "yyyy-MM-dd hh:mm:ss", and a value as text (empty if NaN)
+    static QString ToDateTimeText(const qint64 mcSeconds);
+    static QString ToText(const double mcValue);
+
+    // Add a row to a range result, handing over full chunks (false once
+    // the callback wants no more), and hand over the rest at the end
+    static bool AppendRow(QueryResult & mrResult, const QDateTime & mcrTime,
+        const QVector < double > & mcrValues, const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback);
+
+    // Same for a block of rows from ColumnArchive::ScanBlocks() (times as
+    // seconds, converted to mcrTimeZone into mrTimesBuffer)
+    static bool AppendRows(QueryResult & mrResult,
+        QSpan < const qint64 > mTimes,
+        const QList < QSpan < const double > > & mcrValues,
+        const QTimeZone & mcrTimeZone, const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QVector < QDateTime > & mrTimesBuffer);
+    static void FinishChunks(QueryResult & mrResult, const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback);
+
+    // Summary row: count, minimum, maximum and sum per metric (four values
+    // each; minimum and maximum NaN when there are no values)
+    static QVector < double > EmptySummary(const int mcNumMetrics);
+    static void AddToSummary(QVector < double > & mrSummary,
+        const int mcMetric, const double mcValue);
+    static void AppendSummary(QueryResult & mrResult,
+        const QStringList & mcrMetrics, const QDate & mcrDate,
+        const QTimeZone & mcrTimeZone, const QVector < double > & mcrSummary);
+};
+
+#endif
@@ -20,25 +20,91 @@
 // Class implementation
 
 // Project includes
+#include "ArchiveBackend.h"
 #include "CallTracer.h"
+#include "ColumnArchive.h"
 #include "Config.h"
 #include "DatabaseHelper.h"
+#include "MemoryBackend.h"
 #include "MessageLogger.h"
+#include "RollupBuilder.h"
+#include "SqliteBackend.h"
 #include "WundergroundComms.h"
 
 // Qt includes
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QHttpMultiPart>
 #include <QJsonDocument>
+#include <QMap>
+#include <QMutexLocker>
 #include <QRegularExpression>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlRecord>
+#include <QThread>
+#include <QThreadPool>
+#include <QtNumeric>
 #include <QTimer>
 
 #define DEBUG false
 
+// SQLite's default limit for attached databases
+#define MAX_ATTACHED_PARTITIONS 10
+
+// Maximum time to wait for requests in flight when shutting down (ms)
+#ifndef SHUTDOWN_TIMEOUT
+#define SHUTDOWN_TIMEOUT (10*1000)
+#endif
+
+// Failed downloads are retried on start until they failed this many times
+#ifndef JOB_MAX_ATTEMPTS
+#define JOB_MAX_ATTEMPTS 3
+#endif
+
+// Size of the query result cache (number of values)
+#ifndef QUERY_CACHE_SIZE
+#define QUERY_CACHE_SIZE 1000000
+#endif
+
+// Apply corrections WU makes to observations we already have
+#ifndef WU_TRACK_REVISIONS
+#define WU_TRACK_REVISIONS true
+#endif
+
+// Statements taking longer than this (ms) go to the slow-query log
+#ifndef SQL_SLOW_QUERY_MS
+#define SQL_SLOW_QUERY_MS 100
+#endif
+
+// Prepared statements kept per database connection
+#ifndef SQL_PREPARED_QUERIES
+#define SQL_PREPARED_QUERIES 100
+#endif
+
+// Store observations in one file per station and year
+#ifndef WU_PARTITIONED
+#define WU_PARTITIONED false
+#endif
+
+// Partitions are sealed this many days after their year is over
+#ifndef PARTITION_SEAL_DAYS
+#define PARTITION_SEAL_DAYS 31
+#endif
+
+// Slow-query log (empty: next to the database)
+#ifndef SQL_SLOW_QUERY_LOG
+#define SQL_SLOW_QUERY_LOG QString()
+#endif
+
+// Where observations are kept: "sqlite", "memory" or "archive"
+#ifndef STORAGE_BACKEND
+#define STORAGE_BACKEND "sqlite"
+#endif
+
 
 
 // ================================================================== Lifecycle
@@ -63,9 +129,31 @@ WundergroundComms::WundergroundComms()
 
     // Database not connected
     m_DatabaseConnected = false;
+    m_DataRead = false;
+
+    // Query results
+    m_QueryCache.setMaxCost(QUERY_CACHE_SIZE);
+
+    // Revisions
+    m_IsRevisionMode = WU_TRACK_REVISIONS;
+    m_HasIgnoredRevisions = false;
+
+    // Partitions
+    m_IsPartitioned = WU_PARTITIONED;
+
+    // Storage backend (created when the database is opened)
+    m_StorageBackendName = STORAGE_BACKEND;
+    m_Storage = nullptr;
+
+    // Download queue (one request at a time unless told otherwise)
+    m_MaxRequestsInFlight = 1;
+    m_IsQueueActive = false;
 
     // Not running from the get go (needs to be configured first)
     m_IsRunning = false;
+    m_IsShuttingDown = false;
+    m_IsShutdownFinished = false;
+    m_ShutdownTime_Scheduler = 0;
 
     // Set up network access
     m_NetworkAccessManager = new QNetworkAccessManager(this);
@@ -75,6 +163,13 @@ WundergroundComms::WundergroundComms()
     // Timestamp for bot start
     m_StartDateTime = QDateTime::currentDateTime();
 
+    // Timer for periodic updates
+    m_UpdateTimer = new QTimer(this);
+    m_UpdateTimer -> setSingleShot(true);
+    m_UpdateTimer -> setInterval(CHECK_FOR_UPDATES_DELAY);
+    connect (m_UpdateTimer, SIGNAL(timeout()),
+        this, SLOT(Periodic_GetUpdates()));
+
     // Start periodic updates
     // (won't actually do anything because m_IsRunning is false)
     Periodic_GetUpdates();
@@ -91,6 +186,7 @@ WundergroundComms::~WundergroundComms()
     CALL_IN("");
 
     delete m_NetworkAccessManager;
+    delete m_Storage;
 
     CALL_OUT("");
 }
@@ -162,11 +258,175 @@ void WundergroundComms::SetDatabaseFile(const QString & mcrFilename)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Open database
-bool WundergroundComms::OpenDatabase()
+// Backend for observations
+bool WundergroundComms::SetStorageBackend(const QString & mcrName)
+{
+    CALL_IN(QString("mcrName=%1")
+        .arg(CALL_SHOW(mcrName)));
+
+    // Check name
+    if (!GetStorageBackends().contains(mcrName))
+    {
+        const QString reason = tr("Unknown storage backend \"%1\".")
+            .arg(mcrName);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Check if database is already connected
+    if (m_DatabaseConnected)
+    {
+        const QString reason = tr("Cannot change storage backend; "
+            "database is already connected.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    m_StorageBackendName = mcrName;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Backend for observations
+QString WundergroundComms::GetStorageBackend() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_StorageBackendName;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Available backends
+QStringList WundergroundComms::GetStorageBackends()
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return QStringList({ "sqlite", "memory", "archive" });
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Observations must be kept by SQLite
+bool WundergroundComms::CheckSqliteStorage(const QString & mcrAction) const
+{
+    CALL_IN(QString("mcrAction=%1")
+        .arg(CALL_SHOW(mcrAction)));
+
+    if (m_StorageBackendName != "sqlite")
+    {
+        const QString reason = tr("%1 needs the \"sqlite\" storage backend "
+            "(not \"%2\").")
+            .arg(mcrAction,
+                 m_StorageBackendName);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Create backend for observations
+bool WundergroundComms::OpenStorage()
 {
     CALL_IN("");
 
+    delete m_Storage;
+    m_Storage = nullptr;
+    if (m_StorageBackendName == "sqlite")
+    {
+        // Partitioned once there are partitions; every thread uses its own
+        // connection
+        SqliteBackend * backend = new SqliteBackend(QSqlDatabase::database(),
+            "wu_data", m_DatabaseColumns);
+        backend -> SetConnection([this]()
+            {
+                return GetConnection();
+            });
+        backend -> SetPartitioning(
+            [this](const QString & mcrStationID, const QString & mcrDateTime)
+            {
+                return (m_IsPartitioned ?
+                    PartitionSchema(PartitionOf(mcrStationID, mcrDateTime)) +
+                        ".wu_data" :
+                    QString("wu_data"));
+            },
+            [this]()
+            {
+                QStringList tables;
+                const QStringList partitions =
+                    QStringList({ QString() }) + GetPartitions(QString());
+                for (const QString & partition : partitions)
+                {
+                    const QString table = GetPartitionTable(partition);
+                    if (table.isEmpty())
+                    {
+                        // Has been reported.
+                        return QStringList();
+                    }
+                    tables << table;
+                }
+                return tables;
+            },
+            [this](const QString & mcrStationID, const int mcFirstYear,
+                const int mcLastYear, const QSqlDatabase & mcrDatabase)
+            {
+                return DataSource(mcrStationID, mcFirstYear, mcLastYear,
+                    mcrDatabase);
+            },
+            [this](const QString & mcrStationID)
+            {
+                const QStringList partitions = GetPartitions(mcrStationID);
+                return (partitions.isEmpty() ?
+                    0 : partitions.last().section("|", 1).toInt());
+            });
+        m_Storage = backend;
+    } else if (m_StorageBackendName == "memory")
+    {
+        m_Storage = new MemoryBackend(m_DatabaseColumns);
+    } else if (m_StorageBackendName == "archive")
+    {
+        m_Storage = new ArchiveBackend(
+            QFileInfo(m_DatabaseFilename).absolutePath() + "/observations",
+            m_DatabaseColumns);
+    } else
+    {
+        const QString reason = tr("Unknown storage backend \"%1\".")
+            .arg(m_StorageBackendName);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Tables or directory (new databases), or the index that came later
+    const bool success = m_Storage -> Migrate();
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open database
+bool WundergroundComms::OpenDatabase(const bool mcReadData)
+{
+    CALL_IN(QString("mcReadData=%1")
+        .arg(CALL_SHOW(mcReadData)));
+
     // Check if database is already open
     if (m_DatabaseConnected)
     {
@@ -185,9 +445,6 @@ bool WundergroundComms::OpenDatabase()
         return false;
     }
 
-    // Check if the file exists
-    const bool database_initialized = QFile::exists(m_DatabaseFilename);
-
     // Try to connect
     QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
     db.setDatabaseName(m_DatabaseFilename);
@@ -201,19 +458,30 @@ bool WundergroundComms::OpenDatabase()
         return false;
     }
 
-    if (!database_initialized)
+    // Backend for observations
+    if (!OpenStorage())
     {
-        // Create database
-        const bool success = CreateDatabase();
-        if (!success)
-        {
-            const QString reason = tr("Could not set up database in %1")
-                .arg(m_DatabaseFilename);
-            MessageLogger::Error(CALL_METHOD, reason);
-            CALL_OUT(reason);
-            return false;
-        }
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Slow statements are logged with their query plan
+    QString slow_query_log = SQL_SLOW_QUERY_LOG;
+    if (slow_query_log.isEmpty())
+    {
+        slow_query_log = QFileInfo(m_DatabaseFilename).absolutePath()
+            + "/slow_queries.log";
     }
+    DatabaseHelper::SetSlowQueryLog(slow_query_log, SQL_SLOW_QUERY_MS);
+    DatabaseHelper::SetMaxPreparedQueries(SQL_PREPARED_QUERIES);
+
+    // Write-ahead log: readers don't block the writer, and commits are cheap
+    QSqlQuery pragma_query;
+    pragma_query.exec("PRAGMA journal_mode=WAL;");
+    DatabaseHelper::HasSQLError(pragma_query, __FILE__, __LINE__);
+    pragma_query.exec("PRAGMA synchronous=NORMAL;");
+    DatabaseHelper::HasSQLError(pragma_query, __FILE__, __LINE__);
 
     // Update database
     UpdateDatabase();
@@ -221,8 +489,34 @@ bool WundergroundComms::OpenDatabase()
     // Database is connected now
     m_DatabaseConnected = true;
 
+    // Partitions (once there are any, the layout is partitioned)
+    if (!ReadPartitions())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+    if (m_IsPartitioned)
+    {
+        SealPartitions();
+    }
+
+    // Tools that only look at the database don't need the data in memory
+    if (!mcReadData)
+    {
+        CALL_OUT("");
+        return true;
+    }
+
     // Read database
-    const bool success = ReadDatabase();
+    const bool success = ReadDatabase() && ReadDayHashes();
+    m_DataRead = success;
+
+    // Downloads that didn't finish last time
+    if (success)
+    {
+        ResumeJobs();
+    }
 
     // Check for date range and incomplete data sets
     QHash < QString, int > observation_count;
@@ -250,7 +544,8 @@ bool WundergroundComms::OpenDatabase()
             if (!observation_count.contains(this_date_text))
             {
                 no_data << this_date_text;
-            } else if (observation_count[this_date_text] < 24*12 &&
+            } else if (observation_count[this_date_text] <
+                    OBSERVATIONS_PER_DAY &&
                 this_date_text != min_date &&
                 this_date_text != today)
             {
@@ -281,68 +576,19 @@ bool WundergroundComms::OpenDatabase()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Create database
-bool WundergroundComms::CreateDatabase()
+// Create table for observations of a partition
+bool WundergroundComms::CreateDataTable(const QString & mcrTable)
 {
-    CALL_IN("");
-
-    // Check if database is already connected
-    if (m_DatabaseConnected)
-    {
-        const QString reason =
-            tr("Cannot initialize database; it is already connected.");
-        MessageLogger::Error(CALL_METHOD, reason);
-        CALL_OUT(reason);
-        return false;
-    }
+    CALL_IN(QString("mcrTable=%1")
+        .arg(CALL_SHOW(mcrTable)));
 
-    // Create table
-    QSqlQuery query;
-    query.exec(QString("CREATE TABLE wu_data ("
-        "station_id text, "
-        "timezone text, "
-        "date_time datetime, "
-        "latitude float, "
-        "longitude float, "
-        "solar_radiation_high float, "
-        "uv_high float, "
-        "wind_direction_avg_degree float, "
-        "humidity_high_percent float, "
-        "humidity_low_percent float, "
-        "humidity_avg_percent float, "
-        "temperature_high_c float, "
-        "temperature_low_c float, "
-        "temperature_avg_c float, "
-        "windspeed_high_kmh float, "
-        "windspeed_low_kmh float, "
-        "windspeed_avg_kmh float, "
-        "wind_gust_high_kmh float, "
-        "wind_gust_low_kmh float, "
-        "wind_gust_avg_kmh float, "
-        "dew_point_high_c float, "
-        "dew_point_low_c float, "
-        "dew_point_avg_c float, "
-        "wind_chill_high_c float, "
-        "wind_chill_low_c float, "
-        "wind_chill_avg_c float, "
-        "heat_index_high_c float, "
-        "heat_index_low_c float, "
-        "heat_index_avg_c float, "
-        "pressure_max_hpa float, "
-        "pressure_min_hpa float, "
-        "pressure_trend_hpa float, "
-        "precipitation_rate_mm float, "
-        "precipitation_total_mm float);"));
-    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
-    {
-        const QString reason = tr("SQL error creating table \"wu_data\"");
-        MessageLogger::Error(CALL_METHOD, reason);
-        CALL_OUT(reason);
-        return false;
-    }
+    // Table and index
+    SqliteBackend backend(QSqlDatabase::database(), mcrTable,
+        m_DatabaseColumns);
+    const bool success = backend.Migrate();
 
     CALL_OUT("");
-    return true;
+    return success;
 }
 
 
@@ -372,45 +618,32 @@ bool WundergroundComms::ReadDatabase()
         return false;
     }
 
-    // Read table
-    QStringList columns = m_WUToDB.values();
-    columns.removeAll("");
-    std::sort(columns.begin(), columns.end());
-    QSqlQuery query;
-    query.exec(QString("SELECT %1 from wu_data;")
-        .arg(columns.join(", ")));
-    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    // From the storage backend (SQLite: the main table, then the
+    // partitions one by one)
+    QList < QHash < QString, QString > > observations;
+    if (!m_Storage -> ReadAll(observations))
     {
-        const QString reason = tr("SQL error reading table \"wu_data\"");
-        MessageLogger::Error(CALL_METHOD, reason);
-        CALL_OUT(reason);
+        // Has been reported.
+        CALL_OUT("");
         return false;
     }
-    while (query.next())
+
+    // Values as if they had just been downloaded
+    const QStringList metrics = GetMetricColumns();
+    for (QHash < QString, QString > & observation : observations)
     {
-        QHash < QString, QString > line;
-        for (int col_index = 0; col_index < columns.size(); col_index++)
+        for (const QString & metric : metrics)
         {
-            if (columns[col_index] == "station_id" ||
-                columns[col_index] == "timezone")
-            {
-                line[columns[col_index]] = query.value(col_index).toString();
-            } else if (columns[col_index] == "date_time")
-            {
-                const QDateTime value = query.value(col_index).toDateTime();
-                line[columns[col_index]] =
-                    value.toString("yyyy-MM-dd hh:mm:ss");
-            } else
-            {
-                const float value = query.value(col_index).toFloat();
-                line[columns[col_index]] = QString::number(value, 'f', 1);
-            }
+            observation[metric] =
+                NormalizeValue(observation.value(metric).toFloat());
         }
-        m_WeatherData << line;
 
-        const QString station_id = line["station_id"];
-        const QString date_time = line["date_time"];
+        const QString station_id = observation["station_id"];
+        const QString date_time = observation["date_time"];
+        const QString key = station_id + "|" + date_time;
+        m_ObservationIndex[key] = m_WeatherData.size();
         m_StationToDateTimes[station_id] += date_time;
+        m_WeatherData << observation;
     }
 
     emit StatusUpdate(tr("Database read; %1 stations, %2 records in total.")
@@ -424,47 +657,212 @@ bool WundergroundComms::ReadDatabase()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Save observation to database
+// Save observations to database
 bool WundergroundComms::SaveToDatabase(
-    const QHash < QString, QString > & mcrObservation)
+    const QList < QHash < QString, QString > > & mcrObservations)
 {
-    CALL_IN(QString("mcrObservation=%1")
-        .arg(CALL_SHOW(mcrObservation)));
+    CALL_IN(QString("mcrObservations=<%1 observations>")
+        .arg(QString::number(mcrObservations.size())));
 
     // Check if database has been connected
     if (!m_DatabaseConnected)
     {
-        const QString reason = tr("Cannot save observation to database; "
+        const QString reason = tr("Cannot save observations to database; "
             "it has not been connected yet.");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
         return false;
     }
 
-    // Save observation to table
-    QStringList columns = m_WUToDB.values();
-    columns.removeAll("");
-    std::sort(columns.begin(), columns.end());
-    QSqlQuery query;
-    query.prepare(QString("INSERT INTO wu_data (%1) VALUES (:%2);")
-        .arg(columns.join(", "),
-             columns.join(", :")));
-    for (auto column_iterator = columns.constBegin();
-         column_iterator != columns.constEnd();
-         column_iterator++)
+    // SQLite: one statement per table
+    const bool success = m_Storage -> AppendBatch(mcrObservations);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write all queued observations in one transaction
+bool WundergroundComms::FlushWriteQueue()
+{
+    CALL_IN("");
+
+    // Nothing to do
+    if (m_WriteQueue.isEmpty() &&
+        m_RevisionQueue.isEmpty() &&
+        m_RevisionLog.isEmpty() &&
+        m_DayUpdates.isEmpty() &&
+        m_JobUpdates.isEmpty())
     {
-        const QString & column = *column_iterator;
-        query.bindValue(":" + column, mcrObservation[column]);
+        CALL_OUT("");
+        return true;
     }
-    query.exec();
-    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
     {
-        const QString reason =
-            tr("SQL error adding observation to \"wu_data\"");
+        const QString reason = tr("Cannot write %1 queued observations; "
+            "database has not been connected.")
+                .arg(QString::number(m_WriteQueue.size()));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Days whose rollups need to be recomputed
+    QSet < QPair < QString, QString > > touched_days;
+    for (const QHash < QString, QString > & observation : m_WriteQueue)
+    {
+        touched_days += qMakePair(observation["station_id"],
+            observation["date_time"].left(10));
+    }
+    for (const QHash < QString, QString > & revision : m_RevisionQueue)
+    {
+        touched_days += qMakePair(revision["station_id"],
+            revision["date_time"].left(10));
+    }
+
+    // Partitions that are written to have to be attached before the
+    // transaction starts (SQLite can't attach within one)
+    QSqlDatabase db = QSqlDatabase::database();
+    if (m_IsPartitioned)
+    {
+        QStringList partitions;
+        for (const QPair < QString, QString > & day : touched_days)
+        {
+            partitions << PartitionOf(day.first, day.second);
+        }
+        partitions.removeDuplicates();
+        if (!AttachPartitions(partitions, db, true))
+        {
+            // Has been reported previously; keep the queue for next time.
+            CALL_OUT("");
+            return false;
+        }
+    }
+
+    // Observations and the state of the jobs that produced them go into
+    // the same transaction; the storage backend's writes are undone with
+    // it (memory and archive writes replace rows, so if the commit itself
+    // fails after the backend kept them, the retry just writes them again)
+    db.transaction();
+    if (!m_Storage -> Begin())
+    {
+        // Has been reported previously; keep the queue for next time.
+        db.rollback();
+        CALL_OUT("");
+        return false;
+    }
+    if (!SaveToDatabase(m_WriteQueue))
+    {
+        // Has been reported previously; keep the queue for next time.
+        m_Storage -> Rollback();
+        db.rollback();
+        CALL_OUT("");
+        return false;
+    }
+    if (!m_RevisionQueue.isEmpty() &&
+        !UpdateInDatabase(m_RevisionQueue))
+    {
+        // Has been reported previously; keep the queue for next time.
+        m_Storage -> Rollback();
+        db.rollback();
+        CALL_OUT("");
+        return false;
+    }
+    for (const QHash < QString, QString > & revision : m_RevisionLog)
+    {
+        const bool success = SaveRevisionToDatabase(revision);
+        if (!success)
+        {
+            // Has been reported previously; keep the queue for next time.
+            m_Storage -> Rollback();
+            db.rollback();
+            CALL_OUT("");
+            return false;
+        }
+    }
+    QSet < QPair < QString, QString > > touched_months;
+    for (const QPair < QString, QString > & day : touched_days)
+    {
+        const bool success = UpdateRollups(day.first, day.second);
+        if (!success)
+        {
+            // Has been reported previously; keep the queue for next time.
+            m_Storage -> Rollback();
+            db.rollback();
+            CALL_OUT("");
+            return false;
+        }
+        touched_months += qMakePair(day.first, day.second.left(7));
+    }
+    for (const QPair < QString, QString > & month : touched_months)
+    {
+        const bool success = UpdateMonthlyRollup(month.first, month.second);
+        if (!success)
+        {
+            // Has been reported previously; keep the queue for next time.
+            m_Storage -> Rollback();
+            db.rollback();
+            CALL_OUT("");
+            return false;
+        }
+    }
+    for (const QHash < QString, QString > & day : m_DayUpdates)
+    {
+        const bool success = SaveDayToDatabase(day);
+        if (!success)
+        {
+            // Has been reported previously; keep the queue for next time.
+            m_Storage -> Rollback();
+            db.rollback();
+            CALL_OUT("");
+            return false;
+        }
+    }
+    for (const QHash < QString, QString > & job : m_JobUpdates)
+    {
+        const bool success = SaveJobToDatabase(job);
+        if (!success)
+        {
+            // Has been reported previously; keep the queue for next time.
+            m_Storage -> Rollback();
+            db.rollback();
+            CALL_OUT("");
+            return false;
+        }
+    }
+    if (!m_Storage -> Commit())
+    {
+        // Has been reported previously; keep the queue for next time.
+        m_Storage -> Rollback();
+        db.rollback();
+        CALL_OUT("");
+        return false;
+    }
+    if (!db.commit())
+    {
+        const QString reason = tr("Could not commit %1 observations.")
+            .arg(QString::number(m_WriteQueue.size()));
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
         return false;
     }
+    for (const QPair < QString, QString > & day : touched_days)
+    {
+        InvalidateQueryCache(day.first, day.second);
+    }
+    for (const QPair < QString, QString > & month : touched_months)
+    {
+        InvalidateArchive(month.first, month.second);
+    }
+    m_WriteQueue.clear();
+    m_RevisionQueue.clear();
+    m_RevisionLog.clear();
+    m_DayUpdates.clear();
+    m_JobUpdates.clear();
 
     CALL_OUT("");
     return true;
@@ -473,62 +871,2352 @@ bool WundergroundComms::SaveToDatabase(
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Update database
-void WundergroundComms::UpdateDatabase()
+// Move WAL content into the database file
+bool WundergroundComms::CheckpointDatabase()
 {
     CALL_IN("");
 
-
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason =
+            tr("Cannot checkpoint database; it has not been connected yet.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    QSqlQuery query;
+    query.exec("PRAGMA wal_checkpoint(TRUNCATE);");
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error checkpointing database");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update database
+void WundergroundComms::UpdateDatabase()
+{
+    CALL_IN("");
+
+    // Download jobs (added after the first version)
+    QSqlQuery query;
+    query.exec("CREATE TABLE IF NOT EXISTS wu_jobs ("
+        "station_id text, "
+        "date text, "
+        "state text, "
+        "attempts integer, "
+        "last_error text, "
+        "updated datetime, "
+        "PRIMARY KEY (station_id, date));");
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error creating table \"wu_jobs\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Rollups (same layout for all resolutions)
+    const QStringList resolutions = { "hourly", "daily", "monthly" };
+    for (const QString & resolution : resolutions)
+    {
+        query.exec(QString("CREATE TABLE IF NOT EXISTS wu_rollup_%1 ("
+            "station_id text, "
+            "period text, "
+            "metric text, "
+            "count integer, "
+            "min float, "
+            "max float, "
+            "sum float, "
+            "PRIMARY KEY (station_id, period, metric));")
+            .arg(resolution));
+        if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+        {
+            const QString reason =
+                tr("SQL error creating table \"wu_rollup_%1\"")
+                    .arg(resolution);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return;
+        }
+    }
+
+    // Corrections WU made to observations
+    query.exec("CREATE TABLE IF NOT EXISTS wu_revisions ("
+        "station_id text, "
+        "date_time datetime, "
+        "column_name text, "
+        "old_value text, "
+        "new_value text, "
+        "revised datetime);");
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error creating table \"wu_revisions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Partitions (files next to the database)
+    query.exec("CREATE TABLE IF NOT EXISTS wu_partitions ("
+        "station_id text, "
+        "year integer, "
+        "sealed integer, "
+        "PRIMARY KEY (station_id, year));");
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error creating table \"wu_partitions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Content hashes of downloaded days
+    query.exec("CREATE TABLE IF NOT EXISTS wu_days ("
+        "station_id text, "
+        "date text, "
+        "observations integer, "
+        "content_hash text, "
+        "updated datetime, "
+        "PRIMARY KEY (station_id, date));");
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error creating table \"wu_days\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// ================================================================= Partitions
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Partitioned layout
+bool WundergroundComms::IsPartitioned() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_IsPartitioned;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Move observations from the main database into partitions
+bool WundergroundComms::SplitDatabase()
+{
+    CALL_IN("");
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason = tr("Cannot split database; "
+            "it has not been connected yet.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Moves rows out of "wu_data"
+    if (!CheckSqliteStorage(tr("Splitting the database")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Pending writes go into partitions once we're partitioned
+    if (!FlushWriteQueue())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Stations and years in the main database
+    QSqlQuery query;
+    if (!DatabaseHelper::Exec(query,
+        "SELECT DISTINCT station_id, substr(date_time, 1, 4) FROM wu_data "
+        "ORDER BY station_id, substr(date_time, 1, 4);",
+        __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error reading \"wu_data\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    QStringList partitions;
+    while (query.next())
+    {
+        partitions << PartitionOf(query.value(0).toString(),
+            query.value(1).toString());
+    }
+    m_IsPartitioned = true;
+
+    // One transaction per partition: copy, then delete from the main table
+    QSqlDatabase db = QSqlDatabase::database();
+    int num_moved = 0;
+    for (const QString & partition : partitions)
+    {
+        if (!AttachPartitions({ partition }, db, true))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        const QString year = partition.section("|", 1);
+        const QString next_year = QString::number(year.toInt() + 1);
+        db.transaction();
+        QSqlQuery & copy_query = DatabaseHelper::PreparedQuery(
+            QString("INSERT INTO %1.wu_data (%2) SELECT %2 FROM wu_data "
+                "WHERE station_id = :station_id "
+                "AND date_time >= :from AND date_time < :to;")
+                .arg(PartitionSchema(partition),
+                     m_DatabaseColumns.join(", ")));
+        copy_query.bindValue(":station_id", partition.section("|", 0, 0));
+        copy_query.bindValue(":from", year);
+        copy_query.bindValue(":to", next_year);
+        bool success = DatabaseHelper::Exec(copy_query, __FILE__, __LINE__);
+        const int num_rows = copy_query.numRowsAffected();
+        QSqlQuery & delete_query = DatabaseHelper::PreparedQuery(
+            "DELETE FROM wu_data WHERE station_id = :station_id "
+            "AND date_time >= :from AND date_time < :to;");
+        delete_query.bindValue(":station_id", partition.section("|", 0, 0));
+        delete_query.bindValue(":from", year);
+        delete_query.bindValue(":to", next_year);
+        success = success &&
+            DatabaseHelper::Exec(delete_query, __FILE__, __LINE__);
+        if (!success ||
+            !db.commit())
+        {
+            db.rollback();
+            const QString reason = tr("Could not move observations to "
+                "partition \"%1\".").arg(partition);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        num_moved += num_rows;
+        emit StatusUpdate(tr("Moved %1 observations to %2.")
+            .arg(QString::number(num_rows),
+                 GetPartitionFilename(partition)));
+    }
+
+    // Give the space back, and seal what's over
+    if (!DatabaseHelper::Exec(query, "VACUUM;", __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error vacuuming the main database");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    const bool success = SealPartitions();
+
+    emit StatusUpdate(tr("Split %1 observations into %2 partition(s).")
+        .arg(QString::number(num_moved),
+             QString::number(partitions.size())));
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Partitions of a station within a range of years
+QStringList WundergroundComms::GetPartitions(const QString & mcrStationID,
+    const int mcFirstYear, const int mcLastYear) const
+{
+    CALL_IN(QString("mcrStationID=%1, mcFirstYear=%2, mcLastYear=%3")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcFirstYear),
+             CALL_SHOW(mcLastYear)));
+
+    QStringList partitions;
+    {
+        QMutexLocker locker(&m_PartitionsMutex);
+        for (auto partition_iterator = m_Partitions.constBegin();
+             partition_iterator != m_Partitions.constEnd();
+             partition_iterator++)
+        {
+            const QString & partition = partition_iterator.key();
+            const int year = partition.section("|", 1).toInt();
+            if ((mcrStationID.isEmpty() ||
+                 partition.section("|", 0, 0) == mcrStationID) &&
+                year >= mcFirstYear &&
+                year <= mcLastYear)
+            {
+                partitions << partition;
+            }
+        }
+    }
+    partitions.sort();
+
+    CALL_OUT("");
+    return partitions;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// File of a partition
+QString WundergroundComms::GetPartitionFilename(
+    const QString & mcrPartition) const
+{
+    CALL_IN(QString("mcrPartition=%1")
+        .arg(CALL_SHOW(mcrPartition)));
+
+    const QString filename = QString("%1/partitions/%2_%3.sql")
+        .arg(QFileInfo(m_DatabaseFilename).absolutePath(),
+             mcrPartition.section("|", 0, 0),
+             mcrPartition.section("|", 1));
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Observation table of a partition
+QString WundergroundComms::GetPartitionTable(const QString & mcrPartition)
+{
+    CALL_IN(QString("mcrPartition=%1")
+        .arg(CALL_SHOW(mcrPartition)));
+
+    // Main database
+    if (mcrPartition.isEmpty())
+    {
+        CALL_OUT("");
+        return "wu_data";
+    }
+
+    // Check if partition exists
+    {
+        QMutexLocker locker(&m_PartitionsMutex);
+        if (!m_Partitions.contains(mcrPartition))
+        {
+            const QString reason = tr("Unknown partition \"%1\".")
+                .arg(mcrPartition);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return QString();
+        }
+    }
+
+    if (!AttachPartitions({ mcrPartition }, QSqlDatabase::database()))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return QString();
+    }
+
+    CALL_OUT("");
+    return PartitionSchema(mcrPartition) + ".wu_data";
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Seal partitions of years that are over
+bool WundergroundComms::SealPartitions()
+{
+    CALL_IN("");
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason = tr("Cannot seal partitions; "
+            "database has not been connected.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Late downloads for a year that just ended are still expected
+    const int open_year =
+        QDate::currentDate().addDays(-PARTITION_SEAL_DAYS).year();
+    QStringList partitions;
+    {
+        QMutexLocker locker(&m_PartitionsMutex);
+        for (auto partition_iterator = m_Partitions.constBegin();
+             partition_iterator != m_Partitions.constEnd();
+             partition_iterator++)
+        {
+            const QString & partition = partition_iterator.key();
+            if (!partition_iterator.value() &&
+                partition.section("|", 1).toInt() < open_year)
+            {
+                partitions << partition;
+            }
+        }
+    }
+    partitions.sort();
+
+    QSqlDatabase db = QSqlDatabase::database();
+    for (const QString & partition : partitions)
+    {
+        // Compact it; read-only files can't have a write-ahead log
+        const QString schema = PartitionSchema(partition);
+        const QString filename = GetPartitionFilename(partition);
+        QSqlQuery query;
+        bool success = AttachPartitions({ partition }, db) &&
+            DatabaseHelper::Exec(query,
+                QString("PRAGMA %1.journal_mode=DELETE;").arg(schema),
+                __FILE__, __LINE__) &&
+            DatabaseHelper::Exec(query, QString("VACUUM %1;").arg(schema),
+                __FILE__, __LINE__);
+        query.finish();
+        success = success &&
+            DatabaseHelper::DetachDatabase(schema, db) &&
+            QFile::setPermissions(filename, QFileDevice::ReadOwner |
+                QFileDevice::ReadGroup | QFileDevice::ReadOther);
+        if (!success)
+        {
+            const QString reason = tr("Could not seal partition \"%1\".")
+                .arg(partition);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+
+        QSqlQuery & update_query = DatabaseHelper::PreparedQuery(
+            "UPDATE wu_partitions SET sealed = 1 "
+            "WHERE station_id = :station_id AND year = :year;");
+        update_query.bindValue(":station_id", partition.section("|", 0, 0));
+        update_query.bindValue(":year", partition.section("|", 1).toInt());
+        if (!DatabaseHelper::Exec(update_query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error updating \"wu_partitions\"");
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        QMutexLocker locker(&m_PartitionsMutex);
+        m_Partitions[partition] = true;
+    }
+    if (!partitions.isEmpty())
+    {
+        emit StatusUpdate(tr("Sealed %1 partition(s): %2")
+            .arg(QString::number(partitions.size()),
+                 partitions.join(", ")));
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read list of partitions
+bool WundergroundComms::ReadPartitions()
+{
+    CALL_IN("");
+
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "SELECT station_id, year, sealed FROM wu_partitions;");
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error reading \"wu_partitions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    QHash < QString, bool > partitions;
+    while (query.next())
+    {
+        partitions[PartitionOf(query.value(0).toString(),
+            query.value(1).toString())] = (query.value(2).toInt() != 0);
+    }
+    {
+        QMutexLocker locker(&m_PartitionsMutex);
+        m_Partitions = partitions;
+    }
+    if (!partitions.isEmpty())
+    {
+        m_IsPartitioned = true;
+    }
+
+    // Partitions are SQLite databases
+    if (m_IsPartitioned &&
+        !CheckSqliteStorage(tr("Partitioning")))
+    {
+        // Has been reported.
+        m_IsPartitioned = false;
+        CALL_OUT("");
+        return false;
+    }
+
+    // Observations that haven't been moved yet are still read, but new ones
+    // go into partitions
+    if (m_IsPartitioned)
+    {
+        QSqlQuery check_query;
+        if (DatabaseHelper::Exec(check_query,
+                "SELECT 1 FROM wu_data LIMIT 1;", __FILE__, __LINE__) &&
+            check_query.next())
+        {
+            emit StatusUpdate(tr("The main database still holds "
+                "observations; run \"split\" to move them into "
+                "partitions."));
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Schema name of an attached partition
+QString WundergroundComms::PartitionSchema(const QString & mcrPartition)
+{
+    CALL_IN(QString("mcrPartition=%1")
+        .arg(CALL_SHOW(mcrPartition)));
+
+    static const QRegularExpression invalid("[^A-Za-z0-9]");
+    const QString schema = "p_" + QString(mcrPartition).replace(invalid, "_");
+
+    CALL_OUT("");
+    return schema;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Partition an observation goes to
+QString WundergroundComms::PartitionOf(const QString & mcrStationID,
+    const QString & mcrDateTime)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrDateTime=%2")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrDateTime)));
+
+    CALL_OUT("");
+    return mcrStationID + "|" + mcrDateTime.left(4);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Attach partitions to a connection
+bool WundergroundComms::AttachPartitions(const QStringList & mcrPartitions,
+    const QSqlDatabase & mcrDatabase, const bool mcForWriting)
+{
+    CALL_IN(QString("mcrPartitions=%1, mcrDatabase=..., mcForWriting=%2")
+        .arg(CALL_SHOW(mcrPartitions),
+             CALL_SHOW(mcForWriting)));
+
+    // Attaching more would detach some of these again
+    if (mcrPartitions.size() > MAX_ATTACHED_PARTITIONS)
+    {
+        const QString reason = tr("%1 partitions are needed at the same "
+            "time, but at most %2 can be attached.")
+            .arg(QString::number(mcrPartitions.size()),
+                 QString::number(MAX_ATTACHED_PARTITIONS));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    for (const QString & partition : mcrPartitions)
+    {
+        bool exists = false;
+        bool is_sealed = false;
+        {
+            QMutexLocker locker(&m_PartitionsMutex);
+            exists = m_Partitions.contains(partition);
+            is_sealed = m_Partitions.value(partition);
+        }
+
+        // New partitions are only created for writing
+        if (!exists)
+        {
+            if (mcForWriting &&
+                !CreatePartition(partition))
+            {
+                // Has been reported.
+                CALL_OUT("");
+                return false;
+            }
+            continue;
+        }
+        if (mcForWriting &&
+            is_sealed &&
+            !UnsealPartition(partition))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+
+        if (!DatabaseHelper::AttachDatabase(PartitionSchema(partition),
+            GetPartitionFilename(partition), mcrDatabase,
+            MAX_ATTACHED_PARTITIONS))
+        {
+            const QString reason = tr("Could not attach partition %1.")
+                .arg(GetPartitionFilename(partition));
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Create new partition
+bool WundergroundComms::CreatePartition(const QString & mcrPartition)
+{
+    CALL_IN(QString("mcrPartition=%1")
+        .arg(CALL_SHOW(mcrPartition)));
+
+    // Partitions are SQLite databases
+    if (!CheckSqliteStorage(tr("Partitioning")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Attaching creates the file
+    const QString filename = GetPartitionFilename(mcrPartition);
+    const QString schema = PartitionSchema(mcrPartition);
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    if (!DatabaseHelper::AttachDatabase(schema, filename,
+        QSqlDatabase::database(), MAX_ATTACHED_PARTITIONS))
+    {
+        const QString reason = tr("Could not create partition %1.")
+            .arg(filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Same table, index and journal as the main database
+    QSqlQuery query;
+    if (!CreateDataTable(schema + ".wu_data") ||
+        !DatabaseHelper::Exec(query,
+            QString("PRAGMA %1.journal_mode=WAL;").arg(schema),
+            __FILE__, __LINE__))
+    {
+        const QString reason = tr("Could not set up partition %1.")
+            .arg(filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Register it
+    QSqlQuery & insert_query = DatabaseHelper::PreparedQuery(
+        "INSERT OR IGNORE INTO wu_partitions (station_id, year, sealed) "
+        "VALUES (:station_id, :year, 0);");
+    insert_query.bindValue(":station_id", mcrPartition.section("|", 0, 0));
+    insert_query.bindValue(":year", mcrPartition.section("|", 1).toInt());
+    if (!DatabaseHelper::Exec(insert_query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error updating \"wu_partitions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    {
+        QMutexLocker locker(&m_PartitionsMutex);
+        m_Partitions[mcrPartition] = false;
+    }
+    emit StatusUpdate(tr("New partition %1").arg(filename));
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Make sealed partition writable again
+bool WundergroundComms::UnsealPartition(const QString & mcrPartition)
+{
+    CALL_IN(QString("mcrPartition=%1")
+        .arg(CALL_SHOW(mcrPartition)));
+
+    // If it is attached, it is attached read-only
+    const QString filename = GetPartitionFilename(mcrPartition);
+    if (!DatabaseHelper::DetachDatabase(PartitionSchema(mcrPartition),
+            QSqlDatabase::database()) ||
+        !QFile::setPermissions(filename,
+            QFile::permissions(filename) | QFileDevice::WriteOwner))
+    {
+        const QString reason = tr("Could not unseal partition %1.")
+            .arg(filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Will be sealed again on the next start
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "UPDATE wu_partitions SET sealed = 0 "
+        "WHERE station_id = :station_id AND year = :year;");
+    query.bindValue(":station_id", mcrPartition.section("|", 0, 0));
+    query.bindValue(":year", mcrPartition.section("|", 1).toInt());
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error updating \"wu_partitions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    {
+        QMutexLocker locker(&m_PartitionsMutex);
+        m_Partitions[mcrPartition] = false;
+    }
+    emit StatusUpdate(tr("Partition %1 unsealed for late changes.")
+        .arg(filename));
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Observations of a station within a range of years
+QString WundergroundComms::DataSource(const QString & mcrStationID,
+    const int mcFirstYear, const int mcLastYear,
+    const QSqlDatabase & mcrDatabase)
+{
+    CALL_IN(QString("mcrStationID=%1, mcFirstYear=%2, mcLastYear=%3, "
+        "mcrDatabase=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcFirstYear),
+             CALL_SHOW(mcLastYear)));
+
+    const QStringList partitions =
+        GetPartitions(mcrStationID, mcFirstYear, mcLastYear);
+    if (!AttachPartitions(partitions, mcrDatabase))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return QString();
+    }
+
+    CALL_OUT("");
+    return DataSourceSQL(partitions);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FROM clause for the main table and a list of partitions
+QString WundergroundComms::DataSourceSQL(const QStringList & mcrPartitions)
+{
+    CALL_IN(QString("mcrPartitions=%1")
+        .arg(CALL_SHOW(mcrPartitions)));
+
+    // Not partitioned
+    if (mcrPartitions.isEmpty())
+    {
+        CALL_OUT("");
+        return "wu_data";
+    }
+
+    // SQLite applies the WHERE clause to every part of the UNION ALL
+    QStringList selects;
+    selects << "SELECT * FROM wu_data";
+    for (const QString & partition : mcrPartitions)
+    {
+        selects << QString("SELECT * FROM %1.wu_data")
+            .arg(PartitionSchema(partition));
+    }
+
+    CALL_OUT("");
+    return "(" + selects.join(" UNION ALL ") + ")";
+}
+
+
+
+// ==================================================================== Archive
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Export months that are over and haven't been archived yet
+bool WundergroundComms::ArchiveMonths()
+{
+    CALL_IN("");
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason = tr("Cannot archive observations; "
+            "database has not been connected.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Months are listed from "wu_data" and its partitions
+    if (!CheckSqliteStorage(tr("Archiving")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Pending writes would delete the archives right away
+    if (!FlushWriteQueue())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    const QString archive_directory =
+        QFileInfo(m_DatabaseFilename).absolutePath() + "/archive";
+    if (!QDir().mkpath(archive_directory))
+    {
+        const QString reason = tr("Could not create \"%1\".")
+            .arg(archive_directory);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Months with observations in the main database and the partitions
+    // that are over (in station time; a day's margin is close enough)
+    const QString current_month =
+        QDate::currentDate().addDays(-1).toString("yyyy-MM");
+    QSet < QPair < QString, QString > > months;
+    for (const QString & partition :
+        QStringList({ QString() }) + GetPartitions(QString()))
+    {
+        const QString table = GetPartitionTable(partition);
+        if (table.isEmpty())
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        QSqlQuery & query = DatabaseHelper::PreparedQuery(
+            QString("SELECT DISTINCT station_id, substr(date_time, 1, 7) "
+                "FROM %1 WHERE date_time < :before;")
+                .arg(table));
+        query.bindValue(":before", current_month);
+        if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error reading \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        while (query.next())
+        {
+            months += qMakePair(query.value(0).toString(),
+                query.value(1).toString());
+        }
+    }
+
+    // Export the ones we don't have yet
+    const QStringList columns = GetMetricColumns();
+    int num_archived = 0;
+    for (const QPair < QString, QString > & month : months)
+    {
+        const QString filename = GetArchiveFilename(month.first, month.second);
+        if (QFile::exists(filename))
+        {
+            continue;
+        }
+        QVector < qint64 > times;
+        QList < QVector < double > > values;
+        if (!ReadMonth(month.first, month.second, times, values) ||
+            !ColumnArchive::Write(filename, month.first,
+                GetStationTimeZone(month.first).id(), columns, times,
+                values))
+        {
+            // Has been reported.
+            CALL_OUT("");
+            return false;
+        }
+        num_archived++;
+        emit StatusUpdate(tr("Archived %1 observations to %2.")
+            .arg(QString::number(times.size()),
+                 filename));
+    }
+
+    emit StatusUpdate(tr("Archived %1 month(s).")
+        .arg(QString::number(num_archived)));
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Archive file of a station and month
+QString WundergroundComms::GetArchiveFilename(const QString & mcrStationID,
+    const QString & mcrMonth) const
+{
+    CALL_IN(QString("mcrStationID=%1, mcrMonth=%2")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth)));
+
+    const QString filename = ArchiveBackend::GetFilename(
+        QFileInfo(m_DatabaseFilename).absolutePath() + "/archive",
+        mcrStationID, mcrMonth);
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Archived months of a station
+QStringList WundergroundComms::GetArchivedMonths(
+    const QString & mcrStationID) const
+{
+    CALL_IN(QString("mcrStationID=%1")
+        .arg(CALL_SHOW(mcrStationID)));
+
+    // File names are <station>_<yyyy-MM>.wuc
+    const QDir archive_directory(
+        QFileInfo(m_DatabaseFilename).absolutePath() + "/archive");
+    QStringList months;
+    for (const QString & filename :
+        archive_directory.entryList({ "*.wuc" }, QDir::Files))
+    {
+        const QString base_name = QFileInfo(filename).completeBaseName();
+        const QString station_id = base_name.section("_", 0, -2);
+        if (mcrStationID.isEmpty() ||
+            station_id == mcrStationID)
+        {
+            months << station_id + "|" + base_name.section("_", -1);
+        }
+    }
+    months.sort();
+
+    CALL_OUT("");
+    return months;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Observations of a station and month from the database
+bool WundergroundComms::ReadMonth(const QString & mcrStationID,
+    const QString & mcrMonth, QVector < qint64 > & mrTimes,
+    QList < QVector < double > > & mrValues)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrMonth=%2, mrTimes=..., "
+        "mrValues=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth)));
+
+    const QDate first_day = QDate::fromString(mcrMonth + "-01", "yyyy-MM-dd");
+    if (!first_day.isValid())
+    {
+        const QString reason = tr("Invalid month \"%1\".").arg(mcrMonth);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Station time as UTC, so the result's dates and times are the
+    // station's as they are (station time doesn't necessarily exist in our
+    // time zone)
+    const QStringList columns = GetMetricColumns();
+    QueryResult result;
+    if (!m_Storage -> QueryRange(mcrStationID,
+        QDateTime(first_day, QTime(0, 0), QTimeZone::UTC),
+        QDateTime(first_day.addMonths(1), QTime(0, 0), QTimeZone::UTC),
+        columns, QTimeZone::UTC, 0, nullptr, result))
+    {
+        const QString reason = tr("Could not read %1 of %2")
+            .arg(mcrMonth,
+                 mcrStationID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    mrTimes.clear();
+    for (const QDateTime & time : result.GetTimes())
+    {
+        mrTimes << ColumnArchive::ToSeconds(time.date(), time.time());
+    }
+    mrValues.clear();
+    for (const QString & column : columns)
+    {
+        mrValues << result.GetColumn(column);
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Range entirely covered by archives
+bool WundergroundComms::IsArchived(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics) const
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics)));
+
+    const ArchiveBackend archive(
+        QFileInfo(m_DatabaseFilename).absolutePath() + "/archive",
+        m_DatabaseColumns);
+    const bool is_archived =
+        archive.Covers(mcrStationID, mcrFrom, mcrTo, mcrMetrics);
+
+    CALL_OUT("");
+    return is_archived;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Raw query from archives
+bool WundergroundComms::RunArchiveQuery(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback,
+    QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrTimeZone=%5, mcChunkSize=%6, mcrCallback=..., mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             QString(mcrTimeZone.id()),
+             CALL_SHOW(mcChunkSize)));
+
+    // Same files and format as the "archive" storage backend
+    ArchiveBackend archive(
+        QFileInfo(m_DatabaseFilename).absolutePath() + "/archive",
+        m_DatabaseColumns);
+    const bool success = archive.QueryRange(mcrStationID, mcrFrom, mcrTo,
+        mcrMetrics, mcrTimeZone, mcChunkSize, mcrCallback, mrResult);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Drop the archive of a station and month
+void WundergroundComms::InvalidateArchive(const QString & mcrStationID,
+    const QString & mcrMonth)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrMonth=%2")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth)));
+
+    const QString filename = GetArchiveFilename(mcrStationID, mcrMonth);
+    if (QFile::exists(filename) &&
+        !QFile::remove(filename))
+    {
+        // Queries would read outdated observations
+        const QString reason = tr("Could not remove outdated archive "
+            "\"%1\".").arg(filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// ======================================================================= Jobs
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Record new state of a download
+void WundergroundComms::UpdateJob(const QString & mcrDate,
+    const QString & mcrState, const QString & mcrError)
+{
+    CALL_IN(QString("mcrDate=%1, mcrState=%2, mcrError=%3")
+        .arg(CALL_SHOW(mcrDate),
+             CALL_SHOW(mcrState),
+             CALL_SHOW(mcrError)));
+
+    QHash < QString, QString > job;
+    job["date"] = mcrDate;
+    job["state"] = mcrState;
+    job["error"] = mcrError;
+    job["updated"] =
+        QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    m_JobUpdates << job;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write one job update
+bool WundergroundComms::SaveJobToDatabase(
+    const QHash < QString, QString > & mcrJob)
+{
+    CALL_IN(QString("mcrJob=%1")
+        .arg(CALL_SHOW(mcrJob)));
+
+    // Sending a request is an attempt
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "INSERT INTO wu_jobs "
+        "(station_id, date, state, attempts, last_error, updated) "
+        "VALUES (:station_id, :date, :state, :attempts, :last_error, "
+        ":updated) "
+        "ON CONFLICT (station_id, date) DO UPDATE SET "
+        "state = excluded.state, "
+        "attempts = attempts + excluded.attempts, "
+        "last_error = excluded.last_error, "
+        "updated = excluded.updated;");
+    query.bindValue(":station_id", m_PWSName);
+    query.bindValue(":date", mcrJob["date"]);
+    query.bindValue(":state", mcrJob["state"]);
+    query.bindValue(":attempts", mcrJob["state"] == "in_flight" ? 1 : 0);
+    query.bindValue(":last_error", mcrJob["error"]);
+    query.bindValue(":updated", mcrJob["updated"]);
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error updating \"wu_jobs\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Queue downloads that didn't finish last time
+bool WundergroundComms::ResumeJobs()
+{
+    CALL_IN("");
+
+    // In flight at the time means we crashed or were killed
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "SELECT date FROM wu_jobs "
+        "WHERE station_id = :station_id "
+        "AND (state IN ('pending', 'in_flight') "
+        "OR (state = 'failed' AND attempts < :max_attempts)) "
+        "ORDER BY date;");
+    query.bindValue(":station_id", m_PWSName);
+    query.bindValue(":max_attempts", JOB_MAX_ATTEMPTS);
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error reading \"wu_jobs\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    QStringList dates;
+    while (query.next())
+    {
+        dates << query.value(0).toString();
+    }
+    if (dates.isEmpty())
+    {
+        CALL_OUT("");
+        return true;
+    }
+
+    // Requests go out once updates are started (or more dates are queued)
+    m_DateQueue << dates;
+    m_IsQueueActive = true;
+    emit StatusUpdate(tr("Resuming %1 download(s) from the previous run: %2")
+        .arg(QString::number(dates.size()),
+             dates.join(", ")));
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Mapping of WU columns to database columns
+void WundergroundComms::Initialize_WUToDB()
+{
+    CALL_IN("");
+
+    m_WUToDB["dewptAvg"] = "dew_point_avg_c";
+    m_WUToDB["dewptHigh"] = "dew_point_high_c";
+    m_WUToDB["dewptLow"] = "dew_point_low_c";
+    m_WUToDB["epoch"] = "";
+    m_WUToDB["heatindexAvg"] = "heat_index_avg_c";
+    m_WUToDB["heatindexHigh"] = "heat_index_high_c";
+    m_WUToDB["heatindexLow"] = "heat_index_low_c";
+    m_WUToDB["humidityAvg"] = "humidity_avg_percent";
+    m_WUToDB["humidityHigh"] = "humidity_high_percent";
+    m_WUToDB["humidityLow"] = "humidity_low_percent";
+    m_WUToDB["lat"] = "latitude";
+    m_WUToDB["lon"] = "longitude";
+    m_WUToDB["obsTimeLocal"] = "date_time";
+    m_WUToDB["obsTimeUtc"] = "";
+    m_WUToDB["precipRate"] = "precipitation_rate_mm";
+    m_WUToDB["precipTotal"] = "precipitation_total_mm";
+    m_WUToDB["pressureMax"] = "pressure_max_hpa";
+    m_WUToDB["pressureMin"] = "pressure_min_hpa";
+    m_WUToDB["pressureTrend"] = "pressure_trend_hpa";
+    m_WUToDB["qcStatus"] = "";
+    m_WUToDB["solarRadiationHigh"] = "solar_radiation_high";
+    m_WUToDB["stationID"] = "station_id";
+    m_WUToDB["tempAvg"] = "temperature_avg_c";
+    m_WUToDB["tempHigh"] = "temperature_high_c";
+    m_WUToDB["tempLow"] = "temperature_low_c";
+    m_WUToDB["tz"] = "timezone";
+    m_WUToDB["uvHigh"] = "uv_high";
+    m_WUToDB["windchillAvg"] = "wind_chill_avg_c";
+    m_WUToDB["windchillHigh"] = "wind_chill_high_c";
+    m_WUToDB["windchillLow"] = "wind_chill_low_c";
+    m_WUToDB["winddirAvg"] = "wind_direction_avg_degree";
+    m_WUToDB["windgustAvg"] = "wind_gust_avg_kmh";
+    m_WUToDB["windgustHigh"] = "wind_gust_high_kmh";
+    m_WUToDB["windgustLow"] = "wind_gust_low_kmh";
+    m_WUToDB["windspeedAvg"] = "windspeed_avg_kmh";
+    m_WUToDB["windspeedHigh"] = "windspeed_high_kmh";
+    m_WUToDB["windspeedLow"] = "windspeed_low_kmh";
+
+    // Database columns
+    m_DatabaseColumns = m_WUToDB.values();
+    m_DatabaseColumns.removeAll("");
+    std::sort(m_DatabaseColumns.begin(), m_DatabaseColumns.end());
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Database columns (sorted)
+QStringList WundergroundComms::GetDatabaseColumns() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_DatabaseColumns;
+}
+
+
+
+// ====================================================================== Query
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Values of metrics in a range (cached)
+bool WundergroundComms::Query(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QString & mcrResolution,
+    QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrResolution=%5, mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             CALL_SHOW(mcrResolution)));
+
+    // Cached?
+    const QString resolution = (mcrResolution == "auto" ?
+        ChooseResolution(mcrFrom, mcrTo) : mcrResolution);
+    const QString key = QStringList({ mcrStationID,
+        QString::number(mcrFrom.toMSecsSinceEpoch()),
+        QString::number(mcrTo.toMSecsSinceEpoch()),
+        mcrMetrics.join(","),
+        resolution }).join("|");
+    {
+        QMutexLocker locker(&m_QueryCacheMutex);
+        if (m_QueryCache.contains(key))
+        {
+            mrResult = *m_QueryCache.object(key);
+            CALL_OUT("");
+            return true;
+        }
+
+        // May have been evicted
+        m_QueryCacheDays.remove(key);
+    }
+
+    // Run it
+    const bool success = RunQuery(mcrStationID, mcrFrom, mcrTo, mcrMetrics,
+        resolution, 0, nullptr, mrResult);
+    if (!success)
+    {
+        // Has been reported
+        CALL_OUT("");
+        return false;
+    }
+
+    // Days the result depends on: rollup periods may extend beyond the
+    // requested range
+    const QTimeZone time_zone = GetStationTimeZone(mcrStationID);
+    QDate first_day = mcrFrom.toTimeZone(time_zone).date();
+    QDate last_day = mcrTo.toTimeZone(time_zone).addSecs(-1).date();
+    if (resolution == "monthly")
+    {
+        first_day = QDate(first_day.year(), first_day.month(), 1);
+        last_day = QDate(last_day.year(), last_day.month(), 1)
+            .addMonths(1).addDays(-1);
+    }
+    QMutexLocker locker(&m_QueryCacheMutex);
+    m_QueryCache.insert(key, new QueryResult(mrResult), mrResult.GetCost());
+    m_QueryCacheDays[key] = QStringList({ mcrStationID,
+        first_day.toString("yyyy-MM-dd"),
+        last_day.toString("yyyy-MM-dd") });
+
+    // Forget days of results the insert has evicted
+    for (auto days_iterator = m_QueryCacheDays.begin();
+         days_iterator != m_QueryCacheDays.end();)
+    {
+        if (m_QueryCache.contains(days_iterator.key()))
+        {
+            days_iterator++;
+        } else
+        {
+            days_iterator = m_QueryCacheDays.erase(days_iterator);
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Values of metrics in a range, in chunks
+bool WundergroundComms::Query(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QString & mcrResolution,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrResolution=%5, mcChunkSize=%6, mcrCallback=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             CALL_SHOW(mcrResolution),
+             CALL_SHOW(mcChunkSize)));
+
+    // Check chunk size
+    if (mcChunkSize < 1)
+    {
+        const QString reason = tr("Invalid chunk size %1.")
+            .arg(QString::number(mcChunkSize));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    const QString resolution = (mcrResolution == "auto" ?
+        ChooseResolution(mcrFrom, mcrTo) : mcrResolution);
+    QueryResult chunk;
+    const bool success = RunQuery(mcrStationID, mcrFrom, mcrTo, mcrMetrics,
+        resolution, mcChunkSize, mcrCallback, chunk);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Run query
+bool WundergroundComms::RunQuery(const QString & mcrStationID,
+    const QDateTime & mcrFrom, const QDateTime & mcrTo,
+    const QStringList & mcrMetrics, const QString & mcrResolution,
+    const int mcChunkSize,
+    const std::function < bool (const QueryResult &) > & mcrCallback,
+    QueryResult & mrResult)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrFrom=%2, mcrTo=%3, mcrMetrics=%4, "
+        "mcrResolution=%5, mcChunkSize=%6, mcrCallback=..., mrResult=...")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrMetrics),
+             CALL_SHOW(mcrResolution),
+             CALL_SHOW(mcChunkSize)));
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason =
+            tr("Cannot run query; database has not been connected.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Metrics go into the SQL, so they must be known columns
+    const QStringList known_metrics = GetMetricColumns();
+    for (const QString & metric : mcrMetrics)
+    {
+        if (!known_metrics.contains(metric))
+        {
+            const QString reason = tr("Unknown metric \"%1\".").arg(metric);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+    if (mcrMetrics.isEmpty())
+    {
+        const QString reason = tr("No metrics requested.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Connection for this thread
+    const QSqlDatabase db = GetConnection();
+    if (!db.isOpen())
+    {
+        const QString reason = tr("No database connection for query.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Range in station time
+    const QTimeZone time_zone = GetStationTimeZone(mcrStationID);
+    const QDateTime from = mcrFrom.toTimeZone(time_zone);
+    const QDateTime to = mcrTo.toTimeZone(time_zone);
+    if (mcrResolution == "raw" &&
+        IsArchived(mcrStationID, from, to, mcrMetrics))
+    {
+        // Served from archives
+        const bool success = RunArchiveQuery(mcrStationID, from, to,
+            mcrMetrics, time_zone, mcChunkSize, mcrCallback, mrResult);
+        CALL_OUT("");
+        return success;
+    }
+    if (mcrResolution == "raw")
+    {
+        // Observations come from the storage backend (SQLite: only the
+        // partitions the range touches)
+        const bool success = m_Storage -> QueryRange(mcrStationID, from, to,
+            mcrMetrics, time_zone, mcChunkSize, mcrCallback, mrResult);
+        CALL_OUT("");
+        return success;
+    }
+
+    // Rollups
+    const QString format = PeriodFormat(mcrResolution);
+    if (format.isEmpty())
+    {
+        const QString reason = tr("Unknown resolution \"%1\".")
+            .arg(mcrResolution);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    QStringList columns;
+    for (const QString & metric : mcrMetrics)
+    {
+        columns << metric
+            << metric + "_min"
+            << metric + "_max"
+            << metric + "_count";
+    }
+    mrResult.SetColumns(columns);
+
+    // Every period that overlaps the range
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        QString("SELECT period, metric, count, min, max, sum "
+            "FROM wu_rollup_%1 "
+            "WHERE station_id = :station_id "
+            "AND period >= :from AND period <= :to "
+            "AND metric IN ('%2') "
+            "ORDER BY period;")
+            .arg(mcrResolution,
+                 mcrMetrics.join("', '")),
+        db);
+    query.bindValue(":station_id", mcrStationID);
+    query.bindValue(":from", from.toString(format));
+    query.bindValue(":to", to.addSecs(-1).toString(format));
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__, db))
+    {
+        const QString reason = tr("SQL error running query");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Collect rows
+    const int num_columns = mrResult.GetColumns().size();
+    QVector < double > values(num_columns, qQNaN());
+    QString current_period;
+    bool keep_going = true;
+    while (keep_going &&
+        query.next())
+    {
+        // Rows of a period come one metric after the other
+        const QString period = query.value(0).toString();
+        if (period != current_period)
+        {
+            if (!current_period.isEmpty())
+            {
+                const QDateTime time =
+                    QDateTime::fromString(current_period, format);
+                mrResult.Append(
+                    QDateTime(time.date(), time.time(), time_zone),
+                    values);
+                values.fill(qQNaN());
+            }
+            current_period = period;
+        }
+        const int index = 4 * mcrMetrics.indexOf(query.value(1).toString());
+        const double count = query.value(2).toDouble();
+        values[index] = query.value(5).toDouble() / count;
+        values[index + 1] = query.value(3).toDouble();
+        values[index + 2] = query.value(4).toDouble();
+        values[index + 3] = count;
+
+        // Hand over a full chunk
+        if (mcChunkSize > 0 &&
+            mrResult.Size() >= mcChunkSize)
+        {
+            keep_going = mcrCallback(mrResult);
+            mrResult.Clear();
+        }
+    }
+    if (keep_going &&
+        !current_period.isEmpty())
+    {
+        const QDateTime time = QDateTime::fromString(current_period, format);
+        mrResult.Append(QDateTime(time.date(), time.time(), time_zone),
+            values);
+    }
+    if (keep_going &&
+        mcChunkSize > 0 &&
+        mrResult.Size() > 0)
+    {
+        mcrCallback(mrResult);
+        mrResult.Clear();
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Resolution for "auto"
+QString WundergroundComms::ChooseResolution(const QDateTime & mcrFrom,
+    const QDateTime & mcrTo)
+{
+    CALL_IN(QString("mcrFrom=%1, mcrTo=%2")
+        .arg(CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo)));
+
+    // Aim for a few hundred to a few thousand rows
+    const qint64 days = mcrFrom.daysTo(mcrTo);
+    QString resolution;
+    if (days <= 3)
+    {
+        resolution = "raw";
+    } else if (days <= 90)
+    {
+        resolution = "hourly";
+    } else if (days <= 5*366)
+    {
+        resolution = "daily";
+    } else
+    {
+        resolution = "monthly";
+    }
+
+    CALL_OUT("");
+    return resolution;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Period format of a rollup resolution
+QString WundergroundComms::PeriodFormat(const QString & mcrResolution)
+{
+    CALL_IN(QString("mcrResolution=%1")
+        .arg(CALL_SHOW(mcrResolution)));
+
+    static const QHash < QString, QString > formats = {
+        { "hourly", "yyyy-MM-dd hh" },
+        { "daily", "yyyy-MM-dd" },
+        { "monthly", "yyyy-MM" } };
+
+    CALL_OUT("");
+    return formats.value(mcrResolution);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Connection for the calling thread
+QSqlDatabase WundergroundComms::GetConnection() const
+{
+    CALL_IN("");
+
+    // The default connection belongs to the thread the engine lives in
+    if (QThread::currentThread() == thread())
+    {
+        CALL_OUT("");
+        return QSqlDatabase::database();
+    }
+
+    CALL_OUT("");
+    return DatabaseHelper::GetReadConnection(m_DatabaseFilename);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time zone of a station
+QTimeZone WundergroundComms::GetStationTimeZone(const QString & mcrStationID)
+{
+    CALL_IN(QString("mcrStationID=%1")
+        .arg(CALL_SHOW(mcrStationID)));
+
+    // Known already
+    QMutexLocker locker(&m_StationTimeZonesMutex);
+    if (m_StationTimeZones.contains(mcrStationID))
+    {
+        CALL_OUT("");
+        return m_StationTimeZones[mcrStationID];
+    }
+
+    // WU sends the IANA name (e.g. "Europe/Berlin") with every observation
+    const QString time_zone_name = m_Storage -> GetTimeZone(mcrStationID);
+    QTimeZone time_zone;
+    if (!time_zone_name.isEmpty())
+    {
+        time_zone = QTimeZone(time_zone_name.toUtf8());
+    }
+    if (!time_zone.isValid())
+    {
+        // No data yet (or unknown zone); assume the station is where we are
+        time_zone = QTimeZone::systemTimeZone();
+    } else
+    {
+        m_StationTimeZones[mcrStationID] = time_zone;
+    }
+
+    CALL_OUT("");
+    return time_zone;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Drop cached results that cover a day
+void WundergroundComms::InvalidateQueryCache(const QString & mcrStationID,
+    const QString & mcrDate)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrDate=%2")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrDate)));
+
+    // Dates are yyyy-MM-dd, so they can be compared as strings
+    QMutexLocker locker(&m_QueryCacheMutex);
+    for (auto days_iterator = m_QueryCacheDays.begin();
+         days_iterator != m_QueryCacheDays.end();)
+    {
+        const QStringList & days = days_iterator.value();
+        if (!m_QueryCache.contains(days_iterator.key()))
+        {
+            // Evicted in the meantime
+            days_iterator = m_QueryCacheDays.erase(days_iterator);
+        } else if (days[0] == mcrStationID &&
+            days[1] <= mcrDate &&
+            days[2] >= mcrDate)
+        {
+            m_QueryCache.remove(days_iterator.key());
+            days_iterator = m_QueryCacheDays.erase(days_iterator);
+        } else
+        {
+            days_iterator++;
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// ======================================================================= Days
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read content hashes of all days
+bool WundergroundComms::ReadDayHashes()
+{
+    CALL_IN("");
+
+    // Observations kept in memory are gone, so every day has to be
+    // downloaded again
+    if (m_StorageBackendName == "memory")
+    {
+        CALL_OUT("");
+        return true;
+    }
+
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "SELECT date, content_hash FROM wu_days "
+        "WHERE station_id = :station_id;");
+    query.bindValue(":station_id", m_PWSName);
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error reading \"wu_days\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    while (query.next())
+    {
+        m_DayHashes[query.value(0).toString()] = query.value(1).toString();
+    }
+
     CALL_OUT("");
+    return true;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Mapping of WU columns to database columns
-void WundergroundComms::Initialize_WUToDB()
+// Hash of a day's observations
+QString WundergroundComms::DayContentHash(const QJsonArray & mcrObservations)
+{
+    CALL_IN(QString("mcrObservations=%1")
+        .arg(CALL_SHOW(mcrObservations)));
+
+    // QJsonObject keeps its keys sorted, so the compact JSON is a normalized
+    // form of the observations - and it's much cheaper than parsing them.
+    const QByteArray normalized =
+        QJsonDocument(mcrObservations).toJson(QJsonDocument::Compact);
+    const QString hash = QString::fromLatin1(
+        QCryptographicHash::hash(normalized, QCryptographicHash::Sha1)
+            .toHex());
+
+    CALL_OUT("");
+    return hash;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Record new content of a day
+void WundergroundComms::UpdateDay(const QString & mcrDate,
+    const QString & mcrContentHash, const int mcNumObservations)
+{
+    CALL_IN(QString("mcrDate=%1, mcrContentHash=%2, mcNumObservations=%3")
+        .arg(CALL_SHOW(mcrDate),
+             CALL_SHOW(mcrContentHash),
+             CALL_SHOW(mcNumObservations)));
+
+    QHash < QString, QString > day;
+    day["date"] = mcrDate;
+    day["content_hash"] = mcrContentHash;
+    day["observations"] = QString::number(mcNumObservations);
+    day["updated"] =
+        QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    m_DayUpdates << day;
+    m_DayHashes[mcrDate] = mcrContentHash;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write one day update
+bool WundergroundComms::SaveDayToDatabase(
+    const QHash < QString, QString > & mcrDay)
+{
+    CALL_IN(QString("mcrDay=%1")
+        .arg(CALL_SHOW(mcrDay)));
+
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "INSERT OR REPLACE INTO wu_days "
+        "(station_id, date, observations, content_hash, updated) "
+        "VALUES (:station_id, :date, :observations, :content_hash, "
+        ":updated);");
+    query.bindValue(":station_id", m_PWSName);
+    query.bindValue(":date", mcrDay["date"]);
+    query.bindValue(":observations", mcrDay["observations"].toInt());
+    query.bindValue(":content_hash", mcrDay["content_hash"]);
+    query.bindValue(":updated", mcrDay["updated"]);
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error updating \"wu_days\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// ================================================================== Revisions
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Set revision mode
+void WundergroundComms::SetRevisionMode(const bool mcIsRevisionMode)
+{
+    CALL_IN(QString("mcIsRevisionMode=%1")
+        .arg(CALL_SHOW(mcIsRevisionMode)));
+
+    m_IsRevisionMode = mcIsRevisionMode;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Get revision mode
+bool WundergroundComms::GetRevisionMode() const
 {
     CALL_IN("");
+    CALL_OUT("");
+    return m_IsRevisionMode;
+}
 
-    m_WUToDB["dewptAvg"] = "dew_point_avg_c";
-    m_WUToDB["dewptHigh"] = "dew_point_high_c";
-    m_WUToDB["dewptLow"] = "dew_point_low_c";
-    m_WUToDB["epoch"] = "";
-    m_WUToDB["heatindexAvg"] = "heat_index_avg_c";
-    m_WUToDB["heatindexHigh"] = "heat_index_high_c";
-    m_WUToDB["heatindexLow"] = "heat_index_low_c";
-    m_WUToDB["humidityAvg"] = "humidity_avg_percent";
-    m_WUToDB["humidityHigh"] = "humidity_high_percent";
-    m_WUToDB["humidityLow"] = "humidity_low_percent";
-    m_WUToDB["lat"] = "latitude";
-    m_WUToDB["lon"] = "longitude";
-    m_WUToDB["obsTimeLocal"] = "date_time";
-    m_WUToDB["obsTimeUtc"] = "";
-    m_WUToDB["precipRate"] = "precipitation_rate_mm";
-    m_WUToDB["precipTotal"] = "precipitation_total_mm";
-    m_WUToDB["pressureMax"] = "pressure_max_hpa";
-    m_WUToDB["pressureMin"] = "pressure_min_hpa";
-    m_WUToDB["pressureTrend"] = "pressure_trend_hpa";
-    m_WUToDB["qcStatus"] = "";
-    m_WUToDB["solarRadiationHigh"] = "solar_radiation_high";
-    m_WUToDB["stationID"] = "station_id";
-    m_WUToDB["tempAvg"] = "temperature_avg_c";
-    m_WUToDB["tempHigh"] = "temperature_high_c";
-    m_WUToDB["tempLow"] = "temperature_low_c";
-    m_WUToDB["tz"] = "timezone";
-    m_WUToDB["uvHigh"] = "uv_high";
-    m_WUToDB["windchillAvg"] = "wind_chill_avg_c";
-    m_WUToDB["windchillHigh"] = "wind_chill_high_c";
-    m_WUToDB["windchillLow"] = "wind_chill_low_c";
-    m_WUToDB["winddirAvg"] = "wind_direction_avg_degree";
-    m_WUToDB["windgustAvg"] = "wind_gust_avg_kmh";
-    m_WUToDB["windgustHigh"] = "wind_gust_high_kmh";
-    m_WUToDB["windgustLow"] = "wind_gust_low_kmh";
-    m_WUToDB["windspeedAvg"] = "windspeed_avg_kmh";
-    m_WUToDB["windspeedHigh"] = "windspeed_high_kmh";
-    m_WUToDB["windspeedLow"] = "windspeed_low_kmh";
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compare a known observation with what WU sent; queue changes
+void WundergroundComms::Revise(QHash < QString, QString > & mrKnown,
+    const QHash < QString, QString > & mcrObservation)
+{
+    CALL_IN(QString("mrKnown=%1, mcrObservation=%2")
+        .arg(CALL_SHOW(mrKnown),
+             CALL_SHOW(mcrObservation)));
+
+    // Only columns WU actually sent are compared
+    const QString station_id = mrKnown["station_id"];
+    const QString date_time = mrKnown["date_time"];
+    const QString now =
+        QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    QHash < QString, QString > revision;
+    for (auto value_iterator = mcrObservation.constBegin();
+         value_iterator != mcrObservation.constEnd();
+         value_iterator++)
+    {
+        const QString & column = value_iterator.key();
+        const QString & new_value = value_iterator.value();
+        const QString old_value = mrKnown.value(column);
+        if (old_value == new_value)
+        {
+            continue;
+        }
+
+        QHash < QString, QString > log_entry;
+        log_entry["station_id"] = station_id;
+        log_entry["date_time"] = date_time;
+        log_entry["column"] = column;
+        log_entry["old_value"] = old_value;
+        log_entry["new_value"] = new_value;
+        log_entry["revised"] = now;
+        m_RevisionLog << log_entry;
+
+        revision[column] = new_value;
+        mrKnown[column] = new_value;
+    }
+
+    // Nothing changed
+    if (revision.isEmpty())
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    revision["station_id"] = station_id;
+    revision["date_time"] = date_time;
+    m_RevisionQueue << revision;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update changed columns of observations
+bool WundergroundComms::UpdateInDatabase(
+    const QList < QHash < QString, QString > > & mcrRevisions)
+{
+    CALL_IN(QString("mcrRevisions=<%1 revisions>")
+        .arg(QString::number(mcrRevisions.size())));
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason = tr("Cannot update observations in database; "
+            "it has not been connected yet.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // All of them in one batch
+    if (!m_Storage -> ReviseBatch(mcrRevisions))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Log one revision
+bool WundergroundComms::SaveRevisionToDatabase(
+    const QHash < QString, QString > & mcrRevision)
+{
+    CALL_IN(QString("mcrRevision=%1")
+        .arg(CALL_SHOW(mcrRevision)));
+
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "INSERT INTO wu_revisions "
+        "(station_id, date_time, column_name, old_value, new_value, "
+        "revised) VALUES (:station_id, :date_time, :column, :old_value, "
+        ":new_value, :revised);");
+    query.bindValue(":station_id", mcrRevision["station_id"]);
+    query.bindValue(":date_time", mcrRevision["date_time"]);
+    query.bindValue(":column", mcrRevision["column"]);
+    query.bindValue(":old_value", mcrRevision["old_value"]);
+    query.bindValue(":new_value", mcrRevision["new_value"]);
+    query.bindValue(":revised", mcrRevision["revised"]);
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error adding to \"wu_revisions\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// ==================================================================== Rollups
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Numeric columns
+QStringList WundergroundComms::GetMetricColumns() const
+{
+    CALL_IN("");
+
+    QStringList metrics = GetDatabaseColumns();
+    metrics.removeAll("station_id");
+    metrics.removeAll("timezone");
+    metrics.removeAll("date_time");
+
+    CALL_OUT("");
+    return metrics;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recompute hourly and daily rollups of a day
+bool WundergroundComms::UpdateRollups(const QString & mcrStationID,
+    const QString & mcrDate)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrDate=%2")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrDate)));
+
+    // Periods of the day: "yyyy-MM-dd hh" and "yyyy-MM-dd"
+    const QString next_date = QDate::fromString(mcrDate, "yyyy-MM-dd")
+        .addDays(1).toString("yyyy-MM-dd");
+    const QStringList resolutions = { "hourly", "daily" };
+    for (const QString & resolution : resolutions)
+    {
+        QSqlQuery & delete_query = DatabaseHelper::PreparedQuery(
+            QString("DELETE FROM wu_rollup_%1 "
+                "WHERE station_id = :station_id "
+                "AND period >= :from AND period < :to;")
+                .arg(resolution));
+        delete_query.bindValue(":station_id", mcrStationID);
+        delete_query.bindValue(":from", mcrDate);
+        delete_query.bindValue(":to", next_date);
+        if (!DatabaseHelper::Exec(delete_query, __FILE__, __LINE__))
+        {
+            const QString reason =
+                tr("SQL error clearing \"wu_rollup_%1\"").arg(resolution);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+
+    // Hours from the storage backend's observations (station time as UTC,
+    // so times are the station's as they are)
+    const QDate date = QDate::fromString(mcrDate, "yyyy-MM-dd");
+    const QStringList metrics = GetMetricColumns();
+    QueryResult observations;
+    if (!m_Storage -> QueryRange(mcrStationID,
+        QDateTime(date, QTime(0, 0), QTimeZone::UTC),
+        QDateTime(date.addDays(1), QTime(0, 0), QTimeZone::UTC),
+        metrics, QTimeZone::UTC, 0, nullptr, observations))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+    QStringList hours;
+    for (const QDateTime & time : observations.GetTimes())
+    {
+        hours << time.toString("yyyy-MM-dd hh");
+    }
+
+    // Count, minimum, maximum and sum of the values per metric and hour
+    // (hours without values have no row, just like the SQL rollups)
+    QSqlQuery & hourly_query = DatabaseHelper::PreparedQuery(
+        "INSERT INTO wu_rollup_hourly "
+        "(station_id, period, metric, count, min, max, sum) "
+        "VALUES (:station_id, :period, :metric, :count, :min, :max, :sum);");
+    for (const QString & metric : metrics)
+    {
+        const QVector < double > & values = observations.GetColumn(metric);
+        int row = 0;
+        while (row < values.size())
+        {
+            const QString & hour = hours[row];
+            int count = 0;
+            double min = 0;
+            double max = 0;
+            double sum = 0;
+            for (; row < values.size() && hours[row] == hour; row++)
+            {
+                if (qIsNaN(values[row]))
+                {
+                    continue;
+                }
+                min = (count == 0 ? values[row] : qMin(min, values[row]));
+                max = (count == 0 ? values[row] : qMax(max, values[row]));
+                sum += values[row];
+                count++;
+            }
+            if (count == 0)
+            {
+                continue;
+            }
+            hourly_query.bindValue(":station_id", mcrStationID);
+            hourly_query.bindValue(":period", hour);
+            hourly_query.bindValue(":metric", metric);
+            hourly_query.bindValue(":count", count);
+            hourly_query.bindValue(":min", min);
+            hourly_query.bindValue(":max", max);
+            hourly_query.bindValue(":sum", sum);
+            if (!DatabaseHelper::Exec(hourly_query, __FILE__, __LINE__))
+            {
+                const QString reason =
+                    tr("SQL error updating \"wu_rollup_hourly\"");
+                MessageLogger::Error(CALL_METHOD, reason);
+                CALL_OUT(reason);
+                return false;
+            }
+        }
+    }
+
+    // Day from hours
+    QSqlQuery & daily_query = DatabaseHelper::PreparedQuery(
+        "INSERT INTO wu_rollup_daily "
+        "(station_id, period, metric, count, min, max, sum) "
+        "SELECT station_id, substr(period, 1, 10), metric, sum(count), "
+        "min(min), max(max), sum(sum) FROM wu_rollup_hourly "
+        "WHERE station_id = :station_id "
+        "AND period >= :from AND period < :to "
+        "GROUP BY station_id, substr(period, 1, 10), metric;");
+    daily_query.bindValue(":station_id", mcrStationID);
+    daily_query.bindValue(":from", mcrDate);
+    daily_query.bindValue(":to", next_date);
+    if (!DatabaseHelper::Exec(daily_query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error updating \"wu_rollup_daily\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recompute monthly rollup from daily rollups
+bool WundergroundComms::UpdateMonthlyRollup(const QString & mcrStationID,
+    const QString & mcrMonth)
+{
+    CALL_IN(QString("mcrStationID=%1, mcrMonth=%2")
+        .arg(CALL_SHOW(mcrStationID),
+             CALL_SHOW(mcrMonth)));
+
+    QSqlQuery & delete_query = DatabaseHelper::PreparedQuery(
+        "DELETE FROM wu_rollup_monthly "
+        "WHERE station_id = :station_id AND period = :month;");
+    delete_query.bindValue(":station_id", mcrStationID);
+    delete_query.bindValue(":month", mcrMonth);
+    if (!DatabaseHelper::Exec(delete_query, __FILE__, __LINE__))
+    {
+        const QString reason = tr("SQL error clearing \"wu_rollup_monthly\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // "yyyy-MM" sorts before all days of the month, "yyyy-MM~" after them
+    QSqlQuery & query = DatabaseHelper::PreparedQuery(
+        "INSERT INTO wu_rollup_monthly "
+        "(station_id, period, metric, count, min, max, sum) "
+        "SELECT station_id, substr(period, 1, 7), metric, sum(count), "
+        "min(min), max(max), sum(sum) FROM wu_rollup_daily "
+        "WHERE station_id = :station_id "
+        "AND period > :from AND period < :to "
+        "GROUP BY station_id, substr(period, 1, 7), metric;");
+    query.bindValue(":station_id", mcrStationID);
+    query.bindValue(":from", mcrMonth);
+    query.bindValue(":to", mcrMonth + "~");
+    if (!DatabaseHelper::Exec(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error updating \"wu_rollup_monthly\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recompute all rollups from the observations
+bool WundergroundComms::RebuildRollups(const int mcThreads)
+{
+    CALL_IN(QString("mcThreads=%1")
+        .arg(CALL_SHOW(mcThreads)));
+
+    // Check if database has been connected
+    if (!m_DatabaseConnected)
+    {
+        const QString reason = tr("Cannot rebuild rollups; "
+            "database has not been connected.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Builders read "wu_data" and its partitions on their own connections
+    if (!CheckSqliteStorage(tr("Rebuilding rollups")))
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Pending writes would be missing from the rollups
+    if (!FlushWriteQueue())
+    {
+        // Has been reported.
+        CALL_OUT("");
+        return false;
+    }
+
+    // One work package per station and month (main table and partitions)
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery query;
+    QSet < QPair < QString, QString > > station_months;
+    const QStringList partitions =
+        QStringList({ QString() }) + GetPartitions(QString());
+    for (const QString & partition : partitions)
+    {
+        const QString table = GetPartitionTable(partition);
+        query.exec(QString("SELECT DISTINCT station_id, "
+            "substr(date_time, 1, 7) FROM %1;")
+            .arg(table));
+        if (table.isEmpty() ||
+            DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+        {
+            const QString reason = tr("SQL error reading \"%1\"")
+                .arg(table);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        while (query.next())
+        {
+            station_months += qMakePair(query.value(0).toString(),
+                query.value(1).toString());
+        }
+    }
+    const QStringList metrics = GetMetricColumns();
+    QList < RollupBuilder * > builders;
+    for (const QPair < QString, QString > & month : station_months)
+    {
+        RollupBuilder * builder = new RollupBuilder(m_DatabaseFilename,
+            month.first, month.second, metrics);
+
+        // Builders attach the month's partition to their own connection
+        const QStringList month_partitions = GetPartitions(month.first,
+            month.second.left(4).toInt(), month.second.left(4).toInt());
+        QHash < QString, QString > attachments;
+        for (const QString & partition : month_partitions)
+        {
+            attachments[PartitionSchema(partition)] =
+                GetPartitionFilename(partition);
+        }
+        builder -> SetDataSource(DataSourceSQL(month_partitions),
+            attachments);
+        builders << builder;
+    }
+
+    // Aggregate in parallel; each builder has its own connection
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, mcThreads));
+    for (RollupBuilder * builder : builders)
+    {
+        pool.start(builder);
+    }
+    pool.waitForDone();
+
+    // Write results (SQLite has a single writer anyway)
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    bool success = true;
+    const QStringList resolutions = { "hourly", "daily", "monthly" };
+    for (const QString & resolution : resolutions)
+    {
+        query.exec(QString("DELETE FROM wu_rollup_%1;").arg(resolution));
+        success = success &&
+            !DatabaseHelper::HasSQLError(query, __FILE__, __LINE__);
+    }
+    QSqlQuery & insert_query = DatabaseHelper::PreparedQuery(
+        "INSERT INTO wu_rollup_hourly "
+        "(station_id, period, metric, count, min, max, sum) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?);");
+    int hourly_rows = 0;
+    for (RollupBuilder * builder : builders)
+    {
+        if (!builder -> GetError().isEmpty())
+        {
+            MessageLogger::Error(CALL_METHOD, builder -> GetError());
+            success = false;
+        }
+        for (const QVariantList & row : builder -> GetResults())
+        {
+            if (!success)
+            {
+                break;
+            }
+            for (int column = 0; column < row.size(); column++)
+            {
+                insert_query.bindValue(column, row[column]);
+            }
+            success = DatabaseHelper::Exec(insert_query, __FILE__, __LINE__);
+            hourly_rows++;
+        }
+    }
+    qDeleteAll(builders);
+    query.exec("INSERT INTO wu_rollup_daily "
+        "(station_id, period, metric, count, min, max, sum) "
+        "SELECT station_id, substr(period, 1, 10), metric, sum(count), "
+        "min(min), max(max), sum(sum) FROM wu_rollup_hourly "
+        "GROUP BY station_id, substr(period, 1, 10), metric;");
+    success = success &&
+        !DatabaseHelper::HasSQLError(query, __FILE__, __LINE__);
+    query.exec("INSERT INTO wu_rollup_monthly "
+        "(station_id, period, metric, count, min, max, sum) "
+        "SELECT station_id, substr(period, 1, 7), metric, sum(count), "
+        "min(min), max(max), sum(sum) FROM wu_rollup_daily "
+        "GROUP BY station_id, substr(period, 1, 7), metric;");
+    success = success &&
+        !DatabaseHelper::HasSQLError(query, __FILE__, __LINE__);
+    if (!success ||
+        !db.commit())
+    {
+        db.rollback();
+        const QString reason = tr("Could not rebuild rollups.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    emit StatusUpdate(tr("Rebuilt rollups: %1 hourly values in %2 months "
+        "(%3 ms, %4 threads)")
+        .arg(QString::number(hourly_rows),
+             QString::number(builders.size()),
+             QString::number(timer.elapsed()),
+             QString::number(pool.maxThreadCount())));
 
     CALL_OUT("");
+    return true;
 }
 
 
@@ -671,6 +3359,9 @@ void WundergroundComms::StartUpdates()
             .arg(m_StartDateTime.toString("dd MMM yyyy, hh:mm:ss"));
     emit StatusUpdate(message);
 
+    // Downloads resumed from the previous run
+    IssueQueuedRequests();
+
     CALL_OUT("");
 }
 
@@ -725,6 +3416,167 @@ QString WundergroundComms::GetUptime() const
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Graceful shutdown
+void WundergroundComms::Shutdown()
+{
+    CALL_IN("");
+
+    // Check if we're already shutting down
+    if (m_IsShuttingDown)
+    {
+        const QString reason = tr("Already shutting down.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+    m_IsShuttingDown = true;
+    m_ShutdownTimer.start();
+
+    // No more periodic updates
+    m_UpdateTimer -> stop();
+    if (m_IsRunning)
+    {
+        StopUpdates();
+    }
+
+    // Queued dates are pending in "wu_jobs" and will be resumed next time
+    if (!m_DateQueue.isEmpty())
+    {
+        const QString message =
+            tr("Shutting down; %1 queued date(s) will be downloaded on the "
+                "next start: %2")
+                .arg(QString::number(m_DateQueue.size()),
+                     m_DateQueue.join(", "));
+        emit StatusUpdate(message);
+        m_DateQueue.clear();
+        m_IsQueueActive = false;
+    }
+    m_ShutdownTime_Scheduler = m_ShutdownTimer.elapsed();
+
+    // Wait for requests in flight (HandleResponse() finishes the job), but
+    // not forever
+    if (!m_RepliesInFlight.isEmpty())
+    {
+        const QString message =
+            tr("Shutting down; waiting up to %1 s for %2 request(s) "
+                "in flight.")
+                .arg(QString::number(SHUTDOWN_TIMEOUT/1000),
+                     QString::number(m_RepliesInFlight.size()));
+        emit StatusUpdate(message);
+        QTimer::singleShot(SHUTDOWN_TIMEOUT,
+            this, &WundergroundComms::ShutdownTimeout);
+        CALL_OUT("");
+        return;
+    }
+
+    FinishShutdown();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if we're shutting down
+bool WundergroundComms::IsShuttingDown() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_IsShuttingDown;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Requests in flight took too long
+void WundergroundComms::ShutdownTimeout()
+{
+    CALL_IN("");
+
+    // Everything may have finished in time
+    if (m_IsShutdownFinished)
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    const QString message =
+        tr("Shutting down; giving up on %1 request(s) in flight.")
+            .arg(QString::number(m_RepliesInFlight.size()));
+    emit StatusUpdate(message);
+
+    // Aborted replies come back through HandleResponse() as errors
+    const QList < QNetworkReply * > replies = m_RepliesInFlight.values();
+    for (QNetworkReply * reply : replies)
+    {
+        reply -> abort();
+    }
+
+    FinishShutdown();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Nothing in flight anymore; write everything and close database
+void WundergroundComms::FinishShutdown()
+{
+    CALL_IN("");
+
+    // May be called from the last response and from the timeout
+    if (m_IsShutdownFinished)
+    {
+        CALL_OUT("");
+        return;
+    }
+    m_IsShutdownFinished = true;
+    const qint64 time_requests = m_ShutdownTimer.elapsed();
+
+    // Final transaction, then get the WAL into the database file
+    qint64 time_writes = time_requests;
+    qint64 time_checkpoint = time_requests;
+    if (m_DatabaseConnected)
+    {
+        const int num_queued = m_WriteQueue.size();
+        if (!FlushWriteQueue())
+        {
+            const QString reason =
+                tr("%1 observation(s) could not be written while shutting "
+                    "down.")
+                    .arg(QString::number(num_queued));
+            MessageLogger::Error(CALL_METHOD, reason);
+        }
+        time_writes = m_ShutdownTimer.elapsed();
+
+        // Open statements would keep the checkpoint from truncating the WAL
+        DatabaseHelper::ClearPreparedQueries();
+        CheckpointDatabase();
+        time_checkpoint = m_ShutdownTimer.elapsed();
+
+        QSqlDatabase::database().close();
+        m_DatabaseConnected = false;
+    }
+
+    const QString message =
+        tr("Shutdown complete in %1 ms (scheduler %2 ms, requests in flight "
+            "%3 ms, writes %4 ms, checkpoint %5 ms).")
+            .arg(QString::number(m_ShutdownTimer.elapsed()),
+                 QString::number(m_ShutdownTime_Scheduler),
+                 QString::number(time_requests - m_ShutdownTime_Scheduler),
+                 QString::number(time_writes - time_requests),
+                 QString::number(time_checkpoint - time_writes));
+    emit StatusUpdate(message);
+    emit ShutdownComplete();
+
+    CALL_OUT("");
+}
+
+
+
 // ==================================================== Reading from the Server
 
 
@@ -767,9 +3619,11 @@ void WundergroundComms::Periodic_GetUpdates()
         break;
     }
 
-    // Try again in a bit
-    QTimer::singleShot(CHECK_FOR_UPDATES_DELAY,
-        this, &WundergroundComms::Periodic_GetUpdates);
+    // Try again in a bit (unless we're on our way out)
+    if (!m_IsShuttingDown)
+    {
+        m_UpdateTimer -> start();
+    }
 
     CALL_OUT("");
 }
@@ -785,6 +3639,16 @@ void WundergroundComms::GetDate(const QString & mcrDate)
 
     // Downloads will occur regardless of regular updates being paused.
 
+    // No new downloads while shutting down
+    if (m_IsShuttingDown)
+    {
+        const QString reason = tr("Shutting down; not downloading %1.")
+            .arg(mcrDate);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
     // Check if PWS name is set
     if (m_PWSName.isEmpty())
     {
@@ -812,6 +3676,16 @@ void WundergroundComms::GetDate(const QString & mcrDate)
         return;
     }
 
+    // Without the known observations in memory, we'd store duplicates
+    if (!m_DataRead)
+    {
+        const QString reason =
+            tr("Database has been opened without reading its data.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
     // Trigger download
     QString url = QString("https://api.weather.com/v2/pws/history/all?"
         "stationId=%1&"
@@ -827,7 +3701,13 @@ void WundergroundComms::GetDate(const QString & mcrDate)
     void finished(QNetworkReply * mpResponse);
     void readyRead(QNetworkReply * mpResponse);
     request.setUrl(url);
-    m_NetworkAccessManager -> get(request);
+    QNetworkReply * reply = m_NetworkAccessManager -> get(request);
+    reply -> setProperty("date", mcrDate);
+    m_RepliesInFlight += reply;
+
+    // Remember we're working on it
+    UpdateJob(mcrDate, "in_flight");
+    FlushWriteQueue();
 
     CALL_OUT("");
 }
@@ -837,6 +3717,167 @@ void WundergroundComms::GetDate(const QString & mcrDate)
 ///////////////////////////////////////////////////////////////////////////////
 // Handle response
 bool WundergroundComms::HandleResponse(QNetworkReply * mpResponse)
+{
+    CALL_IN(QString("mpResponse=%1")
+        .arg(CALL_SHOW(mpResponse)));
+
+    // Request is no longer in flight
+    m_RepliesInFlight.remove(mpResponse);
+    mpResponse -> deleteLater();
+
+    // Process it and write the day's observations together with the job
+    // state in one go
+    const QString date = mpResponse -> property("date").toString();
+    bool success = ProcessResponse(mpResponse);
+    if (success)
+    {
+        UpdateJob(date, "done");
+    } else if (m_IsShuttingDown &&
+        mpResponse -> error() == QNetworkReply::OperationCanceledError)
+    {
+        // Aborted while shutting down; try again next time
+        UpdateJob(date, "pending");
+    } else
+    {
+        const QString error =
+            (mpResponse -> error() != QNetworkReply::NoError ?
+                mpResponse -> errorString() : tr("Invalid response"));
+        UpdateJob(date, "failed", error);
+    }
+    success = FlushWriteQueue() && success;
+    if (!success)
+    {
+        emit DownloadFailed(date);
+    }
+
+    // Last outstanding request while shutting down
+    if (m_IsShuttingDown)
+    {
+        if (m_RepliesInFlight.isEmpty() &&
+            !m_IsShutdownFinished)
+        {
+            FinishShutdown();
+        }
+        CALL_OUT("");
+        return success;
+    }
+
+    // Next one from the queue
+    IssueQueuedRequests();
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Queue dates for download
+int WundergroundComms::QueueDates(const QStringList & mcrDates)
+{
+    CALL_IN(QString("mcrDates=%1")
+        .arg(CALL_SHOW(mcrDates)));
+
+    if (m_IsShuttingDown)
+    {
+        const QString reason = tr("Shutting down; not queueing any dates.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 0;
+    }
+
+    // Record them as pending, so they survive a restart
+    int num_new = 0;
+    for (const QString & date : mcrDates)
+    {
+        if (m_DateQueue.contains(date))
+        {
+            continue;
+        }
+        m_DateQueue << date;
+        UpdateJob(date, "pending");
+        num_new++;
+    }
+    FlushWriteQueue();
+    m_IsQueueActive = true;
+    IssueQueuedRequests();
+
+    CALL_OUT("");
+    return num_new;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Maximum number of requests in flight
+void WundergroundComms::SetMaxRequestsInFlight(const int mcMaxRequests)
+{
+    CALL_IN(QString("mcMaxRequests=%1")
+        .arg(CALL_SHOW(mcMaxRequests)));
+
+    if (mcMaxRequests < 1)
+    {
+        const QString reason = tr("Need at least one request in flight.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    m_MaxRequestsInFlight = mcMaxRequests;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of queued dates (not in flight yet)
+int WundergroundComms::GetQueueSize() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_DateQueue.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Send queued requests as long as we have capacity
+void WundergroundComms::IssueQueuedRequests()
+{
+    CALL_IN("");
+
+    while (!m_DateQueue.isEmpty() &&
+        m_RepliesInFlight.size() < m_MaxRequestsInFlight)
+    {
+        const QString date = m_DateQueue.takeFirst();
+        const int in_flight = m_RepliesInFlight.size();
+        GetDate(date);
+        if (m_RepliesInFlight.size() == in_flight)
+        {
+            // Request has not been sent; reason has been reported.
+            emit DownloadFailed(date);
+        }
+    }
+
+    // Queue done
+    if (m_IsQueueActive &&
+        m_DateQueue.isEmpty() &&
+        m_RepliesInFlight.isEmpty())
+    {
+        m_IsQueueActive = false;
+        emit QueueFinished();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Process response
+bool WundergroundComms::ProcessResponse(QNetworkReply * mpResponse)
 {
     CALL_IN(QString("mpResponse=%1")
         .arg(CALL_SHOW(mpResponse)));
@@ -879,9 +3920,34 @@ bool WundergroundComms::HandleResponse(QNetworkReply * mpResponse)
         qDebug().noquote() << doc_response.toJson(QJsonDocument::Indented);
     }
 
-    // Parse observations
+    // Skip the whole day if its content hasn't changed since last time
     QJsonObject response = doc_response.object();
-    bool success = Parse_Observations(response);
+    const QJsonArray observations = response["observations"].toArray();
+    const QString date = QDate::fromString(
+        mpResponse -> property("date").toString(), "yyyyMMdd")
+            .toString("yyyy-MM-dd");
+    const QString content_hash = DayContentHash(observations);
+    if (!observations.isEmpty() &&
+        m_DayHashes.value(date) == content_hash)
+    {
+        emit DataReceived(date);
+        emit StatusUpdate(tr("Obtained update for %1 from WU server "
+            "(%2 observations, unchanged)")
+            .arg(date,
+                 QString::number(observations.size())));
+        CALL_OUT("");
+        return true;
+    }
+
+    // Parse observations
+    m_HasIgnoredRevisions = false;
+    const bool success = Parse_Observations(response);
+    if (success &&
+        !observations.isEmpty() &&
+        !m_HasIgnoredRevisions)
+    {
+        UpdateDay(date, content_hash, observations.size());
+    }
 
     CALL_OUT("");
     return success;
@@ -1049,7 +4115,7 @@ bool WundergroundComms::Parse_SingleObservation(
                         continue;
                     }
                     const float value = json_metric[metric_key].toDouble();
-                    observation[m_WUToDB[metric_key]] = QString::number(value);
+                    observation[m_WUToDB[metric_key]] = NormalizeValue(value);
                     continue;
                 } else
                 {
@@ -1077,7 +4143,7 @@ bool WundergroundComms::Parse_SingleObservation(
             } else
             {
                 const float value = mcrObservation[key].toDouble();
-                observation[m_WUToDB[key]] = QString::number(value);
+                observation[m_WUToDB[key]] = NormalizeValue(value);
             }
             continue;
         }
@@ -1100,27 +4166,60 @@ bool WundergroundComms::Parse_SingleObservation(
     }
     const QString station_id = observation["station_id"];
     const QString date_time = observation["date_time"];
-    if (m_StationToDateTimes.contains(station_id) &&
-        m_StationToDateTimes[station_id].contains(date_time))
+    const QString key = station_id + "|" + date_time;
+    if (m_ObservationIndex.contains(key))
     {
-        // We know this observation already.
+        // We know this observation already, but WU may have corrected it
+        if (m_IsRevisionMode)
+        {
+            Revise(m_WeatherData[m_ObservationIndex[key]], observation);
+        } else
+        {
+            const QHash < QString, QString > & known =
+                m_WeatherData[m_ObservationIndex[key]];
+            // Corrections are left alone, so the day's new content hash
+            // must not be stored either (it would skip them for good)
+            for (auto value_iterator = observation.constBegin();
+                 value_iterator != observation.constEnd();
+                 value_iterator++)
+            {
+                if (known.value(value_iterator.key()) !=
+                    value_iterator.value())
+                {
+                    m_HasIgnoredRevisions = true;
+                    break;
+                }
+            }
+        }
         CALL_OUT("");
         return true;
     }
 
     // Keep observation
+    m_ObservationIndex[key] = m_WeatherData.size();
     m_WeatherData << observation;
     m_StationToDateTimes[station_id] += date_time;
 
-    // Save to database
-    const bool success = SaveToDatabase(observation);
-    if (!success)
-    {
-        // Has been reported previously.
-        CALL_OUT("");
-        return false;
-    }
+    // Save to database (in one transaction with the rest of the response)
+    m_WriteQueue << observation;
 
     CALL_OUT("");
     return true;
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Same text representation for values from WU and from the database
+QString WundergroundComms::NormalizeValue(const double mcValue)
+{
+    CALL_IN(QString("mcValue=%1")
+        .arg(CALL_SHOW(mcValue)));
+
+    // Values are stored as float; callers pass them through a float first,
+    // so both sides end up with the same digits.
+    const QString value = QString::number(mcValue);
+
+    CALL_OUT("");
+    return value;
+}
@@ -6,13 +6,31 @@
 
 // Qt includes
 #include <QDateTime>
+#include <QCache>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QObject>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QString>
+#include <QTimer>
+#include <QTimeZone>
+#include <QVector>
+
+// System includes
+#include <functional>
+
+
+
+// Project includes
+#include "QueryResult.h"
+#include "StorageBackend.h"
 
 
 
@@ -40,6 +58,10 @@ private:
     // Instance
     static WundergroundComms * m_Instance;
 
+public:
+    // WU reports observations every five minutes
+    static const int OBSERVATIONS_PER_DAY = 24*12;
+
 
 
     // =============================================================== Database
@@ -50,28 +72,352 @@ private:
     QString m_DatabaseFilename;
 
 public:
-    bool OpenDatabase();
+    // Open database (read-only tools don't need the data in memory)
+    bool OpenDatabase(const bool mcReadData = true);
 private:
     bool m_DatabaseConnected;
+    bool m_DataRead;
 
-    // Create database
-    bool CreateDatabase();
+    // Create table for observations of a partition (the main table is the
+    // storage backend's)
+    bool CreateDataTable(const QString & mcrTable);
 
     // Read database
     bool ReadDatabase();
 
-    // Save observation to database
-    bool SaveToDatabase(const QHash < QString, QString > & mcrObservation);
+    // Save observations to database (to their partitions if partitioned;
+    // these have been attached before)
+    bool SaveToDatabase(
+        const QList < QHash < QString, QString > > & mcrObservations);
+
+    // Observations waiting to be written (write-behind)
+    QList < QHash < QString, QString > > m_WriteQueue;
+
+    // Write all queued observations, revisions, day and job updates in one
+    // transaction
+    bool FlushWriteQueue();
+
+    // Move WAL content into the database file
+    bool CheckpointDatabase();
 
 public:
     // Update database
     void UpdateDatabase();
 
+
+
+    // ======================================================== Storage backend
+    // Observations are kept by a StorageBackend: "sqlite" (table "wu_data"
+    // of the database, or its partitions), "memory" (lost when the program
+    // ends) or "archive" (column files in "observations" next to the
+    // database). Days, revisions, jobs and rollups are always kept in the
+    // database; rollups and station time zones come from the backend.
+    // Partitions, splitting, archiving and rebuilding rollups need SQLite.
+public:
+    // Backend for observations (before the database is opened)
+    bool SetStorageBackend(const QString & mcrName);
+    QString GetStorageBackend() const;
+
+    // Available backends
+    static QStringList GetStorageBackends();
+
+    // Report an error unless observations are kept by SQLite (for what
+    // reads "wu_data" and its partitions directly)
+    bool CheckSqliteStorage(const QString & mcrAction) const;
+private:
+    QString m_StorageBackendName;
+
+    // Backend (SQLite: partitioned, with a connection per thread; backends
+    // do their own locking)
+    StorageBackend * m_Storage;
+
+    // Create backend for observations and its storage
+    bool OpenStorage();
+
+
+
+    // ============================================================= Partitions
+    // Optionally, observations are stored in one database file per station
+    // and year (a "partition", "station|year"), attached to the connection
+    // when needed; table "wu_partitions" in the main database lists them.
+    // Queries only attach the partitions their range touches. Years that
+    // are over are sealed (vacuumed and made read-only), so backups and
+    // maintenance only deal with the current year. Observations still in the
+    // main database's "wu_data" (i.e. not split yet) are read as well.
+public:
+    // Partitioned layout
+    bool IsPartitioned() const;
+private:
+    bool m_IsPartitioned;
+
+public:
+    // Move observations from the main database into partitions
+    bool SplitDatabase();
+
+    // Partitions of a station (all stations if empty) within a range of
+    // years, sorted
+    QStringList GetPartitions(const QString & mcrStationID,
+        const int mcFirstYear = 0, const int mcLastYear = 9999) const;
+
+    // File of a partition
+    QString GetPartitionFilename(const QString & mcrPartition) const;
+
+    // Observation table of a partition, attached to the engine's connection
+    // ("wu_data" for "", i.e. the main database; empty if there was an
+    // error)
+    QString GetPartitionTable(const QString & mcrPartition);
+
+    // Seal partitions of years that are over
+    bool SealPartitions();
+
+private:
+    // Read list of partitions
+    bool ReadPartitions();
+
+    // Partition to sealed or not
+    QHash < QString, bool > m_Partitions;
+    mutable QMutex m_PartitionsMutex;
+
+    // Schema name of an attached partition
+    static QString PartitionSchema(const QString & mcrPartition);
+
+    // Partition an observation goes to
+    static QString PartitionOf(const QString & mcrStationID,
+        const QString & mcrDateTime);
+
+    // Attach partitions to a connection; for writing, partitions are created
+    // or unsealed as needed (on the engine's connection only)
+    bool AttachPartitions(const QStringList & mcrPartitions,
+        const QSqlDatabase & mcrDatabase, const bool mcForWriting = false);
+
+    // Create new partition (and attach it)
+    bool CreatePartition(const QString & mcrPartition);
+
+    // Make sealed partition writable again (late corrections)
+    bool UnsealPartition(const QString & mcrPartition);
+
+    // Observations of a station within a range of years: FROM clause for
+    // the main table and the partitions (attached; empty if there was an
+    // error)
+    QString DataSource(const QString & mcrStationID, const int mcFirstYear,
+        const int mcLastYear, const QSqlDatabase & mcrDatabase);
+
+    // FROM clause for the main table and a list of (attached) partitions
+    static QString DataSourceSQL(const QStringList & mcrPartitions);
+
+
+
+    // ================================================================ Archive
+    // Months that are over can be exported to compressed column files (see
+    // ColumnArchive), one per station and month, in "archive" next to the
+    // database. Raw queries whose range is entirely archived read those
+    // instead of SQLite. Observations stay in the database (rollups,
+    // revisions and verification need them); new data for an archived month
+    // delete its file, so archives are never stale.
+public:
+    // Export months that are over and haven't been archived yet
+    bool ArchiveMonths();
+
+    // Archive file of a station and month (yyyy-MM)
+    QString GetArchiveFilename(const QString & mcrStationID,
+        const QString & mcrMonth) const;
+
+    // Archived months of a station (all stations if empty) as
+    // "station|yyyy-MM", sorted
+    QStringList GetArchivedMonths(const QString & mcrStationID) const;
+
+    // Observations of a station and month from the database: times (see
+    // ColumnArchive::ToSeconds()) and one vector per metric column
+    bool ReadMonth(const QString & mcrStationID, const QString & mcrMonth,
+        QVector < qint64 > & mrTimes, QList < QVector < double > > & mrValues);
+
+private:
+    // Range (station time) entirely covered by archives that have all of
+    // mcrMetrics
+    bool IsArchived(const QString & mcrStationID, const QDateTime & mcrFrom,
+        const QDateTime & mcrTo, const QStringList & mcrMetrics) const;
+
+    // Raw query (range in station time) from archives (read the same way as
+    // by the "archive" storage backend)
+    bool RunArchiveQuery(const QString & mcrStationID,
+        const QDateTime & mcrFrom, const QDateTime & mcrTo,
+        const QStringList & mcrMetrics, const QTimeZone & mcrTimeZone,
+        const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QueryResult & mrResult);
+
+    // Drop the archive of a station and month
+    void InvalidateArchive(const QString & mcrStationID,
+        const QString & mcrMonth);
+
+
+
+    // =================================================================== Jobs
+    // Every download is recorded in the database (table "wu_jobs") as
+    // pending, in_flight, done or failed, so a restart picks up where the
+    // previous run left off.
+private:
+    // Record new state of a download (written with the next flush, i.e.
+    // in the same transaction as the observations it produced)
+    void UpdateJob(const QString & mcrDate, const QString & mcrState,
+        const QString & mcrError = QString());
+    QList < QHash < QString, QString > > m_JobUpdates;
+
+    // Write one job update (within FlushWriteQueue()'s transaction)
+    bool SaveJobToDatabase(const QHash < QString, QString > & mcrJob);
+
+    // Queue downloads that were pending or in flight when we last stopped
+    bool ResumeJobs();
+
+
+
+    // ============================================================== Revisions
+    // WU sometimes corrects observations after the fact. In revision mode,
+    // changed values are written (only the columns that changed) and every
+    // change is logged in table "wu_revisions"; otherwise observations we
+    // already have are left alone.
+public:
+    // Revision mode
+    void SetRevisionMode(const bool mcIsRevisionMode);
+    bool GetRevisionMode() const;
+private:
+    bool m_IsRevisionMode;
+
+    // Outside revision mode: response changed observations we already have
+    bool m_HasIgnoredRevisions;
+
+    // Compare a known observation with what WU sent; queue changes
+    void Revise(QHash < QString, QString > & mrKnown,
+        const QHash < QString, QString > & mcrObservation);
+
+    // Changed columns of observations (plus station_id and date_time)
+    QList < QHash < QString, QString > > m_RevisionQueue;
+
+    // One entry per changed value: station_id, date_time, column, old_value,
+    // new_value, revised
+    QList < QHash < QString, QString > > m_RevisionLog;
+
+    // Update changed columns of observations (within FlushWriteQueue()'s
+    // transaction)
+    bool UpdateInDatabase(
+        const QList < QHash < QString, QString > > & mcrRevisions);
+
+    // Log one revision (within FlushWriteQueue()'s transaction)
+    bool SaveRevisionToDatabase(
+        const QHash < QString, QString > & mcrRevision);
+
+
+
+    // ================================================================ Rollups
+    // Count, min, max and sum of every metric per hour, day and month (tables
+    // "wu_rollup_hourly", "wu_rollup_daily" and "wu_rollup_monthly"; the
+    // mean is sum/count). Days touched by a flush are recomputed within its
+    // transaction.
+public:
+    // Recompute all rollups from the observations (using mcThreads threads)
+    bool RebuildRollups(const int mcThreads);
+
+    // Numeric columns
+    QStringList GetMetricColumns() const;
+
+private:
+    // Recompute hourly and daily rollups of a day
+    bool UpdateRollups(const QString & mcrStationID, const QString & mcrDate);
+
+    // Recompute monthly rollup from daily rollups
+    bool UpdateMonthlyRollup(const QString & mcrStationID,
+        const QString & mcrMonth);
+
+
+
+    // ================================================================== Query
+    // Time series for a station, from raw observations or from rollups.
+    // Timestamps are stored in station time; the requested range is
+    // converted using the station's time zone. Results are cached (LRU) until
+    // new data arrive for one of the days they cover.
+public:
+    // Values of mcrMetrics from mcrFrom (inclusive) to mcrTo (exclusive);
+    // mcrResolution is raw, hourly, daily, monthly or auto
+    bool Query(const QString & mcrStationID, const QDateTime & mcrFrom,
+        const QDateTime & mcrTo, const QStringList & mcrMetrics,
+        const QString & mcrResolution, QueryResult & mrResult);
+
+    // Same, delivered in chunks of mcChunkSize rows (for large results; not
+    // cached); mcrCallback returns false to stop. May be called from worker
+    // threads (which read through a connection of their own).
+    bool Query(const QString & mcrStationID, const QDateTime & mcrFrom,
+        const QDateTime & mcrTo, const QStringList & mcrMetrics,
+        const QString & mcrResolution, const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback);
+
+private:
+    // Run query; mcChunkSize 0 means everything in one go
+    bool RunQuery(const QString & mcrStationID, const QDateTime & mcrFrom,
+        const QDateTime & mcrTo, const QStringList & mcrMetrics,
+        const QString & mcrResolution, const int mcChunkSize,
+        const std::function < bool (const QueryResult &) > & mcrCallback,
+        QueryResult & mrResult);
+
+    // Resolution for "auto" (depending on the length of the range)
+    static QString ChooseResolution(const QDateTime & mcrFrom,
+        const QDateTime & mcrTo);
+
+    // Period format of a rollup resolution
+    static QString PeriodFormat(const QString & mcrResolution);
+
+    // Connection for the calling thread
+    QSqlDatabase GetConnection() const;
+
+    // Time zone of a station
+    QTimeZone GetStationTimeZone(const QString & mcrStationID);
+    QHash < QString, QTimeZone > m_StationTimeZones;
+    QMutex m_StationTimeZonesMutex;
+
+    // Cached results, and station plus first and last (local) day they cover
+    // (Query() may run in worker threads, hence the mutex)
+    QCache < QString, QueryResult > m_QueryCache;
+    QHash < QString, QStringList > m_QueryCacheDays;
+    QMutex m_QueryCacheMutex;
+
+    // Drop cached results that cover a day
+    void InvalidateQueryCache(const QString & mcrStationID,
+        const QString & mcrDate);
+
+
+
+    // =================================================================== Days
+    // Each downloaded day is stored with a hash of its content (table
+    // "wu_days"); if WU sends the same content again, the day is skipped
+    // before any observation is looked at. Outside revision mode, a day
+    // whose changes were left alone keeps its old hash.
+private:
+    // Read content hashes of all days
+    bool ReadDayHashes();
+    QHash < QString, QString > m_DayHashes;
+
+    // Hash of a day's observations
+    static QString DayContentHash(const QJsonArray & mcrObservations);
+
+    // Record new content of a day (written with the next flush)
+    void UpdateDay(const QString & mcrDate, const QString & mcrContentHash,
+        const int mcNumObservations);
+    QList < QHash < QString, QString > > m_DayUpdates;
+
+    // Write one day update (within FlushWriteQueue()'s transaction)
+    bool SaveDayToDatabase(const QHash < QString, QString > & mcrDay);
+
 private:
     // Mapping of WU columns to database columns
     void Initialize_WUToDB();
     QHash < QString, QString > m_WUToDB;
 
+    // Derived from the mapping once
+    QStringList m_DatabaseColumns;
+
+public:
+    // Database columns (sorted)
+    QStringList GetDatabaseColumns() const;
+
 
 
     // ================================================================== Setup
@@ -100,30 +446,72 @@ public:
 private:
     QDateTime m_StartDateTime;
 
+public:
+    // Graceful shutdown: stop updates, wait for requests in flight (for a
+    // limited time), flush queued writes, checkpoint the database
+    void Shutdown();
+    bool IsShuttingDown() const;
+private:
+    bool m_IsShuttingDown;
+    bool m_IsShutdownFinished;
+    void FinishShutdown();
+    QElapsedTimer m_ShutdownTimer;
+    qint64 m_ShutdownTime_Scheduler;
+private slots:
+    void ShutdownTimeout();
+
 
 
     // =============================================== Reading sfrom the Server
 private slots:
     // Periodically getting updates
     void Periodic_GetUpdates();
+private:
+    QTimer * m_UpdateTimer;
+
 public:
     void GetDate(const QString & mcrDate);
 
+    // Queue dates for download (e.g. backfill); only a limited number of
+    // requests is in flight at any time. Returns number of dates that were
+    // not queued already.
+    int QueueDates(const QStringList & mcrDates);
+    void SetMaxRequestsInFlight(const int mcMaxRequests);
+    int GetQueueSize() const;
+private:
+    void IssueQueuedRequests();
+    QStringList m_DateQueue;
+    int m_MaxRequestsInFlight;
+    bool m_IsQueueActive;
+
 private slots:
     // Handle response
     bool HandleResponse(QNetworkReply * mpResponse);
 private:
+    bool ProcessResponse(QNetworkReply * mpResponse);
     QNetworkAccessManager * m_NetworkAccessManager;
 
+    // Requests that have been sent but not answered yet
+    QSet < QNetworkReply * > m_RepliesInFlight;
+
 private:
     bool Parse_Observations(const QJsonObject & mcrObservations);
     bool Parse_SingleObservation(const QJsonObject & mcrObservation);
     QHash < QString, QSet < QString > > m_StationToDateTimes;
     QList < QHash < QString, QString > > m_WeatherData;
 
+    // "station_id|date_time" to index in m_WeatherData
+    QHash < QString, int > m_ObservationIndex;
+
+    // Same text representation for values from WU and from the database
+    static QString NormalizeValue(const double mcValue);
+
 signals:
     void DataReceived(const QString & mcrDate);
     void StatusUpdate(const QString & mcrUpdate);
+    void ShutdownComplete();
+    void DownloadFailed(const QString & mcrDate);
+    void QueueFinished();
 };
 
 #endif
@@ -21,22 +21,18 @@
 // Project includes
 #include "Application.h"
 #include "MainWindow.h"
-
-// System include
-#include <signal.h>
-
-// Terminate thread (Ctrl-C)
-[[noreturn]] void terminated(int mStatus);
+#include "SignalHandler.h"
 
 
 
 int main(int mNumParameters, char * mpParameter[])
 {
-    // Catch SIGTERM (Ctrl-C)
-    signal(SIGINT, terminated);
-
     Application * app = Application::Instance(mNumParameters, mpParameter);
 
+    // Catch SIGINT (Ctrl-C) and SIGTERM; MainWindow shuts down gracefully
+    SignalHandler * signal_handler = SignalHandler::Instance();
+    signal_handler -> Install();
+
     MainWindow * window = MainWindow::Instance();
     window -> show();
 
@@ -48,12 +44,3 @@ int main(int mNumParameters, char * mpParameter[])
 
     return result;
 }
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// Terminate thread (Ctrl-C)
-void terminated(int mStatus)
-{
-    exit(mStatus);
-}
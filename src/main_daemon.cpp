@@ -0,0 +1,70 @@
+// WundergroundDownloader - Download PWS data from WU
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// main_daemon.cpp
+// Headless version (no GUI; QtCore, QtNetwork and QtSql only)
+
+// Project includes
+#include "CommandLineTool.h"
+#include "Daemon.h"
+#include "SignalHandler.h"
+
+// Qt includes
+#include <QCoreApplication>
+#include <QTimer>
+
+
+
+int main(int mNumParameters, char * mpParameter[])
+{
+    QCoreApplication * app =
+        new QCoreApplication(mNumParameters, mpParameter);
+
+    // Catch SIGINT (Ctrl-C) and SIGTERM; shut down gracefully
+    SignalHandler * signal_handler = SignalHandler::Instance();
+    signal_handler -> Install();
+
+    // Command (backfill, verify, export, stats)?
+    CommandLineTool * tool = CommandLineTool::Instance();
+    if (tool -> ParseArguments(app -> arguments()))
+    {
+        QTimer::singleShot(0, tool, SLOT(Run()));
+        const int result = app -> exec();
+        delete tool;
+        delete app;
+        return result;
+    }
+
+    // Otherwise, run as a daemon
+    // Start ingest engine
+    Daemon * daemon = Daemon::Instance();
+    if (!daemon -> Start())
+    {
+        delete daemon;
+        delete app;
+        return 1;
+    }
+
+    const int result = app -> exec();
+
+    // Clean up
+    delete daemon;
+    delete app;
+
+    return result;
+}